@@ -4,16 +4,14 @@
 
 #ifndef PROJECT_BASE_COMMON_H
 #define PROJECT_BASE_COMMON_H
-#include <fstream>
-#include <sstream>
+#include <learnopengl/resource_pack.h>
+
 #include <string>
 
 std::string readFileContents(std::string path)
 {
-        std::ifstream in(path);
-        std::stringstream buffer;
-        buffer << in.rdbuf();
-        return buffer.str();
+        FileView file(path);
+        return std::string((const char *)file.data, file.size);
 }
 
 #endif // PROJECT_BASE_COMMON_H
@@ -0,0 +1,430 @@
+#ifndef ASSET_STREAMER_H
+#define ASSET_STREAMER_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/image_decoder.h>
+#include <learnopengl/model.h>
+#include <learnopengl/texture.h>
+#include <learnopengl/texture_cache.h>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Loads models and textures in the background while the render loop keeps running.
+//
+// Every request goes through three stages:
+//   1. load    - file reading, ASSIMP/mesh cache and image decoding on a worker
+//                thread (std::async), no OpenGL involved
+//   2. upload  - buffers and textures are created on the upload thread, which owns a
+//                hidden GLFW context sharing objects with the main one. Pixels are
+//                staged through pixel unpack buffers. A fence is inserted afterwards.
+//   3. finish  - once poll() sees the fence signaled, the main thread swaps the real
+//                resource in (and creates the VAOs, which aren't shared).
+// Until then models are drawn as their bounding box and textures are a 1x1
+// placeholder, so the window is interactive right away. The material textures of a
+// model come later still, once drawing asks for them (Model::requestTextures).
+class AssetStreamer
+{
+      public:
+        // must be called on the main thread, with the main context current
+        explicit AssetStreamer(GLFWwindow *mainWindow)
+            : stopping(false), reported(false)
+        {
+                createPlaceholders();
+
+                glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+                uploadWindow = glfwCreateWindow(1, 1, "", nullptr, mainWindow);
+                glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+                if (uploadWindow == nullptr)
+                        std::cout << "WARNING::ASSET_STREAMER:: no shared context, "
+                                     "uploading on the main thread"
+                                  << std::endl;
+                else
+                        uploadThread = std::thread([this]() { uploadLoop(); });
+        }
+
+        ~AssetStreamer() { shutdown(); }
+
+        AssetStreamer(const AssetStreamer &) = delete;
+        AssetStreamer &operator=(const AssetStreamer &) = delete;
+
+        // starts loading a model. It is drawn as its bounding box as soon as the
+        // import is done and switches to the real meshes when they are on the GPU.
+        // The model must outlive the streamer. With keepGeometry the meshes keep
+        // their vertices and indices in memory. Only the given vertex attributes
+        // are uploaded.
+        void streamModel(Model &model, const std::string &path,
+                         VertexLayout layout = VertexLayout::Full,
+                         bool keepGeometry = false,
+                         AttributeMask attributes = ALL_ATTRIBUTES)
+        {
+                start(std::make_shared<ModelRequest>(model, path, layout, keepGeometry,
+                                                     attributes, placeholder2D));
+        }
+
+        // starts loading a 2D texture; texture is the placeholder until it's done
+        void streamTexture(unsigned int &texture, const std::string &path, bool flip,
+                           const TextureFormat &format)
+        {
+                texture = placeholder2D;
+                start(std::make_shared<TextureRequest>(
+                    texture, std::vector<std::string>(1, path), flip, format, false));
+        }
+
+        // starts loading a cubemap from six faces (+X, -X, +Y, -Y, +Z, -Z)
+        void streamCubemap(unsigned int &texture, const std::vector<std::string> &faces,
+                           const TextureFormat &format)
+        {
+                texture = placeholderCube;
+                start(std::make_shared<TextureRequest>(texture, faces, false, format,
+                                                       true));
+        }
+
+        // called once per frame on the main thread: shows placeholders of freshly
+        // imported models and swaps in every resource whose upload has completed
+        void poll()
+        {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (auto it = inFlight.begin(); it != inFlight.end();) {
+                        Request &request = **it;
+                        if (request.stage >= Request::Loaded && !request.shown) {
+                                request.loaded();
+                                request.shown = true;
+                        }
+                        if (request.stage == Request::Uploaded &&
+                            request.fenceSignaled()) {
+                                if (request.fence)
+                                        glDeleteSync(request.fence);
+                                request.fence = nullptr;
+                                request.finish();
+                                it = inFlight.erase(it);
+                        } else {
+                                ++it;
+                        }
+                }
+                if (!uploadWindow)
+                        uploadPending();
+                if (inFlight.empty() && !reported) {
+                        TextureCache::instance().report(std::cout);
+                        TextureQuality::instance().report(std::cout);
+                        reportMemory(std::cout);
+                        reported = true;
+                }
+        }
+
+        // waits for the loaders, stops the upload thread and deletes the
+        // placeholders. Must be called on the main thread before the main context is
+        // destroyed. The upload thread finishes the request it is on; the ones still
+        // queued or not swapped in yet are cancelled (their textures are reset to 0,
+        // models keep their bounding box).
+        void shutdown()
+        {
+                for (auto &loader : loaders)
+                        loader.wait();
+                loaders.clear();
+                {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        stopping = true;
+                }
+                wakeUp.notify_all();
+                if (uploadThread.joinable())
+                        uploadThread.join();
+                if (uploadWindow) {
+                        glfwDestroyWindow(uploadWindow);
+                        uploadWindow = nullptr;
+                }
+                cancelPending();
+                deletePlaceholders();
+        }
+
+      private:
+        struct Request {
+                enum Stage { Loading, Loaded, Uploaded, Cancelled };
+                Request() : stage(Loading), shown(false), fence(nullptr) {}
+                virtual ~Request() {}
+                // worker thread, no OpenGL
+                virtual void load() = 0;
+                // main thread, after load() (placeholders may be updated here)
+                virtual void loaded() {}
+                // upload thread
+                virtual void upload() = 0;
+                // main thread, after the upload is visible to the main context
+                virtual void finish() = 0;
+                // main thread, at shutdown instead of finish()
+                virtual void cancel() {}
+
+                bool fenceSignaled()
+                {
+                        if (!fence)
+                                return true;
+                        GLenum status = glClientWaitSync(fence, 0, 0);
+                        return status == GL_ALREADY_SIGNALED ||
+                               status == GL_CONDITION_SATISFIED;
+                }
+
+                Stage stage;
+                bool shown;
+                GLsync fence;
+        };
+
+        struct ModelRequest : Request {
+                ModelRequest(Model &model, const std::string &path, VertexLayout layout,
+                             bool keepGeometry, AttributeMask attributes,
+                             unsigned int texture)
+                    : model(model), path(path), layout(layout),
+                      keepGeometry(keepGeometry), attributes(attributes),
+                      placeholderTexture(texture)
+                {
+                }
+                void load() override
+                {
+                        data = Model::import(path, layout, keepGeometry, attributes);
+                }
+                void loaded() override
+                {
+                        model.showPlaceholder(data->boundsMin, data->boundsMax,
+                                              placeholderTexture, layout);
+                }
+                void upload() override { Model::uploadBuffers(*data, buffers); }
+                void finish() override
+                {
+                        model.adopt(buffers);
+                        data.reset();
+                }
+
+                Model &model;
+                std::string path;
+                VertexLayout layout;
+                bool keepGeometry;
+                AttributeMask attributes;
+                unsigned int placeholderTexture;
+                std::unique_ptr<ModelData> data;
+                ModelBuffers buffers;
+        };
+
+        struct TextureRequest : Request {
+                TextureRequest(unsigned int &texture,
+                               const std::vector<std::string> &paths, bool flip,
+                               const TextureFormat &format, bool cubemap)
+                    : texture(texture), paths(paths), flip(flip), format(format),
+                      cubemap(cubemap), id(0)
+                {
+                }
+                // nothing is decoded when the same texture is already resident
+                void load() override
+                {
+                        key = TextureCache::makeKey(paths, format, flip, cubemap);
+                        if (TextureCache::instance().contains(key))
+                                return;
+                        for (const std::string &path : paths)
+                                images.add(path, flip, compressionRequest(format));
+                        images.decode();
+                        images.report(std::cout);
+                }
+                void upload() override
+                {
+                        TextureCache &cache = TextureCache::instance();
+                        id = cache.acquire(key);
+                        if (id != 0)
+                                return;
+                        if (images.size() == 0) {
+                                // evicted since load(), decode it after all
+                                CompressionRequest request = compressionRequest(format);
+                                for (const std::string &path : paths)
+                                        images.add(path, flip, request);
+                                images.decode();
+                        }
+                        std::vector<const DecodedImage *> decoded;
+                        for (size_t i = 0; i < images.size(); i++)
+                                decoded.push_back(&images.image(i));
+                        std::vector<const void *> pixels;
+                        unsigned int pbo = stagePixels(decoded, pixels);
+                        if (cubemap)
+                                id = createCubemap(decoded, format, pixels);
+                        else
+                                id = createTexture2D(*decoded[0], format, pixels[0]);
+                        releasePixels(pbo);
+                        // cubemaps get no mip chain
+                        size_t bytes = TextureCache::textureBytes(
+                            *decoded[0], format.mipmaps && !cubemap, (int)decoded.size());
+                        id = cache.insert(key, id, bytes);
+                        for (size_t i = 0; i < images.size(); i++)
+                                images.release(i);
+                }
+                void finish() override { texture = id; }
+                // the placeholder it points at is about to be deleted
+                void cancel() override { texture = 0; }
+
+                unsigned int &texture;
+                std::vector<std::string> paths;
+                bool flip;
+                TextureFormat format;
+                bool cubemap;
+                TextureKey key;
+                ImageDecodeBatch images;
+                unsigned int id;
+        };
+
+        GLFWwindow *uploadWindow;
+        std::thread uploadThread;
+        std::vector<std::future<void>> loaders;
+
+        std::mutex mutex;
+        std::condition_variable wakeUp;
+        bool stopping;
+        // the texture cache summary is printed once everything has been swapped in
+        bool reported;
+        // requests that haven't been swapped in yet, in submission order
+        std::list<std::shared_ptr<Request>> inFlight;
+        // loaded requests waiting for the upload thread
+        std::deque<std::shared_ptr<Request>> uploadQueue;
+
+        unsigned int placeholder2D;
+        unsigned int placeholderCube;
+
+        void start(const std::shared_ptr<Request> &request)
+        {
+                {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        inFlight.push_back(request);
+                }
+                loaders.push_back(std::async(std::launch::async, [this, request]() {
+                        request->load();
+                        std::lock_guard<std::mutex> lock(mutex);
+                        request->stage = Request::Loaded;
+                        uploadQueue.push_back(request);
+                        wakeUp.notify_all();
+                }));
+        }
+
+        void uploadLoop()
+        {
+                glfwMakeContextCurrent(uploadWindow);
+                for (;;) {
+                        std::shared_ptr<Request> request;
+                        {
+                                std::unique_lock<std::mutex> lock(mutex);
+                                wakeUp.wait(lock, [this]() {
+                                        return stopping || !uploadQueue.empty();
+                                });
+                                if (stopping)
+                                        break;
+                                request = uploadQueue.front();
+                                uploadQueue.pop_front();
+                        }
+                        upload(*request);
+                }
+                glfwMakeContextCurrent(nullptr);
+        }
+
+        // uploads a request on the current context and fences it. The flush makes
+        // sure the fence reaches the GPU, so the main context can wait on it.
+        void upload(Request &request)
+        {
+                request.upload();
+                GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                glFlush();
+                std::lock_guard<std::mutex> lock(mutex);
+                request.fence = fence;
+                request.stage = Request::Uploaded;
+        }
+
+        // drops every request that hasn't been swapped in, once the upload thread
+        // has stopped
+        void cancelPending()
+        {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (inFlight.empty())
+                        return;
+                std::cout << "WARNING::ASSET_STREAMER:: " << inFlight.size()
+                          << " requests cancelled at shutdown" << std::endl;
+                for (const std::shared_ptr<Request> &request : inFlight) {
+                        if (request->fence)
+                                glDeleteSync(request->fence);
+                        request->fence = nullptr;
+                        request->stage = Request::Cancelled;
+                        request->cancel();
+                }
+                inFlight.clear();
+                uploadQueue.clear();
+        }
+
+        // fallback without a shared context: upload on the main thread in poll(),
+        // with the mutex already held
+        void uploadPending()
+        {
+                while (!uploadQueue.empty()) {
+                        std::shared_ptr<Request> request = uploadQueue.front();
+                        uploadQueue.pop_front();
+                        request->upload();
+                        request->stage = Request::Uploaded;
+                }
+        }
+
+        // resident set size now and at its peak, once everything is loaded
+        static void reportMemory(std::ostream &out)
+        {
+                long pages = 0, residentPages = 0;
+                FILE *statm = fopen("/proc/self/statm", "r");
+                if (statm) {
+                        if (fscanf(statm, "%ld %ld", &pages, &residentPages) != 2)
+                                residentPages = 0;
+                        fclose(statm);
+                }
+                struct rusage usage;
+                getrusage(RUSAGE_SELF, &usage);
+                out << "MEMORY::RSS " << std::fixed << std::setprecision(2)
+                    << residentPages * sysconf(_SC_PAGESIZE) / 1048576.0 << " MB, peak "
+                    << usage.ru_maxrss / 1024.0 << " MB" << std::endl;
+        }
+
+        // 1x1 white textures stood in for textures that are still loading
+        void createPlaceholders()
+        {
+                const unsigned char white[4] = {255, 255, 255, 255};
+                glGenTextures(1, &placeholder2D);
+                GLState::instance().bindTexture(GL_TEXTURE_2D, placeholder2D);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                             white);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+                glGenTextures(1, &placeholderCube);
+                GLState::instance().bindTexture(GL_TEXTURE_CUBE_MAP, placeholderCube);
+                for (unsigned int i = 0; i < 6; i++)
+                        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, 1, 1,
+                                     0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+                glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+                glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        }
+
+        // on the main context; a second shutdown() (the destructor) finds nothing
+        void deletePlaceholders()
+        {
+                unsigned int textures[2] = {placeholder2D, placeholderCube};
+                if (textures[0] == 0)
+                        return;
+                for (unsigned int texture : textures)
+                        GLState::instance().textureDeleted(texture);
+                glDeleteTextures(2, textures);
+                placeholder2D = placeholderCube = 0;
+        }
+};
+
+#endif
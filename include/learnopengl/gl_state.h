@@ -0,0 +1,269 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <thread>
+
+// Cache of the GL state the renderer changes most: the program in use, the vertex
+// array, the texture bound to every unit, the framebuffer and the blend, cull and
+// depth state. A call that would set what is set already doesn't reach the driver.
+// For the cache to be right every change of that state has to go through it; code
+// that changes it behind its back (a GUI library) calls invalidate() afterwards.
+// Deleted objects have to be reported, as GL unbinds them and may hand out their
+// names again.
+// The cache is of the context of the thread that first calls instance(), the main
+// one. Texture binds and deletes made on other threads, which have a context of
+// their own (the upload thread of AssetStreamer creates textures on a shared one),
+// go straight to the driver and leave the cache alone; nothing else may be called
+// from them.
+class GLState
+{
+      public:
+        // texture units tracked; binds to higher units always go to the driver
+        static const unsigned int TEXTURE_UNITS = 32;
+
+        // calls made and calls left out
+        struct Stats {
+                size_t issued = 0;
+                size_t elided = 0;
+        };
+
+        static GLState &instance()
+        {
+                static GLState state;
+                return state;
+        }
+
+        GLState(const GLState &) = delete;
+        GLState &operator=(const GLState &) = delete;
+
+        void useProgram(unsigned int program)
+        {
+                if (changed(currentProgram, program))
+                        glUseProgram(program);
+        }
+
+        void bindVertexArray(unsigned int vertexArray)
+        {
+                if (changed(currentVertexArray, vertexArray))
+                        glBindVertexArray(vertexArray);
+        }
+
+        // binds to GL_FRAMEBUFFER, drawing and reading
+        void bindFramebuffer(unsigned int framebuffer)
+        {
+                if (changed(currentFramebuffer, framebuffer))
+                        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        }
+
+        // unit is 0 for GL_TEXTURE0
+        void activeTexture(unsigned int unit)
+        {
+                if (changed(currentUnit, unit))
+                        glActiveTexture(GL_TEXTURE0 + unit);
+        }
+
+        // binds to the active unit
+        void bindTexture(GLenum target, unsigned int texture)
+        {
+                if (!owned()) {
+                        glBindTexture(target, texture);
+                        return;
+                }
+                unsigned int *bound = binding(currentUnit, target);
+                if (!bound)
+                        stats.issued++;
+                else if (!changed(*bound, texture))
+                        return;
+                glBindTexture(target, texture);
+        }
+
+        // binds to a unit, which is made active only if the texture isn't bound
+        // to it already
+        void bindTexture(unsigned int unit, GLenum target, unsigned int texture)
+        {
+                if (!owned()) {
+                        glActiveTexture(GL_TEXTURE0 + unit);
+                        glBindTexture(target, texture);
+                        return;
+                }
+                unsigned int *bound = binding(unit, target);
+                if (bound && *bound == texture) {
+                        stats.elided++;
+                        return;
+                }
+                activeTexture(unit);
+                bindTexture(target, texture);
+        }
+
+        // GL_BLEND, GL_CULL_FACE or GL_DEPTH_TEST; others go to the driver
+        void enable(GLenum capability, bool on = true)
+        {
+                unsigned int *current = capabilityState(capability);
+                if (!current)
+                        stats.issued++;
+                else if (!changed(*current, on ? 1u : 0u))
+                        return;
+                if (on)
+                        glEnable(capability);
+                else
+                        glDisable(capability);
+        }
+
+        void disable(GLenum capability) { enable(capability, false); }
+
+        void depthMask(bool write)
+        {
+                if (changed(currentDepthMask, write ? 1u : 0u))
+                        glDepthMask(write ? GL_TRUE : GL_FALSE);
+        }
+
+        void depthFunc(GLenum func)
+        {
+                if (changed(currentDepthFunc, func))
+                        glDepthFunc(func);
+        }
+
+        void cullFace(GLenum face)
+        {
+                if (changed(currentCullFace, face))
+                        glCullFace(face);
+        }
+
+        void blendFunc(GLenum source, GLenum destination)
+        {
+                bool same = currentBlendSource == source &&
+                            currentBlendDestination == destination;
+                if (same) {
+                        stats.elided++;
+                        return;
+                }
+                stats.issued++;
+                currentBlendSource = source;
+                currentBlendDestination = destination;
+                glBlendFunc(source, destination);
+        }
+
+        // GL unbinds deleted objects from the current context. A texture deleted on
+        // another thread was bound only on its context (TextureCache::insert drops
+        // the duplicate it just created), so the cache keeps what it has.
+        void textureDeleted(unsigned int texture)
+        {
+                if (!owned())
+                        return;
+                for (unsigned int unit = 0; unit < TEXTURE_UNITS; unit++)
+                        for (unsigned int target = 0; target < TARGETS; target++)
+                                if (textures[unit][target] == texture)
+                                        textures[unit][target] = 0;
+        }
+
+        void vertexArrayDeleted(unsigned int vertexArray)
+        {
+                if (currentVertexArray == vertexArray)
+                        currentVertexArray = 0;
+        }
+
+        void framebufferDeleted(unsigned int framebuffer)
+        {
+                if (currentFramebuffer == framebuffer)
+                        currentFramebuffer = 0;
+        }
+
+        // a program in use stays in use after glDeleteProgram, but its name may be
+        // given to a new program, which would then look like it is in use
+        void programDeleted(unsigned int program)
+        {
+                if (currentProgram == program)
+                        currentProgram = UNKNOWN;
+        }
+
+        // forgets everything: the next call of each kind goes to the driver
+        void invalidate()
+        {
+                currentProgram = currentVertexArray = currentFramebuffer = UNKNOWN;
+                currentUnit = UNKNOWN;
+                for (unsigned int unit = 0; unit < TEXTURE_UNITS; unit++)
+                        for (unsigned int target = 0; target < TARGETS; target++)
+                                textures[unit][target] = UNKNOWN;
+                for (unsigned int &capability : capabilities)
+                        capability = UNKNOWN;
+                currentDepthMask = currentDepthFunc = currentCullFace = UNKNOWN;
+                currentBlendSource = currentBlendDestination = UNKNOWN;
+        }
+
+        // ends a frame: its calls become lastFrame() and counting starts over
+        void endFrame()
+        {
+                last = stats;
+                stats = Stats();
+        }
+
+        const Stats &lastFrame() const { return last; }
+
+        // whether the calling thread is the one whose context is cached
+        bool owned() const { return std::this_thread::get_id() == owner; }
+
+      private:
+        static const unsigned int UNKNOWN = 0xffffffffu;
+        // GL_TEXTURE_2D and GL_TEXTURE_CUBE_MAP
+        static const unsigned int TARGETS = 2;
+
+        unsigned int currentProgram;
+        unsigned int currentVertexArray;
+        unsigned int currentFramebuffer;
+        unsigned int currentUnit;
+        unsigned int textures[TEXTURE_UNITS][TARGETS];
+        // GL_BLEND, GL_CULL_FACE, GL_DEPTH_TEST: 0 or 1
+        unsigned int capabilities[3];
+        unsigned int currentDepthMask;
+        unsigned int currentDepthFunc;
+        unsigned int currentCullFace;
+        unsigned int currentBlendSource;
+        unsigned int currentBlendDestination;
+        Stats stats;
+        Stats last;
+        std::thread::id owner;
+
+        GLState() : owner(std::this_thread::get_id()) { invalidate(); }
+
+        // whether a call has to be made to set value, which is then current
+        bool changed(unsigned int &current, unsigned int value)
+        {
+                if (current == value) {
+                        stats.elided++;
+                        return false;
+                }
+                stats.issued++;
+                current = value;
+                return true;
+        }
+
+        unsigned int *binding(unsigned int unit, GLenum target)
+        {
+                if (unit >= TEXTURE_UNITS)
+                        return nullptr;
+                if (target == GL_TEXTURE_2D)
+                        return &textures[unit][0];
+                if (target == GL_TEXTURE_CUBE_MAP)
+                        return &textures[unit][1];
+                return nullptr;
+        }
+
+        unsigned int *capabilityState(GLenum capability)
+        {
+                switch (capability) {
+                case GL_BLEND:
+                        return &capabilities[0];
+                case GL_CULL_FACE:
+                        return &capabilities[1];
+                case GL_DEPTH_TEST:
+                        return &capabilities[2];
+                default:
+                        return nullptr;
+                }
+        }
+};
+
+#endif
@@ -0,0 +1,214 @@
+#ifndef IMAGE_DECODER_H
+#define IMAGE_DECODER_H
+
+#include <learnopengl/parallel.h>
+#include <learnopengl/texture_compression.h>
+#include <learnopengl/texture_quality.h>
+#include <stb_image.h>
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// pixels of one image as decoded by stb_image, ready to be handed to glTexImage2D,
+// or its block compressed mip chain when compression was requested
+struct DecodedImage {
+        std::string path;
+        bool flip = false;
+        CompressionRequest compression;
+        // larger images are halved until they fit, 0 for no cap (see
+        // texture_quality.h)
+        int maxSize = 0;
+        unsigned char *data = nullptr;
+        CompressedImage compressed;
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+        double decodeMs = 0.0;
+        // the compressed image came from its .ktx cache, nothing was decoded
+        bool fromCache = false;
+
+        bool isCompressed() const { return !compressed.levels.empty(); }
+        bool loaded() const { return data != nullptr || isCompressed(); }
+        // what gets uploaded: raw pixels or the compressed mip chain
+        const void *pixels() const
+        {
+                return isCompressed() ? (const void *)compressed.bytes() : data;
+        }
+        size_t pixelBytes() const
+        {
+                if (isCompressed())
+                        return compressed.byteCount();
+                return data ? (size_t)width * height * channels : 0;
+        }
+};
+
+// Decodes a batch of image files on all cores. Images are added on the GL thread,
+// decoded in parallel by decode() and then read back, in the order they were added,
+// for the upload. Vertical flipping is done per image by the decoder itself, so the
+// global stbi_set_flip_vertically_on_load() state is never touched from the workers
+// and the result does not depend on which thread decoded what.
+class ImageDecodeBatch
+{
+      public:
+        ImageDecodeBatch() : wallMs(0.0) {}
+        ~ImageDecodeBatch()
+        {
+                for (size_t i = 0; i < images.size(); i++)
+                        release(i);
+        }
+        ImageDecodeBatch(const ImageDecodeBatch &) = delete;
+        ImageDecodeBatch &operator=(const ImageDecodeBatch &) = delete;
+
+        // queues an image, returns its index in the batch. By default it is
+        // capped to the size of the current quality tier.
+        size_t add(const std::string &path, bool flip,
+                   const CompressionRequest &compression = CompressionRequest(),
+                   int maxSize = TextureQuality::instance().maxSize())
+        {
+                DecodedImage image;
+                image.path = path;
+                image.flip = flip;
+                image.compression = compression;
+                image.maxSize = maxSize;
+                images.push_back(image);
+                return images.size() - 1;
+        }
+
+        size_t size() const { return images.size(); }
+
+        // decodes every queued image, returns when all of them are done
+        void decode()
+        {
+                auto start = std::chrono::steady_clock::now();
+                JobPool::instance().parallelFor(images.size(), [this](size_t i) {
+                        if (!images[i].loaded())
+                                decodeImage(images[i]);
+                });
+                wallMs = std::chrono::duration<double, std::milli>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+        }
+
+        DecodedImage &image(size_t i) { return images[i]; }
+
+        // frees the pixels of an image once they have been uploaded
+        void release(size_t i)
+        {
+                if (images[i].data)
+                        stbi_image_free(images[i].data);
+                images[i].data = nullptr;
+                std::vector<unsigned char>().swap(images[i].compressed.data);
+                images[i].compressed.external = nullptr;
+                images[i].compressed.externalSize = 0;
+                images[i].compressed.levels.clear();
+        }
+
+        // per-image decode times plus the wall time of the whole batch
+        void report(std::ostream &out) const
+        {
+                double totalMs = 0.0;
+                for (const DecodedImage &image : images) {
+                        out << "IMAGE::DECODE " << std::fixed << std::setprecision(2)
+                            << std::setw(8) << image.decodeMs << " ms  " << image.width
+                            << "x" << image.height << "x" << image.channels << " "
+                            << blockFormatName(image.compressed.format)
+                            << (image.fromCache ? " (ktx)" : "") << "  " << image.path
+                            << '\n';
+                        totalMs += image.decodeMs;
+                }
+                out << "IMAGE::DECODE " << images.size() << " images, " << totalMs
+                    << " ms of decoding in " << wallMs << " ms on "
+                    << JobPool::instance().concurrency() << " threads" << std::endl;
+        }
+
+      private:
+        std::vector<DecodedImage> images;
+        double wallMs;
+
+        static void decodeImage(DecodedImage &image)
+        {
+                auto start = std::chrono::steady_clock::now();
+                uint32_t settings =
+                    ktx::settings(image.compression, image.flip, image.maxSize);
+                int width = 0, height = 0;
+                if (image.compression.enabled &&
+                    ktx::load(image.path, settings, image.compressed)) {
+                        image.fromCache = true;
+                        image.width = image.compressed.levels[0].width;
+                        image.height = image.compressed.levels[0].height;
+                        image.channels = blockChannels(image.compressed.format);
+                        // the size of the source, for the quality report
+                        width = image.width;
+                        height = image.height;
+                        FileView file;
+                        if (image.maxSize > 0 && file.open(image.path))
+                                stbi_info_from_memory(file.data, file.size, &width,
+                                                      &height, nullptr);
+                } else {
+                        FileView file(image.path);
+                        if (file.isOpen())
+                                image.data = stbi_load_from_memory(
+                                    file.data, file.size, &image.width, &image.height,
+                                    &image.channels, 0);
+                        width = image.width;
+                        height = image.height;
+                        if (image.data && image.flip)
+                                flipRows(image);
+                        if (image.data)
+                                downscaleImage(image.data, image.width, image.height,
+                                               image.channels, image.maxSize);
+                        if (image.data && image.compression.enabled)
+                                compress(image, settings);
+                }
+                if (image.loaded()) {
+                        double bits = image.isCompressed()
+                                          ? blockBytes(image.compressed.format) / 2.0
+                                          : image.channels * 8.0;
+                        bool mipmaps = image.isCompressed()
+                                           ? image.compressed.levels.size() > 1
+                                           : image.compression.mipmaps;
+                        TextureQuality::instance().record(width, height, bits, mipmaps);
+                }
+                image.decodeMs = std::chrono::duration<double, std::milli>(
+                                     std::chrono::steady_clock::now() - start)
+                                     .count();
+        }
+
+        // replaces the decoded pixels by their compressed mip chain, and caches it
+        static void compress(DecodedImage &image, uint32_t settings)
+        {
+                const CompressionRequest &request = image.compression;
+                bool alpha = hasTransparency(image.data, image.width, image.height,
+                                             image.channels);
+                bool grey = request.map == TextureMap::Specular &&
+                            isGrey(image.data, image.width, image.height, image.channels);
+                BlockFormat format = BlockCompression::choose(request.map, alpha, grey);
+                if (format == BlockFormat::None)
+                        return;
+                compressImage(image.data, image.width, image.height, image.channels,
+                              format, request.srgb, request.mipmaps, image.compressed);
+                ktx::write(image.path, settings, image.compressed);
+                stbi_image_free(image.data);
+                image.data = nullptr;
+                image.channels = blockChannels(format);
+        }
+
+        static void flipRows(DecodedImage &image)
+        {
+                size_t stride = (size_t)image.width * image.channels;
+                std::vector<unsigned char> row(stride);
+                unsigned char *top = image.data;
+                unsigned char *bottom = image.data + (image.height - 1) * stride;
+                for (; top < bottom; top += stride, bottom -= stride) {
+                        memcpy(row.data(), top, stride);
+                        memcpy(top, bottom, stride);
+                        memcpy(bottom, row.data(), stride);
+                }
+        }
+};
+
+#endif
@@ -6,9 +6,16 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <learnopengl/gl_state.h>
+#include <learnopengl/meshlet.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/vertex_format.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <string>
+#include <utility>
 #include <vector>
 using namespace std;
 
@@ -25,130 +32,585 @@ struct Vertex {
         glm::vec3 Bitangent;
 };
 
+// converts vertices to the packed layout, quantizing positions against their
+// bounding box. Returns how to map the quantized positions back.
+inline VertexQuantization packVertices(const Vertex *vertices, size_t count,
+                                       vector<PackedVertex> &packed)
+{
+        VertexQuantization quantization;
+        packed.resize(count);
+        if (count == 0)
+                return quantization;
+        glm::vec3 lo = vertices[0].Position, hi = vertices[0].Position;
+        for (size_t i = 1; i < count; i++) {
+                lo = glm::min(lo, vertices[i].Position);
+                hi = glm::max(hi, vertices[i].Position);
+        }
+        quantization.offset = lo;
+        quantization.scale = hi - lo;
+        for (size_t i = 0; i < count; i++) {
+                const Vertex &v = vertices[i];
+                PackedVertex &p = packed[i];
+                for (int c = 0; c < 3; c++) {
+                        float extent = quantization.scale[c];
+                        p.Position[c] = packUnorm16(
+                            extent > 0.0f ? (v.Position[c] - lo[c]) / extent : 0.0f);
+                }
+                encodeOctahedral(v.Normal, p.Normal);
+                p.TexCoords[0] = floatToHalf(v.TexCoords.x);
+                p.TexCoords[1] = floatToHalf(v.TexCoords.y);
+                float handedness;
+                p.TangentFrame =
+                    packTangentFrame(v.Tangent, v.Bitangent, v.Normal, handedness);
+                p.Position[3] = handedness < 0.0f ? 65535 : 0;
+        }
+        return quantization;
+}
+
+// where an attribute is inside a vertex of the given layout. Returns false when the
+// layout doesn't have it.
+inline bool attributeFormat(VertexLayout layout, unsigned int attribute, size_t &offset,
+                            size_t &size)
+{
+        static const size_t full[ATTRIBUTE_COUNT][2] = {
+            {offsetof(Vertex, Position), sizeof(Vertex::Position)},
+            {offsetof(Vertex, Normal), sizeof(Vertex::Normal)},
+            {offsetof(Vertex, TexCoords), sizeof(Vertex::TexCoords)},
+            {offsetof(Vertex, Tangent), sizeof(Vertex::Tangent)},
+            {offsetof(Vertex, Bitangent), sizeof(Vertex::Bitangent)}};
+        static const size_t packed[ATTRIBUTE_COUNT][2] = {
+            {offsetof(PackedVertex, Position), sizeof(PackedVertex::Position)},
+            {offsetof(PackedVertex, Normal), sizeof(PackedVertex::Normal)},
+            {offsetof(PackedVertex, TexCoords), sizeof(PackedVertex::TexCoords)},
+            {offsetof(PackedVertex, TangentFrame), sizeof(PackedVertex::TangentFrame)},
+            {0, 0}};
+        if (attribute >= ATTRIBUTE_COUNT)
+                return false;
+        const size_t *format =
+            layout == VertexLayout::Packed ? packed[attribute] : full[attribute];
+        offset = format[0];
+        size = format[1];
+        return size > 0;
+}
+
+// the vertex buffers of a mesh, one per attribute; 0 for the attributes that
+// aren't uploaded
+struct VertexStreams {
+        unsigned int buffers[ATTRIBUTE_COUNT] = {};
+
+        AttributeMask uploaded() const
+        {
+                AttributeMask mask = 0;
+                for (unsigned int i = 0; i < ATTRIBUTE_COUNT; i++)
+                        if (buffers[i] != 0)
+                                mask |= 1u << i;
+                return mask;
+        }
+};
+
+// index range of one level of detail inside the index buffer of a mesh, with the
+// error of its simplification (largest model space distance, see mesh_lod.h) and
+// the meshlets its triangles are grouped in
+struct MeshLod {
+        uint32_t first;
+        uint32_t count;
+        float error;
+        uint32_t firstMeshlet;
+        uint32_t meshletCount;
+};
+
 struct Texture {
         unsigned int id;
         string type;
         string path;
 };
 
+// A mesh owns its vertex arrays and buffers: it can be moved but not copied, and
+// deletes its GL objects when destroyed, so the GL context must still be current
+// then (or destroy() must have been called earlier). Each vertex attribute has a
+// buffer of its own, and only the attributes asked for are uploaded. Every program
+// that draws the mesh gets a vertex array object of its own, which enables just the
+// attributes the program reads.
 class Mesh
 {
       public:
-        // mesh Data
+        // mesh Data. vertices/indices are a CPU-side copy of the geometry, which is
+        // only kept when asked for (keepGeometry) and empty otherwise.
         vector<Vertex> vertices;
         vector<unsigned int> indices;
         vector<Texture> textures;
 
-        unsigned int VAO;
+        unsigned int indexCount;
+        // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, see indexTypeFor()
+        GLenum indexType;
         std::string glslIdentifierPrefix;
-        // constructor
+        // layout of the vertex buffer; packed meshes are drawn with a shader that
+        // decodes PackedVertex and get their quantization as uniforms
+        VertexLayout layout;
+        VertexQuantization quantization;
+        // levels of detail inside the index buffer; empty means a single level made
+        // of all the indices
+        vector<MeshLod> lods;
+        // meshlets of all levels, see MeshLod::firstMeshlet
+        vector<Meshlet> meshlets;
+
+        // constructor. The arrays are taken by value so callers can move them in;
+        // they are freed once uploaded unless keepGeometry is set. Only the given
+        // attributes are uploaded.
         Mesh(vector<Vertex> vertices, vector<unsigned int> indices,
-             vector<Texture> textures)
+             vector<Texture> textures, VertexLayout layout = VertexLayout::Full,
+             bool keepGeometry = false, AttributeMask attributes = ALL_ATTRIBUTES)
         {
-                this->vertices = vertices;
-                this->indices = indices;
-                this->textures = textures;
+                this->vertices = std::move(vertices);
+                this->indices = std::move(indices);
+                this->textures = std::move(textures);
+                this->layout = layout;
 
                 // now that we have all the required data, set the vertex buffers and
                 // its attribute pointers.
-                setupMesh();
-        }
-
-        // render the mesh
-        void Draw(Shader &shader)
-        {
-                // bind appropriate textures
-                unsigned int diffuseNr = 1;
-                unsigned int specularNr = 1;
-                unsigned int normalNr = 1;
-                unsigned int heightNr = 1;
-                for (unsigned int i = 0; i < textures.size(); i++) {
-                        glActiveTexture(GL_TEXTURE0 +
-                                        i); // active proper texture unit before binding
-                        // retrieve texture number (the N in diffuse_textureN)
-                        string number;
-                        string name = textures[i].type;
-                        if (name == "texture_diffuse")
-                                number = std::to_string(diffuseNr++);
-                        else if (name == "texture_specular")
-                                number = std::to_string(
-                                    specularNr++); // transfer unsigned int to stream
-                        else if (name == "texture_normal")
-                                number = std::to_string(
-                                    normalNr++); // transfer unsigned int to stream
-                        else if (name == "texture_height")
-                                number = std::to_string(
-                                    heightNr++); // transfer unsigned int to stream
-
-                        // now set the sampler to the correct texture unit
-                        glUniform1i(glGetUniformLocation(
-                                        shader.ID,
-                                        (glslIdentifierPrefix + name + number).c_str()),
-                                    i);
-                        // and finally bind the texture
-                        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+                if (layout == VertexLayout::Packed) {
+                        vector<PackedVertex> packed;
+                        quantization = packVertices(this->vertices.data(),
+                                                    this->vertices.size(), packed);
+                        setupMesh(packed.data(), packed.size(), attributes,
+                                  this->indices.data(), this->indices.size());
+                } else {
+                        setupMesh(this->vertices.data(), this->vertices.size(),
+                                  attributes, this->indices.data(),
+                                  this->indices.size());
+                }
+                if (!keepGeometry) {
+                        vector<Vertex>().swap(this->vertices);
+                        vector<unsigned int>().swap(this->indices);
+                }
+        }
+
+        // constructor for geometry whose buffers were already filled by
+        // createBuffers(), possibly on another context of the same share group. The
+        // vertex array objects, which aren't shared between contexts, are created
+        // by Draw(), so the mesh must be drawn on one context only. vertices/indices
+        // are left empty, callers that keep the geometry move it in afterwards.
+        Mesh(const VertexStreams &streams, unsigned int EBO, size_t indexCount,
+             GLenum indexType, vector<Texture> textures,
+             VertexLayout layout = VertexLayout::Full,
+             const VertexQuantization &quantization = VertexQuantization())
+        {
+                this->textures = std::move(textures);
+                this->indexCount = indexCount;
+                this->indexType = indexType;
+                this->layout = layout;
+                this->quantization = quantization;
+                this->streams = streams;
+                this->EBO = EBO;
+        }
+
+        Mesh(const Mesh &) = delete;
+        Mesh &operator=(const Mesh &) = delete;
+
+        Mesh(Mesh &&other) noexcept : EBO(0) { *this = std::move(other); }
+
+        Mesh &operator=(Mesh &&other) noexcept
+        {
+                if (this == &other)
+                        return *this;
+                destroy();
+                vertices = std::move(other.vertices);
+                indices = std::move(other.indices);
+                textures = std::move(other.textures);
+                lods = std::move(other.lods);
+                meshlets = std::move(other.meshlets);
+                streams = other.streams;
+                EBO = other.EBO;
+                programs = std::move(other.programs);
+                indexCount = other.indexCount;
+                indexType = other.indexType;
+                glslIdentifierPrefix = std::move(other.glslIdentifierPrefix);
+                layout = other.layout;
+                quantization = other.quantization;
+                other.streams = VertexStreams();
+                other.EBO = 0;
+                other.programs.clear();
+                return *this;
+        }
+
+        ~Mesh() { destroy(); }
+
+        // meshes with fewer than 65536 vertices get 16-bit indices
+        static GLenum indexTypeFor(size_t vertexCount)
+        {
+                return vertexCount < 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        }
+
+        // creates and fills the buffers of the given attributes of vertices in the
+        // given layout, and the index buffer, the indices converted to indexType.
+        // Uses the copy-write target rather than the element array binding, which
+        // belongs to the bound VAO, so it can run on a context without a vertex
+        // array object (e.g. an upload thread).
+        static void createBuffers(const void *vertexData, size_t vertexCount,
+                                  VertexLayout layout, AttributeMask attributes,
+                                  const unsigned int *indexData, size_t indexCount,
+                                  GLenum indexType, VertexStreams &streams,
+                                  unsigned int &EBO)
+        {
+                createStreams(vertexData, vertexCount, layout, attributes, streams);
+                glGenBuffers(1, &EBO);
+                glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+                if (indexType == GL_UNSIGNED_SHORT) {
+                        vector<uint16_t> shortIndices(indexData, indexData + indexCount);
+                        glBufferData(GL_COPY_WRITE_BUFFER, indexCount * sizeof(uint16_t),
+                                     shortIndices.data(), GL_STATIC_DRAW);
+                } else {
+                        glBufferData(GL_COPY_WRITE_BUFFER,
+                                     indexCount * sizeof(unsigned int), indexData,
+                                     GL_STATIC_DRAW);
+                }
+                glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+
+        // creates the buffers of the given attributes that aren't in streams yet,
+        // each filled with the attribute of every vertex, tightly packed
+        static void createStreams(const void *vertexData, size_t vertexCount,
+                                  VertexLayout layout, AttributeMask attributes,
+                                  VertexStreams &streams)
+        {
+                size_t stride = layout == VertexLayout::Packed ? sizeof(PackedVertex)
+                                                               : sizeof(Vertex);
+                vector<unsigned char> stream;
+                for (unsigned int a = 0; a < ATTRIBUTE_COUNT; a++) {
+                        size_t offset, size;
+                        if (!(attributes & (1u << a)) || streams.buffers[a] != 0 ||
+                            !attributeFormat(layout, a, offset, size))
+                                continue;
+                        stream.resize(vertexCount * size);
+                        const unsigned char *source =
+                            static_cast<const unsigned char *>(vertexData) + offset;
+                        for (size_t v = 0; v < vertexCount; v++)
+                                memcpy(&stream[v * size], source + v * stride, size);
+                        glGenBuffers(1, &streams.buffers[a]);
+                        glBindBuffer(GL_COPY_WRITE_BUFFER, streams.buffers[a]);
+                        glBufferData(GL_COPY_WRITE_BUFFER, stream.size(), stream.data(),
+                                     GL_STATIC_DRAW);
+                }
+                glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+
+        // deletes the GL objects of the mesh (textures are owned by the model). Does
+        // nothing once they are gone, so no context is needed after that.
+        void destroy()
+        {
+                for (const ProgramBinding &binding : programs) {
+                        glDeleteVertexArrays(1, &binding.vertexArray);
+                        GLState::instance().vertexArrayDeleted(binding.vertexArray);
+                }
+                programs.clear();
+                for (unsigned int &buffer : streams.buffers) {
+                        if (buffer != 0)
+                                glDeleteBuffers(1, &buffer);
+                        buffer = 0;
+                }
+                if (EBO != 0)
+                        glDeleteBuffers(1, &EBO);
+                EBO = 0;
+        }
+
+        // render the mesh, at the given level of detail (clamped to the coarsest
+        // one). With a culler only the visible meshlets of the level are drawn.
+        void Draw(Shader &shader, size_t level = 0, const MeshletCuller *culler = nullptr)
+        {
+                size_t first = 0, count = indexCount;
+                const MeshLod *lod = nullptr;
+                if (!lods.empty()) {
+                        lod = &lods[std::min(level, lods.size() - 1)];
+                        first = lod->first;
+                        count = lod->count;
+                }
+                size_t ranges = 0;
+                if (culler) {
+                        ranges = cullMeshlets(lod, *culler);
+                        if (lod && lod->meshletCount > 0 && culler->enabled &&
+                            ranges == 0)
+                                return;
+                }
+
+                const ProgramBinding &binding = programBinding(shader);
+                GLState &state = GLState::instance();
+                // bind appropriate textures: set the sampler to the texture unit and
+                // bind the texture to it, both only if they aren't already
+                for (const MaterialBinding &material : binding.materials) {
+                        shader.setInt(material.sampler, material.unit);
+                        state.bindTexture(material.unit, GL_TEXTURE_2D, material.texture);
+                }
+
+                if (layout == VertexLayout::Packed) {
+                        shader.setVec3(binding.positionOffset, quantization.offset);
+                        shader.setVec3(binding.positionScale, quantization.scale);
                 }
 
                 // draw mesh
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-                glBindVertexArray(0);
+                state.bindVertexArray(binding.vertexArray);
+                if (ranges > 0) {
+                        glMultiDrawElements(GL_TRIANGLES, drawCounts.data(), indexType,
+                                            drawOffsets.data(), ranges);
+                } else {
+                        glDrawElements(GL_TRIANGLES, count, indexType,
+                                       (void *)(first * indexSize()));
+                }
+                // the vertex array and textures stay bound: GLState knows they are,
+                // so the next mesh drawn with them doesn't bind them again
+        }
+
+        // makes texture i another GL texture (a loaded one in place of its
+        // placeholder)
+        void setTexture(size_t i, unsigned int id)
+        {
+                textures[i].id = id;
+                for (ProgramBinding &binding : programs)
+                        if (binding.resolved)
+                                binding.materials[i].texture = id;
+        }
 
-                // always good practice to set everything back to defaults once
-                // configured.
-                glActiveTexture(GL_TEXTURE0);
+        // sets the prefix of the sampler names; programs that drew the mesh look
+        // their samplers up again
+        void setSamplerPrefix(const std::string &prefix)
+        {
+                glslIdentifierPrefix = prefix;
+                for (ProgramBinding &binding : programs)
+                        binding.resolved = false;
+        }
+
+        // the sampler uniform texture i is bound to by Draw(): the prefix, the type
+        // and, for the material types, N in the order of the textures of the type
+        // (texture_diffuse1, texture_diffuse2, ...)
+        string samplerName(size_t i) const
+        {
+                const string &type = textures[i].type;
+                if (type != "texture_diffuse" && type != "texture_specular" &&
+                    type != "texture_normal" && type != "texture_height")
+                        return glslIdentifierPrefix + type;
+                unsigned int number = 1;
+                for (size_t j = 0; j < i; j++)
+                        if (textures[j].type == type)
+                                number++;
+                return glslIdentifierPrefix + type + std::to_string(number);
+        }
+
+        // whether a program with the given active samplers reads texture i when
+        // drawing the mesh: through the sampler of its slot, or through another
+        // sampler that is left on texture unit i
+        bool samples(size_t i, const vector<ActiveSampler> &samplers) const
+        {
+                for (const ActiveSampler &sampler : samplers) {
+                        size_t slot = textures.size();
+                        for (size_t j = 0; j < textures.size(); j++) {
+                                if (samplerName(j) == sampler.name) {
+                                        slot = j;
+                                        break;
+                                }
+                        }
+                        if (slot < textures.size() ? slot == i : sampler.unit == (int)i)
+                                return true;
+                }
+                return false;
         }
 
       private:
         // render data
-        unsigned int VBO, EBO;
+        VertexStreams streams;
+        unsigned int EBO;
+        // texture i of the material as a program reads it: bound to unit i, with
+        // the program's sampler for it (invalid if the program has none)
+        struct MaterialBinding {
+                unsigned int unit;
+                unsigned int texture;
+                Uniform sampler;
+        };
 
-        // initializes all the buffer objects/arrays
-        void setupMesh()
+        // what drawing the mesh with a program takes, resolved the first time the
+        // program draws it, so drawing does no string work or lookups by name
+        struct ProgramBinding {
+                unsigned int program;
+                unsigned int vertexArray;
+                bool resolved;
+                // one entry per texture, in order
+                vector<MaterialBinding> materials;
+                Uniform positionOffset;
+                Uniform positionScale;
+        };
+
+        // every program that has drawn the mesh
+        vector<ProgramBinding> programs;
+        // index ranges of the visible meshlets, reused from draw to draw
+        vector<GLsizei> drawCounts;
+        vector<const void *> drawOffsets;
+
+        size_t indexSize() const { return indexType == GL_UNSIGNED_SHORT ? 2 : 4; }
+
+        // collects the index ranges of the visible meshlets of a level in
+        // drawCounts/drawOffsets, merging neighbours, and returns how many there
+        // are. Returns 0 (draw the whole level) when culling is off or the level has
+        // no meshlets.
+        size_t cullMeshlets(const MeshLod *lod, const MeshletCuller &culler)
         {
-                // create buffers/arrays
-                glGenVertexArrays(1, &VAO);
-                glGenBuffers(1, &VBO);
-                glGenBuffers(1, &EBO);
+                ClusterStats *stats = culler.stats;
+                if (!lod || lod->meshletCount == 0 || !culler.enabled) {
+                        if (stats) {
+                                stats->triangles += (lod ? lod->count : indexCount) / 3;
+                                stats->visibleTriangles +=
+                                    (lod ? lod->count : indexCount) / 3;
+                                stats->drawCalls++;
+                        }
+                        return 0;
+                }
+                auto start = std::chrono::steady_clock::now();
+                drawCounts.clear();
+                drawOffsets.clear();
+                size_t end = 0, visible = 0, triangles = 0;
+                for (size_t m = lod->firstMeshlet;
+                     m < lod->firstMeshlet + lod->meshletCount; m++) {
+                        const Meshlet &meshlet = meshlets[m];
+                        if (!culler.visible(meshlet))
+                                continue;
+                        visible++;
+                        triangles += meshlet.count / 3;
+                        if (!drawCounts.empty() && end == meshlet.first) {
+                                drawCounts.back() += meshlet.count;
+                        } else {
+                                drawCounts.push_back(meshlet.count);
+                                drawOffsets.push_back(
+                                    (const void *)(meshlet.first * indexSize()));
+                        }
+                        end = meshlet.first + meshlet.count;
+                }
+                if (stats) {
+                        stats->clusters += lod->meshletCount;
+                        stats->visibleClusters += visible;
+                        stats->triangles += lod->count / 3;
+                        stats->visibleTriangles += triangles;
+                        stats->drawCalls += drawCounts.empty() ? 0 : 1;
+                        stats->cullTime += std::chrono::duration<double, std::milli>(
+                                               std::chrono::steady_clock::now() - start)
+                                               .count();
+                }
+                return drawCounts.size();
+        }
+
+        // initializes all the buffer objects
+        void setupMesh(const void *vertexData, size_t vertexCount,
+                       AttributeMask attributes, const unsigned int *indexData,
+                       size_t indexCount)
+        {
+                this->indexCount = indexCount;
+                this->indexType = indexTypeFor(vertexCount);
+                createBuffers(vertexData, vertexCount, layout, attributes, indexData,
+                              indexCount, indexType, streams, EBO);
+        }
 
-                glBindVertexArray(VAO);
-                // load data into vertex buffers
-                glBindBuffer(GL_ARRAY_BUFFER, VBO);
-                // A great thing about structs is that their memory layout is sequential
-                // for all its items. The effect is that we can simply pass a pointer to
-                // the struct and it translates perfectly to a glm::vec3/2 array which
-                // again translates to 3/2 floats which translates to a byte array.
-                glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex),
-                             &vertices[0], GL_STATIC_DRAW);
+        // a vertex array object that draws the mesh with a program, for its
+        // ProgramBinding: the attributes the program reads are enabled,
+        // the rest stay off. Attributes the program reads but the mesh didn't upload
+        // are uploaded now when the geometry is kept; otherwise the program gets
+        // the constant attribute value for them.
+        unsigned int createVertexArray(const Shader &shader)
+        {
+                AttributeMask wanted = shader.activeAttributes() & ALL_ATTRIBUTES;
+                AttributeMask missing = wanted & ~streams.uploaded();
+                if (missing && !vertices.empty()) {
+                        if (layout == VertexLayout::Packed) {
+                                vector<PackedVertex> packed;
+                                packVertices(vertices.data(), vertices.size(), packed);
+                                createStreams(packed.data(), packed.size(), layout,
+                                              missing, streams);
+                        } else {
+                                createStreams(vertices.data(), vertices.size(), layout,
+                                              missing, streams);
+                        }
+                        missing = wanted & ~streams.uploaded();
+                }
+                if (missing)
+                        cout << "WARNING::MESH:: program " << shader.ID
+                             << " reads vertex attributes (mask " << missing
+                             << ") that weren't uploaded" << endl;
 
+                unsigned int VAO;
+                glGenVertexArrays(1, &VAO);
+                GLState::instance().bindVertexArray(VAO);
                 glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-                glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                             indices.size() * sizeof(unsigned int), &indices[0],
-                             GL_STATIC_DRAW);
-
-                // set the vertex attribute pointers
-                // vertex Positions
-                glEnableVertexAttribArray(0);
-                glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                                      (void *)0);
-                // vertex normals
-                glEnableVertexAttribArray(1);
-                glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                                      (void *)offsetof(Vertex, Normal));
-                // vertex texture coords
-                glEnableVertexAttribArray(2);
-                glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                                      (void *)offsetof(Vertex, TexCoords));
-                // vertex tangent
-                glEnableVertexAttribArray(3);
-                glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                                      (void *)offsetof(Vertex, Tangent));
-                // vertex bitangent
-                glEnableVertexAttribArray(4);
-                glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                                      (void *)offsetof(Vertex, Bitangent));
-
-                glBindVertexArray(0);
+                for (unsigned int a = 0; a < ATTRIBUTE_COUNT; a++) {
+                        if (!(wanted & (1u << a)) || streams.buffers[a] == 0)
+                                continue;
+                        glBindBuffer(GL_ARRAY_BUFFER, streams.buffers[a]);
+                        glEnableVertexAttribArray(a);
+                        if (layout == VertexLayout::Packed)
+                                setPackedAttribute(a);
+                        else
+                                setAttribute(a);
+                }
+                return VAO;
+        }
+
+        // the binding of a program, made (or resolved again after a change of the
+        // sampler prefix) the first time the program draws the mesh
+        const ProgramBinding &programBinding(const Shader &shader)
+        {
+                ProgramBinding *binding = nullptr;
+                for (ProgramBinding &candidate : programs)
+                        if (candidate.program == shader.ID)
+                                binding = &candidate;
+                if (!binding) {
+                        programs.push_back(ProgramBinding());
+                        binding = &programs.back();
+                        binding->program = shader.ID;
+                        binding->vertexArray = createVertexArray(shader);
+                        binding->resolved = false;
+                }
+                if (!binding->resolved) {
+                        binding->materials.clear();
+                        for (unsigned int i = 0; i < textures.size(); i++)
+                                binding->materials.push_back(MaterialBinding{
+                                    i, textures[i].id, shader.uniform(samplerName(i))});
+                        binding->positionOffset =
+                            shader.uniform(UNIFORM("positionOffset"));
+                        binding->positionScale = shader.uniform(UNIFORM("positionScale"));
+                        binding->resolved = true;
+                }
+                return *binding;
+        }
+
+        // attribute pointer of a stream of struct Vertex members
+        static void setAttribute(unsigned int attribute)
+        {
+                // vertex positions, normals, texture coords, tangents, bitangents
+                static const GLint components[ATTRIBUTE_COUNT] = {3, 3, 2, 3, 3};
+                glVertexAttribPointer(attribute, components[attribute], GL_FLOAT,
+                                      GL_FALSE, 0, (void *)0);
+        }
+
+        // attribute pointer of a stream of PackedVertex members, see
+        // modelLightingPacked.vs for the decoding
+        static void setPackedAttribute(unsigned int attribute)
+        {
+                switch (attribute) {
+                case ATTRIBUTE_POSITION:
+                        // quantized position + handedness
+                        glVertexAttribPointer(attribute, 4, GL_UNSIGNED_SHORT, GL_TRUE,
+                                              0, (void *)0);
+                        break;
+                case ATTRIBUTE_NORMAL:
+                        // octahedral normal
+                        glVertexAttribPointer(attribute, 2, GL_SHORT, GL_TRUE, 0,
+                                              (void *)0);
+                        break;
+                case ATTRIBUTE_TEXCOORDS:
+                        // half float texture coords
+                        glVertexAttribPointer(attribute, 2, GL_HALF_FLOAT, GL_FALSE, 0,
+                                              (void *)0);
+                        break;
+                case ATTRIBUTE_TANGENT:
+                        // tangent frame quaternion, read as an integer
+                        glVertexAttribIPointer(attribute, 1, GL_UNSIGNED_INT, 0,
+                                               (void *)0);
+                        break;
+                }
         }
 };
 #endif
\ No newline at end of file
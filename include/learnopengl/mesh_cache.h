@@ -0,0 +1,431 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/resource_pack.h>
+
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Binary cache of the processed (post-import) geometry of a model. The cache is
+// written next to the source file as "<source>.meshcache" and holds, for every
+// mesh, the final Vertex array, the index array and the list of material textures.
+// It is keyed by a hash of the source file, of every material library ('mtllib') an
+// OBJ source names, the importer that produced the meshes and the Assimp import
+// flags, so it rebuilds by itself whenever the model, its materials, the importer or
+// the import settings change. A cache
+// found in the resource pack is used as it is, as long as neither its source nor a
+// material library is newer than the pack: the asset cooker already checked it
+// against them, and they don't have to ship with the pack.
+//
+// Layout (all integers little endian, every block 4-byte aligned):
+//   MeshCacheHeader
+//   per material library: MeshCacheLibrary, path (relative to the source)
+//   per mesh: MeshCacheRecord, textures (type/path strings), levels of detail
+//             (MeshLod), meshlets, vertices, indices
+
+const uint32_t MESH_CACHE_VERSION = 11;
+
+// importer of the cached meshes: the loader in the top byte, its version below it
+// (Model::loaderId)
+const uint32_t MESH_LOADER_ASSIMP = 1u << 24;
+
+// material texture reference as it comes out of the importer, before the image
+// is decoded and uploaded
+struct TextureRef {
+        string type;
+        string path;
+};
+
+// CPU side result of importing a single mesh. indices holds every level of
+// detail, one after the other, as described by lods.
+struct MeshData {
+        vector<Vertex> vertices;
+        vector<unsigned int> indices;
+        vector<MeshLod> lods;
+        vector<Meshlet> meshlets;
+        vector<TextureRef> textures;
+};
+
+struct MeshCacheHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t vertexSize;
+        uint32_t importFlags;
+        uint32_t meshCount;
+        uint64_t sourceHash;
+        uint64_t sourceSize;
+        uint32_t libraryCount;
+        uint32_t loader;
+};
+
+// a material library the source refers to, as it was when the cache was written. A
+// library that couldn't be read has the size NO_LIBRARY, so the cache is rebuilt
+// once it appears.
+struct MeshCacheLibrary {
+        uint64_t hash;
+        uint64_t size;
+};
+
+const uint64_t NO_LIBRARY = ~0ull;
+
+struct MeshCacheRecord {
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t textureCount;
+        uint32_t lodCount;
+        uint32_t meshletCount;
+        uint32_t reserved;
+};
+
+class MeshCache
+{
+      public:
+        // view of one cached mesh, pointing straight into the mapped file
+        struct Entry {
+                const Vertex *vertices;
+                size_t vertexCount;
+                const unsigned int *indices;
+                size_t indexCount;
+                vector<MeshLod> lods;
+                vector<Meshlet> meshlets;
+                vector<TextureRef> textures;
+        };
+
+        static string cachePath(const string &sourcePath)
+        {
+                return sourcePath + ".meshcache";
+        }
+
+        // maps the cache of the given source file. Returns false when there is no
+        // cache yet or when it is stale (different source, importer, flags or
+        // format).
+        bool open(const string &sourcePath, uint32_t loader, unsigned int importFlags)
+        {
+                close();
+                if (!file.open(cachePath(sourcePath)))
+                        return false;
+                // a packed cache was checked against its sources when it was cooked
+                bool current = file.packed && packedCurrent(sourcePath);
+                if (!current && !matchesSource(sourcePath))
+                        return fail();
+                return parse(file.data, file.size, loader, importFlags) || fail();
+        }
+
+        // views a cache that is already in memory, without checking it against
+        // its source. The memory has to outlive the entries.
+        bool view(const unsigned char *data, size_t size, uint32_t loader,
+                  unsigned int importFlags)
+        {
+                close();
+                return parse(data, size, loader, importFlags) || fail();
+        }
+
+        size_t meshCount() const { return entries.size(); }
+        const Entry &mesh(size_t i) const { return entries[i]; }
+
+        // unmaps the cache; the entries are gone with it
+        void close()
+        {
+                entries.clear();
+                file.close();
+        }
+
+        // writes a fresh cache for the given source file. The file is written under
+        // a temporary name and renamed, so a crash never leaves a torn cache behind.
+        static bool write(const string &sourcePath, uint32_t loader,
+                          unsigned int importFlags, const vector<MeshData> &meshes)
+        {
+                string path = cachePath(sourcePath);
+                string tmpPath = path + ".tmp";
+                {
+                        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+                        if (!out || !write(sourcePath, loader, importFlags, meshes, out))
+                                return false;
+                }
+                return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+        }
+
+        // writes the cache of the given source file to a stream (the asset cooker
+        // puts it into the resource pack)
+        static bool write(const string &sourcePath, uint32_t loader,
+                          unsigned int importFlags, const vector<MeshData> &meshes,
+                          std::ostream &out)
+        {
+                MeshCacheHeader header;
+                memcpy(header.magic, "LOGLMESH", 8);
+                header.version = MESH_CACHE_VERSION;
+                header.vertexSize = sizeof(Vertex);
+                header.importFlags = importFlags;
+                header.meshCount = meshes.size();
+                vector<Library> libraries;
+                if (!hashSources(sourcePath, header.sourceHash, header.sourceSize,
+                                 libraries))
+                        return false;
+                header.libraryCount = libraries.size();
+                header.loader = loader;
+
+                out.write((const char *)&header, sizeof(header));
+                for (const Library &library : libraries) {
+                        out.write((const char *)&library.state, sizeof(library.state));
+                        writeString(out, library.path);
+                }
+                for (const MeshData &mesh : meshes) {
+                        MeshCacheRecord record;
+                        record.vertexCount = mesh.vertices.size();
+                        record.indexCount = mesh.indices.size();
+                        record.textureCount = mesh.textures.size();
+                        record.lodCount = mesh.lods.size();
+                        record.meshletCount = mesh.meshlets.size();
+                        record.reserved = 0;
+                        out.write((const char *)&record, sizeof(record));
+                        for (const TextureRef &ref : mesh.textures) {
+                                writeString(out, ref.type);
+                                writeString(out, ref.path);
+                        }
+                        out.write((const char *)mesh.lods.data(),
+                                  mesh.lods.size() * sizeof(MeshLod));
+                        out.write((const char *)mesh.meshlets.data(),
+                                  mesh.meshlets.size() * sizeof(Meshlet));
+                        out.write((const char *)mesh.vertices.data(),
+                                  mesh.vertices.size() * sizeof(Vertex));
+                        out.write((const char *)mesh.indices.data(),
+                                  mesh.indices.size() * sizeof(unsigned int));
+                }
+                return (bool)out;
+        }
+
+      private:
+        struct Library {
+                string path;
+                MeshCacheLibrary state;
+        };
+
+        FileView file;
+        vector<Entry> entries;
+
+        bool fail()
+        {
+                entries.clear();
+                file.close();
+                return false;
+        }
+
+        // whether the mapped cache was made from the current source file and
+        // material libraries
+        bool matchesSource(const string &sourcePath) const
+        {
+                uint64_t sourceHash, sourceSize;
+                vector<Library> libraries;
+                const unsigned char *cursor = file.data;
+                const unsigned char *end = file.data + file.size;
+                MeshCacheHeader header;
+                if (!read(cursor, end, &header, sizeof(header)) ||
+                    !hashSources(sourcePath, sourceHash, sourceSize, libraries))
+                        return false;
+                if (header.sourceHash != sourceHash || header.sourceSize != sourceSize ||
+                    header.libraryCount != libraries.size())
+                        return false;
+                for (const Library &library : libraries) {
+                        MeshCacheLibrary state;
+                        string path;
+                        if (!read(cursor, end, &state, sizeof(state)) ||
+                            !readString(cursor, end, path) || path != library.path ||
+                            state.hash != library.state.hash ||
+                            state.size != library.state.size)
+                                return false;
+                }
+                return true;
+        }
+
+        // whether no source of the mapped (packed) cache was edited since the pack
+        // was cooked
+        bool packedCurrent(const string &sourcePath) const
+        {
+                const ResourcePack &pack = ResourcePack::instance();
+                if (pack.overridden(sourcePath))
+                        return false;
+                const unsigned char *cursor = file.data;
+                const unsigned char *end = file.data + file.size;
+                MeshCacheHeader header;
+                if (!read(cursor, end, &header, sizeof(header)))
+                        return false;
+                string directory = sourcePath.substr(0, sourcePath.find_last_of('/') + 1);
+                for (uint32_t i = 0; i < header.libraryCount; i++) {
+                        MeshCacheLibrary state;
+                        string path;
+                        if (!read(cursor, end, &state, sizeof(state)) ||
+                            !readString(cursor, end, path) ||
+                            pack.overridden(directory + path))
+                                return false;
+                }
+                return true;
+        }
+
+        bool parse(const unsigned char *data, size_t size, uint32_t loader,
+                   unsigned int importFlags)
+        {
+                const unsigned char *cursor = data;
+                const unsigned char *end = data + size;
+                MeshCacheHeader header;
+                if (!read(cursor, end, &header, sizeof(header)) ||
+                    memcmp(header.magic, "LOGLMESH", 8) != 0 ||
+                    header.version != MESH_CACHE_VERSION ||
+                    header.vertexSize != sizeof(Vertex) || header.loader != loader ||
+                    header.importFlags != importFlags)
+                        return false;
+                for (uint32_t i = 0; i < header.libraryCount; i++) {
+                        MeshCacheLibrary state;
+                        string path;
+                        if (!read(cursor, end, &state, sizeof(state)) ||
+                            !readString(cursor, end, path))
+                                return false;
+                }
+
+                for (uint32_t i = 0; i < header.meshCount; i++) {
+                        MeshCacheRecord record;
+                        Entry entry;
+                        if (!read(cursor, end, &record, sizeof(record))) {
+                                return false;
+                        }
+                        for (uint32_t t = 0; t < record.textureCount; t++) {
+                                TextureRef ref;
+                                if (!readString(cursor, end, ref.type) ||
+                                    !readString(cursor, end, ref.path))
+                                        return false;
+                                entry.textures.push_back(ref);
+                        }
+                        entry.lods.resize(record.lodCount);
+                        if (!read(cursor, end, entry.lods.data(),
+                                  record.lodCount * sizeof(MeshLod)))
+                                return false;
+                        entry.meshlets.resize(record.meshletCount);
+                        if (!read(cursor, end, entry.meshlets.data(),
+                                  record.meshletCount * sizeof(Meshlet)))
+                                return false;
+                        size_t vertexBytes = record.vertexCount * sizeof(Vertex);
+                        size_t indexBytes = record.indexCount * sizeof(unsigned int);
+                        if ((size_t)(end - cursor) < vertexBytes + indexBytes)
+                                return false;
+                        entry.vertices = reinterpret_cast<const Vertex *>(cursor);
+                        entry.vertexCount = record.vertexCount;
+                        cursor += vertexBytes;
+                        entry.indices = reinterpret_cast<const unsigned int *>(cursor);
+                        entry.indexCount = record.indexCount;
+                        cursor += indexBytes;
+                        entries.push_back(entry);
+                }
+                return true;
+        }
+
+        // hashes the source file and the material libraries it names, which are
+        // read from where ASSIMP looks for them: the directory of the source
+        static bool hashSources(const string &sourcePath, uint64_t &hash,
+                                uint64_t &size, vector<Library> &libraries)
+        {
+                FileView source;
+                if (!source.open(sourcePath))
+                        return false;
+                hash = hashBytes(source.data, source.size);
+                size = source.size;
+                libraries.clear();
+                if (!isObj(sourcePath))
+                        return true;
+                string directory = sourcePath.substr(0, sourcePath.find_last_of('/') + 1);
+                for (const string &path : materialLibraries(source.data, source.size)) {
+                        Library library;
+                        library.path = path;
+                        FileView view;
+                        if (view.open(directory + path)) {
+                                library.state.hash = hashBytes(view.data, view.size);
+                                library.state.size = view.size;
+                        } else {
+                                library.state.hash = 0;
+                                library.state.size = NO_LIBRARY;
+                        }
+                        libraries.push_back(library);
+                }
+                return true;
+        }
+
+        static bool isObj(const string &path)
+        {
+                size_t dot = path.find_last_of('.');
+                if (dot == string::npos || path.size() - dot != 4)
+                        return false;
+                string extension = path.substr(dot + 1);
+                for (char &c : extension)
+                        c = (char)tolower((unsigned char)c);
+                return extension == "obj";
+        }
+
+        // the names of the 'mtllib' statements of an OBJ file, as ASSIMP reads
+        // them: the rest of the line, trimmed
+        static vector<string> materialLibraries(const unsigned char *data, size_t size)
+        {
+                vector<string> libraries;
+                const char *p = reinterpret_cast<const char *>(data);
+                const char *end = p + size;
+                while (p < end) {
+                        const char *lineEnd =
+                            static_cast<const char *>(memchr(p, '\n', end - p));
+                        if (!lineEnd)
+                                lineEnd = end;
+                        while (p < lineEnd && (*p == ' ' || *p == '\t'))
+                                p++;
+                        if (lineEnd - p > 6 && memcmp(p, "mtllib", 6) == 0 &&
+                            (p[6] == ' ' || p[6] == '\t')) {
+                                const char *first = p + 6;
+                                const char *last = lineEnd;
+                                while (first < last && isspace((unsigned char)*first))
+                                        first++;
+                                while (last > first && isspace((unsigned char)last[-1]))
+                                        last--;
+                                if (first < last)
+                                        libraries.push_back(string(first, last));
+                        }
+                        p = lineEnd + 1;
+                }
+                return libraries;
+        }
+
+        static bool read(const unsigned char *&cursor, const unsigned char *end,
+                         void *dst, size_t size)
+        {
+                if ((size_t)(end - cursor) < size)
+                        return false;
+                memcpy(dst, cursor, size);
+                cursor += size;
+                return true;
+        }
+
+        // strings are stored as a 32-bit length followed by the bytes, padded to 4
+        static bool readString(const unsigned char *&cursor, const unsigned char *end,
+                               string &str)
+        {
+                uint32_t length;
+                if (!read(cursor, end, &length, sizeof(length)))
+                        return false;
+                size_t padded = (length + 3) & ~3u;
+                if ((size_t)(end - cursor) < padded)
+                        return false;
+                str.assign((const char *)cursor, length);
+                cursor += padded;
+                return true;
+        }
+
+        static void writeString(std::ostream &out, const string &str)
+        {
+                uint32_t length = str.size();
+                out.write((const char *)&length, sizeof(length));
+                out.write(str.data(), str.size());
+                static const char padding[4] = {0, 0, 0, 0};
+                out.write(padding, ((length + 3) & ~3u) - length);
+        }
+};
+#endif
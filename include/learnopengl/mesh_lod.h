@@ -0,0 +1,400 @@
+#ifndef MESH_LOD_H
+#define MESH_LOD_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <learnopengl/render_view.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Level of detail chains. At import every mesh gets up to MAX_LOD_LEVELS - 1
+// simplified versions of its triangle list, appended to its index array and
+// sharing its vertices (see MeshLod). Simplification is quadric error edge collapse
+// (Garland, Heckbert: "Surface Simplification Using Quadric Error Metrics", 1997)
+// restricted to half-edge collapses, so no new vertices are made. The quadrics only
+// order the collapses; the error of a level is the furthest any vertex has moved,
+// which bounds how far the surface is from the original. Vertices on UV or normal
+// seams, on open borders and on non-manifold edges never move, and a collapse is
+// rejected when it would flip a triangle, make the mesh non-manifold (the link
+// condition) or merge vertices whose normals differ too much.
+//
+// At draw time Model picks one level for all its meshes: the coarsest one whose
+// error, projected on screen, stays below LOD_PIXEL_ERROR (see selectLod).
+
+const size_t MAX_LOD_LEVELS = 4;
+// every level aims for this fraction of the triangles of the previous one
+const float LOD_REDUCTION = 0.5f;
+// a level that doesn't get below this fraction of the previous one isn't kept
+const float LOD_MIN_REDUCTION = 0.8f;
+// largest error of a level, relative to the radius of the mesh
+const float LOD_MAX_ERROR = 0.05f;
+// vertices with normals further apart than this (cosine) are never merged
+const float LOD_NORMAL_COSINE = 0.9f;
+// projected error, in pixels, a level may have to be drawn
+const float LOD_PIXEL_ERROR = 1.0f;
+// a coarser level is only picked once its error is below this fraction of
+// LOD_PIXEL_ERROR, so a camera hovering around a threshold doesn't flip levels
+const float LOD_HYSTERESIS = 0.5f;
+
+// sum of squared distances to a set of planes, weighted by triangle area
+struct Quadric {
+        double a2, b2, c2, ab, ac, bc, ad, bd, cd, d2;
+        double weight;
+
+        Quadric() : a2(0), b2(0), c2(0), ab(0), ac(0), bc(0), ad(0), bd(0), cd(0), d2(0),
+                    weight(0)
+        {
+        }
+
+        void addPlane(const glm::vec3 &n, double d, double w)
+        {
+                a2 += w * n.x * n.x;
+                b2 += w * n.y * n.y;
+                c2 += w * n.z * n.z;
+                ab += w * n.x * n.y;
+                ac += w * n.x * n.z;
+                bc += w * n.y * n.z;
+                ad += w * n.x * d;
+                bd += w * n.y * d;
+                cd += w * n.z * d;
+                d2 += w * d * d;
+                weight += w;
+        }
+
+        void add(const Quadric &q)
+        {
+                a2 += q.a2;
+                b2 += q.b2;
+                c2 += q.c2;
+                ab += q.ab;
+                ac += q.ac;
+                bc += q.bc;
+                ad += q.ad;
+                bd += q.bd;
+                cd += q.cd;
+                d2 += q.d2;
+                weight += q.weight;
+        }
+
+        // mean squared distance of p to the planes
+        double error(const glm::vec3 &p) const
+        {
+                double x = p.x, y = p.y, z = p.z;
+                double e = a2 * x * x + b2 * y * y + c2 * z * z +
+                           2.0 * (ab * x * y + ac * x * z + bc * y * z) +
+                           2.0 * (ad * x + bd * y + cd * z) + d2;
+                return weight > 0.0 ? std::max(0.0, e / weight) : 0.0;
+        }
+};
+
+// Simplifies a triangle list towards targetIndexCount indices without moving any
+// vertex by more than maxError (model space). error receives the largest distance
+// any vertex of the input ended up from where it started.
+inline vector<unsigned int> simplifyMesh(const vector<Vertex> &vertices,
+                                         const unsigned int *sourceIndices,
+                                         size_t indexCount, size_t targetIndexCount,
+                                         float maxError, float &error)
+{
+        vector<unsigned int> indices(sourceIndices, sourceIndices + indexCount);
+        size_t vertexCount = vertices.size();
+        error = 0.0f;
+
+        // vertices sharing a position (UV and normal seams) map to the same one
+        vector<unsigned int> position(vertexCount);
+        vector<unsigned int> wedges(vertexCount, 0);
+        {
+                std::unordered_map<uint64_t, vector<unsigned int>> buckets;
+                for (unsigned int v = 0; v < vertexCount; v++) {
+                        const glm::vec3 &p = vertices[v].Position;
+                        glm::vec3 key = p + glm::vec3(0.0f); // -0 hashes as +0
+                        uint64_t hash =
+                            hashBytes((const unsigned char *)&key, sizeof(key));
+                        vector<unsigned int> &bucket = buckets[hash];
+                        position[v] = v;
+                        for (unsigned int other : bucket) {
+                                if (vertices[other].Position == p) {
+                                        position[v] = other;
+                                        break;
+                                }
+                        }
+                        if (position[v] == v)
+                                bucket.push_back(v);
+                        wedges[position[v]]++;
+                }
+        }
+
+        // seams, open borders and non-manifold edges are locked
+        vector<bool> locked(vertexCount, false);
+        {
+                std::unordered_map<uint64_t, int> edges;
+                for (size_t i = 0; i < indices.size(); i += 3) {
+                        for (int k = 0; k < 3; k++) {
+                                uint64_t a = position[indices[i + k]];
+                                uint64_t b = position[indices[i + (k + 1) % 3]];
+                                edges[std::min(a, b) << 32 | std::max(a, b)]++;
+                        }
+                }
+                for (const auto &edge : edges) {
+                        if (edge.second != 2) {
+                                locked[edge.first >> 32] = true;
+                                locked[edge.first & 0xffffffffu] = true;
+                        }
+                }
+                for (unsigned int v = 0; v < vertexCount; v++)
+                        if (wedges[position[v]] > 1 || locked[position[v]])
+                                locked[v] = true;
+        }
+
+        // one quadric per position, from the planes of the triangles around it
+        vector<Quadric> quadrics(vertexCount);
+        for (size_t i = 0; i < indices.size(); i += 3) {
+                const glm::vec3 &a = vertices[indices[i]].Position;
+                const glm::vec3 &b = vertices[indices[i + 1]].Position;
+                const glm::vec3 &c = vertices[indices[i + 2]].Position;
+                glm::vec3 n = glm::cross(b - a, c - a);
+                float area = glm::length(n);
+                if (area <= 0.0f)
+                        continue;
+                n /= area;
+                double d = -glm::dot(n, a);
+                for (int k = 0; k < 3; k++)
+                        quadrics[position[indices[i + k]]].addPlane(n, d, area);
+        }
+
+        struct Collapse {
+                unsigned int from;
+                unsigned int to;
+                double cost;
+        };
+        vector<unsigned int> offsets, adjacency;
+        vector<Collapse> candidates;
+        vector<bool> touched;
+        vector<unsigned int> target(vertexCount);
+        // the input vertices collapsed into each vertex so far
+        vector<vector<unsigned int>> merged(vertexCount);
+        vector<unsigned int> fromRing, toRing;
+
+        // how far moving from onto to takes from and everything merged into it
+        auto distance = [&](unsigned int from, unsigned int to) {
+                const glm::vec3 &p = vertices[to].Position;
+                float d = glm::length(vertices[from].Position - p);
+                for (unsigned int v : merged[from])
+                        d = std::max(d, glm::length(vertices[v].Position - p));
+                return d;
+        };
+
+        // the positions sharing a triangle with position p, each once
+        auto ring = [&](unsigned int p, vector<unsigned int> &out) {
+                out.clear();
+                for (unsigned int a = offsets[p]; a < offsets[p + 1]; a++) {
+                        for (int k = 0; k < 3; k++) {
+                                unsigned int q = position[indices[adjacency[a] * 3 + k]];
+                                if (q != p && std::find(out.begin(), out.end(), q) ==
+                                                  out.end())
+                                        out.push_back(q);
+                        }
+                }
+        };
+
+        while (indices.size() > targetIndexCount) {
+                // triangles around every position
+                offsets.assign(vertexCount + 1, 0);
+                for (unsigned int index : indices)
+                        offsets[position[index] + 1]++;
+                for (size_t v = 0; v < vertexCount; v++)
+                        offsets[v + 1] += offsets[v];
+                adjacency.resize(indices.size());
+                vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+                for (size_t i = 0; i < indices.size(); i++)
+                        adjacency[fill[position[indices[i]]]++] = i / 3;
+
+                candidates.clear();
+                for (size_t i = 0; i < indices.size(); i += 3) {
+                        for (int k = 0; k < 3; k++) {
+                                unsigned int ends[2] = {indices[i + k],
+                                                        indices[i + (k + 1) % 3]};
+                                for (int e = 0; e < 2; e++) {
+                                        unsigned int from = ends[e], to = ends[1 - e];
+                                        if (locked[from] || distance(from, to) > maxError)
+                                                continue;
+                                        Collapse collapse = {
+                                            from, to,
+                                            quadrics[from].error(vertices[to].Position)};
+                                        candidates.push_back(collapse);
+                                }
+                        }
+                }
+                std::sort(candidates.begin(), candidates.end(),
+                          [](const Collapse &a, const Collapse &b) {
+                                  return a.cost < b.cost;
+                          });
+
+                // apply the cheapest collapses that don't touch each other; every
+                // collapse removes about two triangles
+                size_t wanted = (indices.size() - targetIndexCount) / 6 + 1;
+                size_t applied = 0;
+                touched.assign(vertexCount, false);
+                for (size_t v = 0; v < vertexCount; v++)
+                        target[v] = v;
+                for (const Collapse &collapse : candidates) {
+                        if (applied >= wanted)
+                                break;
+                        unsigned int from = collapse.from, to = collapse.to;
+                        unsigned int toPosition = position[to];
+                        if (touched[from] || touched[toPosition])
+                                continue;
+                        if (glm::dot(vertices[from].Normal, vertices[to].Normal) <
+                            LOD_NORMAL_COSINE)
+                                continue;
+                        // link condition: the only positions next to both ends are
+                        // the tips of the two triangles on the edge, or the collapse
+                        // would pinch the surface into a non-manifold edge
+                        ring(from, fromRing);
+                        ring(toPosition, toRing);
+                        size_t shared = 0;
+                        for (unsigned int p : fromRing)
+                                if (std::find(toRing.begin(), toRing.end(), p) !=
+                                    toRing.end())
+                                        shared++;
+                        if (shared != 2)
+                                continue;
+                        // the triangles that keep existing must not flip over
+                        bool flips = false;
+                        for (unsigned int a = offsets[from]; a < offsets[from + 1]; a++) {
+                                const unsigned int *t = &indices[adjacency[a] * 3];
+                                if (position[t[0]] == toPosition ||
+                                    position[t[1]] == toPosition ||
+                                    position[t[2]] == toPosition)
+                                        continue;
+                                glm::vec3 p[3], q[3];
+                                for (int k = 0; k < 3; k++) {
+                                        p[k] = vertices[t[k]].Position;
+                                        q[k] = t[k] == from ? vertices[to].Position
+                                                            : p[k];
+                                }
+                                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                                glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+                                if (glm::dot(before, after) <= 0.0f) {
+                                        flips = true;
+                                        break;
+                                }
+                        }
+                        if (flips)
+                                continue;
+
+                        // the whole ring changes shape, so it is left alone for the
+                        // rest of the pass
+                        for (unsigned int a = offsets[from]; a < offsets[from + 1]; a++)
+                                for (int k = 0; k < 3; k++)
+                                        touched[position[indices[adjacency[a] * 3 + k]]] =
+                                            true;
+                        target[from] = to;
+                        quadrics[toPosition].add(quadrics[from]);
+                        error = std::max(error, distance(from, to));
+                        merged[to].push_back(from);
+                        merged[to].insert(merged[to].end(), merged[from].begin(),
+                                          merged[from].end());
+                        applied++;
+                }
+                if (applied == 0)
+                        break;
+
+                // remap and drop the triangles that collapsed
+                size_t kept = 0;
+                for (size_t i = 0; i < indices.size(); i += 3) {
+                        unsigned int a = target[indices[i]];
+                        unsigned int b = target[indices[i + 1]];
+                        unsigned int c = target[indices[i + 2]];
+                        if (position[a] == position[b] || position[b] == position[c] ||
+                            position[a] == position[c])
+                                continue;
+                        indices[kept++] = a;
+                        indices[kept++] = b;
+                        indices[kept++] = c;
+                }
+                indices.resize(kept);
+        }
+        return indices;
+}
+
+// Appends the simplified levels of a mesh to its index array and fills in
+// mesh.lods, level 0 being the original triangles. Each level is simplified from
+// the previous one and reordered for the vertex cache.
+inline void generateLods(MeshData &mesh)
+{
+        mesh.lods.clear();
+        MeshLod full = {0, (uint32_t)mesh.indices.size(), 0.0f, 0, 0};
+        mesh.lods.push_back(full);
+        if (mesh.indices.empty())
+                return;
+
+        glm::vec3 lo = mesh.vertices[0].Position, hi = lo;
+        for (const Vertex &vertex : mesh.vertices) {
+                lo = glm::min(lo, vertex.Position);
+                hi = glm::max(hi, vertex.Position);
+        }
+        float maxError = glm::length(hi - lo) * 0.5f * LOD_MAX_ERROR;
+
+        vector<size_t> clusters;
+        while (mesh.lods.size() < MAX_LOD_LEVELS) {
+                const MeshLod previous = mesh.lods.back();
+                size_t target = (size_t)(previous.count * LOD_REDUCTION) / 3 * 3;
+                float error;
+                vector<unsigned int> level = simplifyMesh(
+                    mesh.vertices, mesh.indices.data() + previous.first, previous.count,
+                    target, maxError - previous.error, error);
+                if (level.empty() || level.size() > previous.count * LOD_MIN_REDUCTION)
+                        break;
+                level = tipsify(level, mesh.vertices.size(), VERTEX_CACHE_SIZE, clusters);
+                MeshLod lod = {(uint32_t)mesh.indices.size(), (uint32_t)level.size(),
+                               previous.error + error, 0, 0};
+                mesh.indices.insert(mesh.indices.end(), level.begin(), level.end());
+                mesh.lods.push_back(lod);
+        }
+}
+
+inline void reportLods(std::ostream &out, const std::string &name, const MeshData &mesh)
+{
+        out << "MESH::LOD " << name << ": " << mesh.lods.size() << " levels, triangles";
+        for (const MeshLod &lod : mesh.lods)
+                out << " " << lod.count / 3;
+        out << ", error " << mesh.lods.back().error << ", " << mesh.meshlets.size()
+            << " meshlets" << std::endl;
+}
+
+// level chosen for one drawn instance of a model, kept from frame to frame
+struct LodState {
+        size_t level = 0;
+};
+
+// Picks the level to draw from the model space error of every level, given the
+// scale of the instance and its distance to the eye. Starts from the previous
+// choice: refines while the level is too coarse, coarsens only while the next
+// level is comfortably (LOD_HYSTERESIS) below the threshold.
+inline size_t selectLod(const vector<float> &errors, float scale, float distance,
+                        const RenderView &view, LodState &state)
+{
+        if (errors.empty())
+                return state.level = 0;
+        auto pixels = [&](size_t level) {
+                return errors[level] * scale * view.pixelsPerUnit / distance;
+        };
+        size_t level = std::min(state.level, errors.size() - 1);
+        while (level > 0 && pixels(level) > LOD_PIXEL_ERROR)
+                level--;
+        while (level + 1 < errors.size() &&
+               pixels(level + 1) <= LOD_PIXEL_ERROR * LOD_HYSTERESIS)
+                level++;
+        return state.level = level;
+}
+
+#endif
@@ -0,0 +1,415 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Optimization pass run on every imported mesh, before it is cached:
+//   1. weld     - bitwise identical vertices are merged
+//   2. tipsify  - triangles are reordered for the post-transform vertex cache
+//                 (Sander, Nehab, Barczak: "Fast Triangle Reordering for Vertex
+//                 Locality and Reduced Overdraw", 2007)
+//   3. overdraw - the clusters tipsify had to start from scratch are sorted so
+//                 that outward facing ones are drawn first
+//   4. fetch    - vertices are renumbered in the order they are first used
+// Indices are narrowed to 16 bits at upload time (see Mesh::indexTypeFor).
+// Once the levels of detail exist (mesh_lod.h), buildMeshlets cuts every level into
+// meshlets for cluster culling (meshlet.h), leaving the triangle order as it is.
+
+const unsigned int VERTEX_CACHE_SIZE = 16;
+
+// ACMR: transformed vertices per triangle (0.5 is ideal on large regular grids,
+// 3 is no reuse). ATVR: transformed vertices per vertex (1 is ideal).
+struct VertexCacheStats {
+        float acmr;
+        float atvr;
+};
+
+struct MeshOptimizationStats {
+        size_t verticesBefore;
+        size_t verticesAfter;
+        size_t triangles;
+        size_t clusters;
+        VertexCacheStats before;
+        VertexCacheStats after;
+};
+
+// simulates a FIFO post-transform cache of the given size
+inline VertexCacheStats analyzeVertexCache(const vector<unsigned int> &indices,
+                                           size_t vertexCount,
+                                           unsigned int cacheSize = VERTEX_CACHE_SIZE)
+{
+        VertexCacheStats stats = {0.0f, 0.0f};
+        if (indices.empty() || vertexCount == 0)
+                return stats;
+        // a vertex is in the cache if fewer than cacheSize misses happened since
+        // it was loaded
+        vector<size_t> loadedAt(vertexCount, 0);
+        size_t misses = 0;
+        for (unsigned int index : indices) {
+                if (loadedAt[index] == 0 || misses - loadedAt[index] + 1 > cacheSize) {
+                        misses++;
+                        loadedAt[index] = misses;
+                }
+        }
+        stats.acmr = (float)misses / (indices.size() / 3);
+        stats.atvr = (float)misses / vertexCount;
+        return stats;
+}
+
+// merges vertices whose bytes are identical and remaps the indices
+inline void weldVertices(vector<Vertex> &vertices, vector<unsigned int> &indices)
+{
+        if (vertices.empty())
+                return;
+        // open addressing table of unique vertex indices, at most half full
+        size_t tableSize = 1;
+        while (tableSize < vertices.size() * 2)
+                tableSize *= 2;
+        const unsigned int EMPTY = ~0u;
+        vector<unsigned int> table(tableSize, EMPTY);
+        vector<unsigned int> remap(vertices.size());
+        vector<Vertex> unique;
+        unique.reserve(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++) {
+                const unsigned char *bytes =
+                    reinterpret_cast<const unsigned char *>(&vertices[i]);
+                size_t slot = hashBytes(bytes, sizeof(Vertex)) & (tableSize - 1);
+                while (table[slot] != EMPTY &&
+                       memcmp(&unique[table[slot]], bytes, sizeof(Vertex)) != 0)
+                        slot = (slot + 1) & (tableSize - 1);
+                if (table[slot] == EMPTY) {
+                        table[slot] = unique.size();
+                        unique.push_back(vertices[i]);
+                }
+                remap[i] = table[slot];
+        }
+        for (unsigned int &index : indices)
+                index = remap[index];
+        vertices.swap(unique);
+}
+
+// Tipsify. Returns the reordered indices; clusters receives the first triangle of
+// every run that starts on a vertex no longer in the cache.
+inline vector<unsigned int> tipsify(const vector<unsigned int> &indices,
+                                    size_t vertexCount, unsigned int cacheSize,
+                                    vector<size_t> &clusters)
+{
+        size_t triangleCount = indices.size() / 3;
+        vector<unsigned int> result;
+        result.reserve(indices.size());
+        clusters.clear();
+        if (triangleCount == 0)
+                return result;
+
+        // triangles around every vertex
+        vector<unsigned int> offsets(vertexCount + 1, 0);
+        for (unsigned int index : indices)
+                offsets[index + 1]++;
+        for (size_t v = 0; v < vertexCount; v++)
+                offsets[v + 1] += offsets[v];
+        vector<unsigned int> adjacency(indices.size());
+        vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+                adjacency[fill[indices[i]]++] = i / 3;
+
+        vector<unsigned int> live(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++)
+                live[v] = offsets[v + 1] - offsets[v];
+        vector<size_t> cacheTime(vertexCount, 0);
+        vector<bool> emitted(triangleCount, false);
+        vector<unsigned int> deadEnd;
+        vector<unsigned int> candidates;
+        size_t time = cacheSize + 1;
+        size_t cursor = 0;
+
+        auto inCache = [&](unsigned int v) { return time - cacheTime[v] <= cacheSize; };
+        // first vertex with live triangles left, from the dead-end stack (recently
+        // used) or else from a sequential scan
+        auto skipDeadEnd = [&]() -> long {
+                while (!deadEnd.empty()) {
+                        unsigned int v = deadEnd.back();
+                        deadEnd.pop_back();
+                        if (live[v] > 0)
+                                return v;
+                }
+                while (cursor < vertexCount) {
+                        if (live[cursor] > 0)
+                                return cursor++;
+                        cursor++;
+                }
+                return -1;
+        };
+
+        long fan = skipDeadEnd();
+        clusters.push_back(0);
+        while (fan >= 0) {
+                candidates.clear();
+                for (unsigned int a = offsets[fan]; a < offsets[fan + 1]; a++) {
+                        unsigned int t = adjacency[a];
+                        if (emitted[t])
+                                continue;
+                        emitted[t] = true;
+                        for (int k = 0; k < 3; k++) {
+                                unsigned int v = indices[t * 3 + k];
+                                result.push_back(v);
+                                deadEnd.push_back(v);
+                                candidates.push_back(v);
+                                live[v]--;
+                                if (!inCache(v))
+                                        cacheTime[v] = time++;
+                        }
+                }
+
+                // next fanning vertex: the candidate that stays in the cache while
+                // its remaining triangles are emitted and that entered it earliest
+                long next = -1;
+                long bestPriority = -1;
+                for (unsigned int v : candidates) {
+                        if (live[v] == 0)
+                                continue;
+                        long priority = 0;
+                        if (time - cacheTime[v] + 2 * live[v] <= cacheSize)
+                                priority = time - cacheTime[v];
+                        if (priority > bestPriority) {
+                                bestPriority = priority;
+                                next = v;
+                        }
+                }
+                if (next < 0) {
+                        next = skipDeadEnd();
+                        if (next >= 0 && !inCache(next) && result.size() < indices.size())
+                                clusters.push_back(result.size() / 3);
+                }
+                fan = next;
+        }
+        return result;
+}
+
+// sorts the clusters so that the ones facing away from the mesh center come first:
+// they tend to occlude the others, which then fail the depth test early
+inline void optimizeOverdraw(vector<unsigned int> &indices,
+                             const vector<Vertex> &vertices,
+                             const vector<size_t> &clusters)
+{
+        size_t triangleCount = indices.size() / 3;
+        if (clusters.size() < 2)
+                return;
+
+        glm::vec3 center(0.0f);
+        for (const Vertex &vertex : vertices)
+                center += vertex.Position;
+        center /= (float)vertices.size();
+
+        struct Cluster {
+                size_t begin;
+                size_t end;
+                float key;
+        };
+        vector<Cluster> sorted;
+        for (size_t c = 0; c < clusters.size(); c++) {
+                Cluster cluster;
+                cluster.begin = clusters[c];
+                cluster.end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+                // area weighted centroid and normal
+                glm::vec3 centroid(0.0f), normal(0.0f);
+                float area = 0.0f;
+                for (size_t t = cluster.begin; t < cluster.end; t++) {
+                        const glm::vec3 &a = vertices[indices[t * 3]].Position;
+                        const glm::vec3 &b = vertices[indices[t * 3 + 1]].Position;
+                        const glm::vec3 &c3 = vertices[indices[t * 3 + 2]].Position;
+                        glm::vec3 n = glm::cross(b - a, c3 - a);
+                        float weight = glm::length(n);
+                        centroid += (a + b + c3) * (weight / 3.0f);
+                        normal += n;
+                        area += weight;
+                }
+                if (area > 0.0f)
+                        centroid /= area;
+                float length = glm::length(normal);
+                cluster.key = length > 0.0f
+                                  ? glm::dot(centroid - center, normal / length)
+                                  : 0.0f;
+                sorted.push_back(cluster);
+        }
+        std::stable_sort(
+            sorted.begin(), sorted.end(),
+            [](const Cluster &a, const Cluster &b) { return a.key > b.key; });
+
+        vector<unsigned int> result;
+        result.reserve(indices.size());
+        for (const Cluster &cluster : sorted)
+                result.insert(result.end(), indices.begin() + cluster.begin * 3,
+                              indices.begin() + cluster.end * 3);
+        indices.swap(result);
+}
+
+// renumbers the vertices in the order the indices first reference them, so the
+// vertex fetch walks the buffer mostly forward. Unreferenced vertices are dropped.
+inline void optimizeVertexFetch(vector<Vertex> &vertices, vector<unsigned int> &indices)
+{
+        const unsigned int UNUSED = ~0u;
+        vector<unsigned int> remap(vertices.size(), UNUSED);
+        vector<Vertex> ordered;
+        ordered.reserve(vertices.size());
+        for (unsigned int &index : indices) {
+                if (remap[index] == UNUSED) {
+                        remap[index] = ordered.size();
+                        ordered.push_back(vertices[index]);
+                }
+                index = remap[index];
+        }
+        vertices.swap(ordered);
+}
+
+// runs the whole pass on a triangle list
+inline MeshOptimizationStats optimizeMesh(vector<Vertex> &vertices,
+                                          vector<unsigned int> &indices)
+{
+        MeshOptimizationStats stats;
+        stats.verticesBefore = vertices.size();
+        stats.triangles = indices.size() / 3;
+        stats.before = analyzeVertexCache(indices, vertices.size());
+
+        weldVertices(vertices, indices);
+        vector<size_t> clusters;
+        indices = tipsify(indices, vertices.size(), VERTEX_CACHE_SIZE, clusters);
+        optimizeOverdraw(indices, vertices, clusters);
+        optimizeVertexFetch(vertices, indices);
+
+        stats.verticesAfter = vertices.size();
+        stats.clusters = clusters.size();
+        stats.after = analyzeVertexCache(indices, vertices.size());
+        return stats;
+}
+
+// bounding sphere and normal cone of the triangles in indices[first, first + count)
+inline void computeMeshletBounds(const vector<Vertex> &vertices,
+                                 const vector<unsigned int> &indices, Meshlet &meshlet)
+{
+        const unsigned int *triangles = &indices[meshlet.first];
+        glm::vec3 lo = vertices[triangles[0]].Position, hi = lo;
+        for (size_t i = 0; i < meshlet.count; i++) {
+                lo = glm::min(lo, vertices[triangles[i]].Position);
+                hi = glm::max(hi, vertices[triangles[i]].Position);
+        }
+        meshlet.center = (lo + hi) * 0.5f;
+        meshlet.radius = 0.0f;
+        for (size_t i = 0; i < meshlet.count; i++)
+                meshlet.radius = std::max(
+                    meshlet.radius,
+                    glm::length(vertices[triangles[i]].Position - meshlet.center));
+
+        glm::vec3 normals[MESHLET_MAX_TRIANGLES];
+        size_t normalCount = 0;
+        glm::vec3 axis(0.0f);
+        for (size_t i = 0; i < meshlet.count; i += 3) {
+                const glm::vec3 &a = vertices[triangles[i]].Position;
+                const glm::vec3 &b = vertices[triangles[i + 1]].Position;
+                const glm::vec3 &c = vertices[triangles[i + 2]].Position;
+                glm::vec3 n = glm::cross(b - a, c - a);
+                float length = glm::length(n);
+                if (length <= 0.0f)
+                        continue;
+                normals[normalCount++] = n / length;
+                axis += n / length;
+        }
+        float axisLength = glm::length(axis);
+        meshlet.coneAxis = axisLength > 0.0f ? axis / axisLength : glm::vec3(0.0f);
+        meshlet.coneCutoff = 1.0f;
+        if (axisLength <= 0.0f)
+                return;
+        float minDot = 1.0f;
+        for (size_t i = 0; i < normalCount; i++)
+                minDot = std::min(minDot, glm::dot(normals[i], meshlet.coneAxis));
+        // cones wider than a hemisphere (or close to it) can't cull anything
+        if (minDot > 0.1f)
+                meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+// Splits the triangles of every level of detail into meshlets. The level is
+// scanned in its vertex cache order, which stays the order of the index buffer, and
+// a meshlet ends where the next triangle would break its vertex or triangle limit,
+// shares no vertex with it (tipsify started a new cluster there) or faces more than
+// 60 degrees away from the meshlet's mean normal, which keeps normal cones narrow.
+inline void buildMeshlets(const vector<Vertex> &vertices, vector<unsigned int> &indices,
+                          vector<MeshLod> &lods, vector<Meshlet> &meshlets)
+{
+        meshlets.clear();
+        const unsigned int NONE = ~0u;
+        // meshlet that last took a vertex
+        vector<unsigned int> vertexStamp(vertices.size(), NONE);
+
+        for (MeshLod &lod : lods) {
+                lod.firstMeshlet = meshlets.size();
+                Meshlet meshlet;
+                meshlet.first = lod.first;
+                meshlet.count = 0;
+                size_t meshletVertices = 0;
+                glm::vec3 normalSum(0.0f);
+                for (size_t i = lod.first; i < lod.first + lod.count; i += 3) {
+                        unsigned int id = meshlets.size();
+                        const unsigned int *triangle = &indices[i];
+                        size_t added = 0;
+                        for (int k = 0; k < 3; k++)
+                                if (vertexStamp[triangle[k]] != id)
+                                        added++;
+                        const glm::vec3 &a = vertices[triangle[0]].Position;
+                        const glm::vec3 &b = vertices[triangle[1]].Position;
+                        const glm::vec3 &c = vertices[triangle[2]].Position;
+                        glm::vec3 normal = glm::cross(b - a, c - a);
+                        float length = glm::length(normal);
+                        float spread = glm::length(normalSum);
+                        bool full = meshlet.count / 3 == MESHLET_MAX_TRIANGLES ||
+                                    meshletVertices + added > MESHLET_MAX_VERTICES;
+                        bool apart =
+                            added == 3 || (length > 0.0f && spread > 0.0f &&
+                                           glm::dot(normal / length, normalSum / spread) <
+                                               0.5f);
+                        if (meshlet.count > 0 && (full || apart)) {
+                                meshlets.push_back(meshlet);
+                                id = meshlets.size();
+                                meshlet.first = i;
+                                meshlet.count = 0;
+                                meshletVertices = 0;
+                                normalSum = glm::vec3(0.0f);
+                        }
+                        for (int k = 0; k < 3; k++) {
+                                if (vertexStamp[triangle[k]] != id) {
+                                        vertexStamp[triangle[k]] = id;
+                                        meshletVertices++;
+                                }
+                        }
+                        if (length > 0.0f)
+                                normalSum += normal / length;
+                        meshlet.count += 3;
+                }
+                if (meshlet.count > 0)
+                        meshlets.push_back(meshlet);
+                for (size_t m = lod.firstMeshlet; m < meshlets.size(); m++)
+                        computeMeshletBounds(vertices, indices, meshlets[m]);
+                lod.meshletCount = meshlets.size() - lod.firstMeshlet;
+        }
+}
+
+inline void reportOptimization(std::ostream &out, const std::string &name,
+                               const MeshOptimizationStats &stats)
+{
+        out << "MESH::OPTIMIZE " << name << ": " << stats.triangles << " triangles, "
+            << stats.verticesBefore << " -> " << stats.verticesAfter << " vertices, "
+            << std::fixed << std::setprecision(3) << "ACMR " << stats.before.acmr
+            << " -> " << stats.after.acmr << ", ATVR " << stats.before.atvr << " -> "
+            << stats.after.atvr << ", " << stats.clusters << " clusters, "
+            << (stats.verticesAfter < 65536 ? 16 : 32) << "-bit indices" << std::endl;
+}
+
+#endif
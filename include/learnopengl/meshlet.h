@@ -0,0 +1,101 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Meshlets are small clusters of triangles, at most MESHLET_MAX_VERTICES distinct
+// vertices and MESHLET_MAX_TRIANGLES triangles, stored contiguously in the index
+// buffer of a mesh (see buildMeshlets in mesh_optimizer.h). Each one carries a
+// bounding sphere and a cone around the normals of its triangles, so whole
+// clusters that are outside the view frustum or facing away from the camera can
+// be dropped on the CPU before the draw call is made.
+
+const size_t MESHLET_MAX_VERTICES = 64;
+const size_t MESHLET_MAX_TRIANGLES = 124;
+
+struct Meshlet {
+        // range in the index buffer
+        uint32_t first;
+        uint32_t count;
+        // bounding sphere, model space
+        glm::vec3 center;
+        float radius;
+        // normal cone: the meshlet faces away from every eye for which
+        // dot(center - eye, coneAxis) >= coneCutoff * |center - eye| + radius.
+        // coneCutoff is 1 when the normals are too spread out to ever cull.
+        glm::vec3 coneAxis;
+        float coneCutoff;
+};
+
+// what the culling pass did, summed over every mesh drawn with it
+struct ClusterStats {
+        size_t clusters = 0;
+        size_t visibleClusters = 0;
+        size_t triangles = 0;
+        size_t visibleTriangles = 0;
+        size_t drawCalls = 0;
+        // CPU time spent culling, in milliseconds
+        double cullTime = 0.0;
+};
+
+// Tests meshlets of one drawn instance. Works in model space: the frustum planes
+// come from the instance's model-view-projection matrix and the eye is moved into
+// model space, which keeps both tests exact under any affine model matrix.
+class MeshletCuller
+{
+      public:
+        // with enabled false nothing is culled, only the stats are collected
+        MeshletCuller(const glm::mat4 &modelViewProjection, const glm::mat4 &model,
+                      const glm::vec3 &eye, bool enabled = true,
+                      ClusterStats *stats = nullptr)
+            : enabled(enabled), stats(stats)
+        {
+                const glm::mat4 &m = modelViewProjection;
+                for (int i = 0; i < 3; i++) {
+                        glm::vec4 row(m[0][i], m[1][i], m[2][i], m[3][i]);
+                        glm::vec4 w(m[0][3], m[1][3], m[2][3], m[3][3]);
+                        planes[i * 2] = normalizePlane(w + row);
+                        planes[i * 2 + 1] = normalizePlane(w - row);
+                }
+                localEye = glm::vec3(glm::inverse(model) * glm::vec4(eye, 1.0f));
+                // a mirroring matrix turns the winding around, so what faces away
+                // in model space is front facing on screen
+                glm::vec3 x(model[0]), y(model[1]), z(model[2]);
+                testCones = glm::dot(glm::cross(x, y), z) > 0.0f;
+        }
+
+        bool visible(const Meshlet &meshlet) const
+        {
+                for (const glm::vec4 &plane : planes)
+                        if (glm::dot(glm::vec3(plane), meshlet.center) + plane.w <
+                            -meshlet.radius)
+                                return false;
+                if (testCones) {
+                        glm::vec3 view = meshlet.center - localEye;
+                        if (glm::dot(view, meshlet.coneAxis) >=
+                            meshlet.coneCutoff * glm::length(view) + meshlet.radius)
+                                return false;
+                }
+                return true;
+        }
+
+        bool enabled;
+        ClusterStats *stats;
+
+      private:
+        glm::vec4 planes[6];
+        glm::vec3 localEye;
+        bool testCones;
+
+        static glm::vec4 normalizePlane(const glm::vec4 &plane)
+        {
+                float length = glm::length(glm::vec3(plane));
+                return length > 0.0f ? plane / length : plane;
+        }
+};
+
+#endif
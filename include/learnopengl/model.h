@@ -6,23 +6,99 @@
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
+#include <assimp/version.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <stb_image.h>
 
+#include <learnopengl/image_decoder.h>
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mesh_lod.h>
+#include <learnopengl/mesh_optimizer.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/texture.h>
+#include <learnopengl/texture_cache.h>
 
+#include <cfloat>
 #include <fstream>
+#include <future>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory,
                              bool gamma = false);
+unsigned int TextureFromImage(const DecodedImage &image, bool gamma, const void *pixels);
+
+// material texture of an imported model, with its file and the key it has in the
+// texture cache
+struct ModelTexture {
+        TextureRef ref;
+        string file;
+        TextureKey key;
+};
+
+// CPU side result of importing a model: converted geometry and the list of its
+// material textures, which are only loaded once drawing asks for them (see
+// Model::requestTextures). It is produced by Model::import, which doesn't touch
+// OpenGL and can run on any thread, and consumed by the Model constructor on the
+// GL thread.
+struct ModelData {
+        string path;
+        string directory;
+        // geometry comes either from the mapped mesh cache or from ASSIMP, meshes
+        // views it in both cases
+        MeshCache cache;
+        vector<MeshData> imported;
+        vector<MeshCache::Entry> meshes;
+        // whether the meshes keep a CPU-side copy of their geometry after upload
+        bool keepGeometry = false;
+        // with the packed layout, the packed vertices of every mesh
+        VertexLayout layout = VertexLayout::Full;
+        // the vertex attributes that are uploaded
+        AttributeMask attributes = ALL_ATTRIBUTES;
+        vector<vector<PackedVertex>> packed;
+        vector<VertexQuantization> quantization;
+        // axis aligned bounding box of all meshes
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        // every material texture used by the model, once per path
+        vector<ModelTexture> textures;
+};
+
+// GL objects of an imported model. Buffers and textures are shared between the
+// contexts of a share group, so they can be created on an upload thread; the
+// vertex array objects are left for the context that draws the model.
+struct ModelBuffers {
+        struct MeshBuffers {
+                VertexStreams streams;
+                unsigned int EBO;
+                size_t indexCount;
+                GLenum indexType;
+                VertexLayout layout;
+                VertexQuantization quantization;
+                vector<TextureRef> textures;
+                vector<MeshLod> lods;
+                vector<Meshlet> meshlets;
+                // CPU-side geometry, only filled with ModelData::keepGeometry
+                vector<Vertex> vertices;
+                vector<unsigned int> indices;
+        };
+        vector<MeshBuffers> meshes;
+        // the material textures; the id is 0 for those that aren't resident yet
+        vector<Texture> textures;
+        vector<ModelTexture> materials;
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+};
 
 class Model
 {
@@ -34,77 +110,665 @@ class Model
         vector<Mesh> meshes;
         string directory;
         bool gammaCorrection;
+        // model space bounds, and the largest error of every level of detail
+        // over all meshes (see mesh_lod.h)
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        vector<float> lodErrors;
+
+        // constructor, creates an empty model to be filled in later by adopt()
+        // (e.g. by the asset streamer)
+        Model()
+            : gammaCorrection(false), boundsMin(FLT_MAX), boundsMax(-FLT_MAX),
+              placeholder(false)
+        {
+        }
+
+        // constructor, expects a filepath to a 3D model. With keepGeometry the
+        // meshes keep their vertices and indices in memory after the upload. Only
+        // the given vertex attributes are uploaded.
+        Model(string const &path, bool gamma = false,
+              VertexLayout layout = VertexLayout::Full, bool keepGeometry = false,
+              AttributeMask attributes = ALL_ATTRIBUTES)
+            : Model(import(path, layout, keepGeometry, attributes), gamma)
+        {
+        }
+
+        // constructor, creates the GL objects of an already imported model.
+        Model(unique_ptr<ModelData> data, bool gamma = false)
+            : gammaCorrection(gamma), boundsMin(FLT_MAX), boundsMax(-FLT_MAX),
+              placeholder(false)
+        {
+                ModelBuffers buffers;
+                uploadBuffers(*data, buffers);
+                adopt(buffers);
+        }
+
+        // loads a model with supported ASSIMP extensions from file, converts its
+        // meshes on the job pool and lists its textures. Doesn't use OpenGL, so
+        // several models can be imported at the same time from worker threads. The
+        // processed geometry is cached next to the source file, later runs map the
+        // cache and skip ASSIMP. With the packed layout the vertices are quantized
+        // here as well.
+        static unique_ptr<ModelData> import(string const &path,
+                                            VertexLayout layout = VertexLayout::Full,
+                                            bool keepGeometry = false,
+                                            AttributeMask attributes = ALL_ATTRIBUTES)
+        {
+                unique_ptr<ModelData> data(new ModelData);
+                data->path = path;
+                data->layout = layout;
+                data->keepGeometry = keepGeometry;
+                data->attributes = attributes;
+                // retrieve the directory path of the filepath
+                data->directory = path.substr(0, path.find_last_of('/'));
+
+                if (data->cache.open(path, loaderId(), importFlags)) {
+                        for (size_t i = 0; i < data->cache.meshCount(); i++)
+                                data->meshes.push_back(data->cache.mesh(i));
+                        finishImport(*data);
+                        return data;
+                }
+
+                if (!importMeshes(path, data->imported))
+                        return data;
+
+                if (!MeshCache::write(path, loaderId(), importFlags, data->imported))
+                        cout << "WARNING::MESH_CACHE:: could not write "
+                             << MeshCache::cachePath(path) << endl;
+
+                for (const MeshData &mesh : data->imported) {
+                        MeshCache::Entry entry;
+                        entry.vertices = mesh.vertices.data();
+                        entry.vertexCount = mesh.vertices.size();
+                        entry.indices = mesh.indices.data();
+                        entry.indexCount = mesh.indices.size();
+                        entry.lods = mesh.lods;
+                        entry.meshlets = mesh.meshlets;
+                        entry.textures = mesh.textures;
+                        data->meshes.push_back(entry);
+                }
+                finishImport(*data);
+                return data;
+        }
+
+        // Assimp post-processing steps; part of the mesh cache key, so changing them
+        // invalidates every cache
+        static const unsigned int importFlags =
+            aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs |
+            aiProcess_CalcTangentSpace | aiProcess_JoinIdenticalVertices;
+
+        // the importer behind importMeshes, ASSIMP of this major and minor version,
+        // as releases differ in what the post-processing steps make of a model;
+        // part of the mesh cache key like the import flags
+        static uint32_t loaderId()
+        {
+                return MESH_LOADER_ASSIMP | aiGetVersionMajor() << 16 |
+                       aiGetVersionMinor() << 8;
+        }
 
-        // constructor, expects a filepath to a 3D model.
-        Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+        // reads the meshes of a model file with ASSIMP and runs the whole mesh
+        // processing on them: what ends up in the mesh cache. Also used by the asset
+        // cooker.
+        static bool importMeshes(const string &path, vector<MeshData> &meshes)
         {
-                loadModel(path);
+                vector<string> names;
+                if (!readScene(path, meshes, names))
+                        return false;
+
+                // optimize, simplify and cluster the meshes in parallel. The meshes
+                // of a scene are independent, only their order matters.
+                vector<MeshOptimizationStats> stats(meshes.size());
+                JobPool::instance().parallelFor(meshes.size(), [&](size_t i) {
+                        stats[i] = optimizeMesh(meshes[i].vertices, meshes[i].indices);
+                        generateLods(meshes[i]);
+                        buildMeshlets(meshes[i].vertices, meshes[i].indices,
+                                      meshes[i].lods, meshes[i].meshlets);
+                });
+                for (size_t i = 0; i < meshes.size(); i++) {
+                        string name = names[i];
+                        if (name.empty())
+                                name = to_string(i);
+                        reportOptimization(cout, path + ":" + name, stats[i]);
+                        reportLods(cout, path + ":" + name, meshes[i]);
+                }
+                return true;
+        }
+
+        // reads a model with ASSIMP and converts its meshes (on the job pool), as
+        // they come before optimization. names receives the name of every mesh.
+        static bool readScene(const string &path, vector<MeshData> &meshes,
+                              vector<string> &names)
+        {
+                Assimp::Importer importer;
+                const aiScene *scene = importer.ReadFile(path, importFlags);
+                // check for errors
+                if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
+                    !scene->mRootNode) // if is Not Zero
+                {
+                        cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+                        return false;
+                }
+
+                // walk ASSIMP's node tree, then convert the meshes in parallel
+                vector<aiMesh *> sceneMeshes;
+                processNode(scene->mRootNode, scene, sceneMeshes);
+                meshes.assign(sceneMeshes.size(), MeshData());
+                JobPool::instance().parallelFor(sceneMeshes.size(), [&](size_t i) {
+                        meshes[i] = processMesh(sceneMeshes[i], scene);
+                });
+                names.clear();
+                for (aiMesh *mesh : sceneMeshes)
+                        names.push_back(mesh->mName.C_Str());
+                return true;
+        }
+
+        // material textures are block compressed according to what they hold
+        static TextureFormat textureFormat(const string &type)
+        {
+                TextureFormat format;
+                format.compress = true;
+                if (type == "texture_normal")
+                        format.map = TextureMap::Normal;
+                else if (type == "texture_specular")
+                        format.map = TextureMap::Specular;
+                return format;
+        }
+
+        // creates the buffers of an imported model on the current context, one per
+        // vertex attribute asked for, and takes the material textures that are
+        // already resident (possibly loaded by another model) from the texture
+        // cache; the rest is loaded on demand. Frees, mesh by mesh as it goes, the
+        // geometry (moved to buffers instead when it is kept), so only the ModelData
+        // shell is left afterwards.
+        static void uploadBuffers(ModelData &data, ModelBuffers &buffers)
+        {
+                TextureCache &cache = TextureCache::instance();
+                for (const ModelTexture &modelTexture : data.textures) {
+                        Texture texture;
+                        texture.type = modelTexture.ref.type;
+                        texture.path = modelTexture.ref.path;
+                        texture.id = cache.acquire(modelTexture.key);
+                        buffers.textures.push_back(texture);
+                        buffers.materials.push_back(modelTexture);
+                }
+
+                for (size_t i = 0; i < data.meshes.size(); i++) {
+                        const MeshCache::Entry &mesh = data.meshes[i];
+                        ModelBuffers::MeshBuffers meshBuffers;
+                        meshBuffers.layout = data.layout;
+                        meshBuffers.indexType = Mesh::indexTypeFor(mesh.vertexCount);
+                        if (data.layout == VertexLayout::Packed) {
+                                meshBuffers.quantization = data.quantization[i];
+                                Mesh::createBuffers(
+                                    data.packed[i].data(), data.packed[i].size(),
+                                    data.layout, data.attributes, mesh.indices,
+                                    mesh.indexCount, meshBuffers.indexType,
+                                    meshBuffers.streams, meshBuffers.EBO);
+                        } else {
+                                Mesh::createBuffers(
+                                    mesh.vertices, mesh.vertexCount, data.layout,
+                                    data.attributes, mesh.indices, mesh.indexCount,
+                                    meshBuffers.indexType, meshBuffers.streams,
+                                    meshBuffers.EBO);
+                        }
+                        meshBuffers.indexCount = mesh.indexCount;
+                        meshBuffers.textures = mesh.textures;
+                        meshBuffers.lods = mesh.lods;
+                        meshBuffers.meshlets = mesh.meshlets;
+                        if (data.keepGeometry)
+                                keepMeshGeometry(data, i, meshBuffers);
+                        buffers.meshes.push_back(std::move(meshBuffers));
+                        if (data.layout == VertexLayout::Packed)
+                                vector<PackedVertex>().swap(data.packed[i]);
+                        if (i < data.imported.size())
+                                data.imported[i] = MeshData();
+                }
+                buffers.boundsMin = data.boundsMin;
+                buffers.boundsMax = data.boundsMax;
+                data.packed.clear();
+                data.imported.clear();
+                data.meshes.clear();
+                data.cache.close();
+        }
+
+        // takes over the buffers and textures created by uploadBuffers() and creates
+        // the meshes on the current context, replacing the placeholder (if any).
+        void adopt(ModelBuffers &buffers)
+        {
+                clearPlaceholder();
+                for (size_t i = 0; i < buffers.textures.size(); i++) {
+                        const Texture &texture = buffers.textures[i];
+                        texturesByPath[texture.path] = textures_loaded.size();
+                        textures_loaded.push_back(
+                            texture); // store it as texture loaded for entire
+                                      // model, to ensure we won't unnecesery load
+                                      // duplicate textures.
+                        materials.push_back(buffers.materials[i]);
+                        textureStates.push_back(texture.id != 0 ? TextureState::Loaded
+                                                                : TextureState::Unloaded);
+                }
+                boundsMin = buffers.boundsMin;
+                boundsMax = buffers.boundsMax;
+                meshes.reserve(meshes.size() + buffers.meshes.size());
+                for (ModelBuffers::MeshBuffers &mesh : buffers.meshes) {
+                        meshes.emplace_back(mesh.streams, mesh.EBO, mesh.indexCount,
+                                            mesh.indexType, findTextures(mesh.textures),
+                                            mesh.layout, mesh.quantization);
+                        meshes.back().vertices = std::move(mesh.vertices);
+                        meshes.back().indices = std::move(mesh.indices);
+                        meshes.back().lods = std::move(mesh.lods);
+                        meshes.back().meshlets = std::move(mesh.meshlets);
+                        meshes.back().glslIdentifierPrefix = textureNamePrefix;
+                }
+                buffers.meshes.clear();
+                // textures that aren't loaded show the placeholder meanwhile
+                for (size_t i = 0; i < textures_loaded.size(); i++)
+                        if (textureStates[i] != TextureState::Loaded)
+                                setMeshTextures(textures_loaded[i].path,
+                                                placeholderTexture);
+                // the samplers of the programs are read again for the new meshes
+                samplersRead.clear();
+                updateLodErrors();
+        }
+
+        // while the real model is still loading it is drawn as its bounding box,
+        // textured with the given (placeholder) texture. The box uses the same vertex
+        // layout as the model, so the model's shader can draw it.
+        void showPlaceholder(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+                             unsigned int texture,
+                             VertexLayout layout = VertexLayout::Full)
+        {
+                if (!meshes.empty() || boundsMin.x > boundsMax.x)
+                        return;
+                Texture boxTexture;
+                boxTexture.id = texture;
+                boxTexture.type = "texture_diffuse";
+                meshes.push_back(boxMesh(boundsMin, boundsMax, boxTexture, layout));
+                placeholderTexture = texture;
+                meshes.back().glslIdentifierPrefix = textureNamePrefix;
+                placeholder = true;
+        }
+
+        bool isPlaceholder() const { return placeholder; }
+
+        // deletes the meshes and drops the model's references to its textures. Must
+        // be called while the GL context is still alive.
+        void release()
+        {
+                if (decoding.valid())
+                        decoding.get();
+                decodeBatch.reset();
+                decodeImages.clear();
+                for (Mesh &mesh : meshes)
+                        mesh.destroy();
+                meshes.clear();
+                lodErrors.clear();
+                placeholder = false;
+                for (const Texture &texture : textures_loaded)
+                        TextureCache::instance().release(texture.id);
+                textures_loaded.clear();
+                texturesByPath.clear();
+                materials.clear();
+                textureStates.clear();
+                samplersRead.clear();
         }
 
         // draws the model, and thus all its meshes
         void Draw(Shader &shader)
         {
+                requestTextures(shader);
                 for (unsigned int i = 0; i < meshes.size(); i++)
                         meshes[i].Draw(shader);
         }
 
+        // draws the model at the level of detail that suits its size on screen,
+        // skipping the meshlets the camera can't see (see RenderView). model is the
+        // model matrix of this instance; state remembers the level of the instance
+        // between frames, so every instance needs its own.
+        void Draw(Shader &shader, const glm::mat4 &model, const RenderView &view,
+                  LodState &state)
+        {
+                size_t level = 0;
+                if (!lodErrors.empty() && boundsMin.x <= boundsMax.x) {
+                        float scale = std::max(
+                            glm::length(glm::vec3(model[0])),
+                            std::max(glm::length(glm::vec3(model[1])),
+                                     glm::length(glm::vec3(model[2]))));
+                        glm::vec4 middle((boundsMin + boundsMax) * 0.5f, 1.0f);
+                        glm::vec3 center = glm::vec3(model * middle);
+                        float radius = glm::length(boundsMax - boundsMin) * 0.5f * scale;
+                        // distance to the nearest point of the bounding sphere
+                        float distance =
+                            std::max(glm::length(center - view.eye) - radius, 0.1f);
+                        level = selectLod(lodErrors, scale, distance, view, state);
+                }
+                requestTextures(shader);
+                MeshletCuller culler(view.viewProjection * model, model, view.eye,
+                                     view.cullClusters, view.stats);
+                for (Mesh &mesh : meshes)
+                        mesh.Draw(shader, level, &culler);
+        }
+
+        // same, for a model drawn once per frame
+        void Draw(Shader &shader, const glm::mat4 &model, const RenderView &view)
+        {
+                Draw(shader, model, view, lodState);
+        }
+
         void SetShaderTextureNamePrefix(std::string prefix)
         {
+                textureNamePrefix = prefix;
                 for (Mesh &mesh : meshes) {
-                        mesh.glslIdentifierPrefix = prefix;
+                        mesh.setSamplerPrefix(prefix);
+                }
+        }
+
+        // Material textures are loaded on demand: a texture is decoded (in the
+        // background) and uploaded only once a program that draws one of its meshes
+        // samples its slot, which is read from the active samplers of the program.
+        // Until then the slot shows the placeholder texture. Called by Draw() with
+        // the program in use; each program is looked at once.
+        void requestTextures(const Shader &shader)
+        {
+                if (samplersRead.insert(shader.ID).second) {
+                        vector<ActiveSampler> samplers = shader.activeSamplers();
+                        for (const Mesh &mesh : meshes) {
+                                for (size_t i = 0; i < mesh.textures.size(); i++) {
+                                        auto it =
+                                            texturesByPath.find(mesh.textures[i].path);
+                                        if (it == texturesByPath.end() ||
+                                            textureStates[it->second] !=
+                                                TextureState::Unloaded)
+                                                continue;
+                                        if (mesh.samples(i, samplers))
+                                                textureStates[it->second] =
+                                                    TextureState::Wanted;
+                                }
+                        }
                 }
+                loadTextures();
         }
 
       private:
-        // loads a model with supported ASSIMP extensions from file and stores the
-        // resulting meshes in the meshes vector.
-        void loadModel(string const &path)
+        enum class TextureState { Unloaded, Wanted, Loading, Loaded };
+
+        std::string textureNamePrefix;
+        bool placeholder;
+        LodState lodState;
+        // index of every loaded texture in textures_loaded, by material path
+        unordered_map<string, size_t> texturesByPath;
+        // per texture in textures_loaded: where it comes from and how far it is
+        vector<ModelTexture> materials;
+        vector<TextureState> textureStates;
+        // programs whose samplers have been read
+        unordered_set<unsigned int> samplersRead;
+        unsigned int placeholderTexture = 0;
+        // the textures being decoded in the background: per texture (index in
+        // textures_loaded) the index of its image in the batch
+        shared_ptr<ImageDecodeBatch> decodeBatch;
+        vector<pair<size_t, size_t>> decodeImages;
+        std::future<void> decoding;
+
+        // uploads the decoded textures once the decoding is done, and starts decoding
+        // the wanted ones that aren't resident in the texture cache
+        void loadTextures()
         {
-                // read file via ASSIMP
-                Assimp::Importer importer;
-                const aiScene *scene = importer.ReadFile(
-                    path, aiProcess_Triangulate | aiProcess_GenSmoothNormals |
-                              aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-                // check for errors
-                if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
-                    !scene->mRootNode) // if is Not Zero
-                {
-                        cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+                if (decoding.valid()) {
+                        if (decoding.wait_for(std::chrono::seconds(0)) !=
+                            std::future_status::ready)
+                                return;
+                        decoding.get();
+                        uploadTextures();
+                }
+
+                TextureCache &cache = TextureCache::instance();
+                for (size_t t = 0; t < textureStates.size(); t++) {
+                        if (textureStates[t] != TextureState::Wanted)
+                                continue;
+                        const ModelTexture &material = materials[t];
+                        unsigned int id = cache.acquire(material.key);
+                        if (id != 0) {
+                                setTexture(t, id);
+                                continue;
+                        }
+                        if (!decodeBatch)
+                                decodeBatch = make_shared<ImageDecodeBatch>();
+                        // identical files (another name, same content) decode once
+                        size_t image = decodeBatch->size();
+                        for (const pair<size_t, size_t> &other : decodeImages)
+                                if (TextureCache::cacheable(material.key) &&
+                                    materials[other.first].key == material.key)
+                                        image = other.second;
+                        if (image == decodeBatch->size())
+                                decodeBatch->add(
+                                    material.file, true,
+                                    compressionRequest(textureFormat(material.ref.type)));
+                        decodeImages.push_back(make_pair(t, image));
+                        textureStates[t] = TextureState::Loading;
+                }
+                if (decodeBatch && !decoding.valid()) {
+                        shared_ptr<ImageDecodeBatch> batch = decodeBatch;
+                        decoding = std::async(std::launch::async,
+                                              [batch]() { batch->decode(); });
+                }
+        }
+
+        // creates the textures of a decoded batch, through a pixel unpack buffer
+        void uploadTextures()
+        {
+                vector<const DecodedImage *> images;
+                for (size_t i = 0; i < decodeBatch->size(); i++)
+                        images.push_back(&decodeBatch->image(i));
+                vector<const void *> pixels;
+                unsigned int pbo = stagePixels(images, pixels);
+                TextureCache &cache = TextureCache::instance();
+                for (const pair<size_t, size_t> &decoded : decodeImages) {
+                        const ModelTexture &material = materials[decoded.first];
+                        const DecodedImage &image = *images[decoded.second];
+                        size_t bytes = TextureCache::textureBytes(image, true);
+                        unsigned int id = cache.acquire(material.key);
+                        if (id == 0) {
+                                id = TextureFromImage(image, false,
+                                                      pixels[decoded.second]);
+                                id = cache.insert(material.key, id, bytes);
+                        }
+                        setTexture(decoded.first, id);
+                }
+                releasePixels(pbo);
+                decodeBatch.reset();
+                decodeImages.clear();
+        }
+
+        // makes a texture of textures_loaded resident under the given name
+        void setTexture(size_t t, unsigned int id)
+        {
+                textures_loaded[t].id = id;
+                textureStates[t] = TextureState::Loaded;
+                setMeshTextures(textures_loaded[t].path, id);
+        }
+
+        void setMeshTextures(const string &path, unsigned int id)
+        {
+                for (Mesh &mesh : meshes)
+                        for (size_t i = 0; i < mesh.textures.size(); i++)
+                                if (mesh.textures[i].path == path)
+                                        mesh.setTexture(i, id);
+        }
+
+        // computes the bounds of the imported meshes, packs their vertices if asked
+        // to and lists their textures
+        static void finishImport(ModelData &data)
+        {
+                if (data.layout == VertexLayout::Packed) {
+                        data.packed.resize(data.meshes.size());
+                        data.quantization.resize(data.meshes.size());
+                        size_t count = data.meshes.size();
+                        JobPool::instance().parallelFor(count, [&](size_t i) {
+                                const MeshCache::Entry &mesh = data.meshes[i];
+                                data.quantization[i] = packVertices(
+                                    mesh.vertices, mesh.vertexCount, data.packed[i]);
+                        });
+                }
+
+                data.boundsMin = glm::vec3(FLT_MAX);
+                data.boundsMax = glm::vec3(-FLT_MAX);
+                for (const MeshCache::Entry &mesh : data.meshes) {
+                        for (size_t i = 0; i < mesh.vertexCount; i++) {
+                                const glm::vec3 &p = mesh.vertices[i].Position;
+                                data.boundsMin = glm::min(data.boundsMin, p);
+                                data.boundsMax = glm::max(data.boundsMax, p);
+                        }
+                        listTextures(data, mesh.textures);
+                }
+
+                // packed meshes upload the packed copy, so the full vertices of a
+                // fresh import can go now instead of waiting for the upload
+                if (data.layout == VertexLayout::Packed && !data.keepGeometry) {
+                        for (size_t i = 0; i < data.imported.size(); i++) {
+                                vector<Vertex>().swap(data.imported[i].vertices);
+                                data.meshes[i].vertices = nullptr;
+                        }
+                }
+        }
+
+        // hands the CPU-side geometry of mesh i over to its buffers: moved out of a
+        // fresh import, copied out of the mapped cache
+        static void keepMeshGeometry(ModelData &data, size_t i,
+                                     ModelBuffers::MeshBuffers &meshBuffers)
+        {
+                if (i < data.imported.size()) {
+                        meshBuffers.vertices = std::move(data.imported[i].vertices);
+                        meshBuffers.indices = std::move(data.imported[i].indices);
                         return;
                 }
-                // retrieve the directory path of the filepath
-                directory = path.substr(0, path.find_last_of('/'));
+                const MeshCache::Entry &mesh = data.meshes[i];
+                meshBuffers.vertices.assign(mesh.vertices,
+                                            mesh.vertices + mesh.vertexCount);
+                meshBuffers.indices.assign(mesh.indices, mesh.indices + mesh.indexCount);
+        }
+
+        // the error of a level of the model is the largest of its meshes. A mesh
+        // with fewer levels keeps drawing its coarsest one at the levels it lacks.
+        void updateLodErrors()
+        {
+                size_t levels = 0;
+                for (const Mesh &mesh : meshes)
+                        levels = std::max(levels, mesh.lods.size());
+                lodErrors.assign(levels, 0.0f);
+                for (const Mesh &mesh : meshes) {
+                        for (size_t level = 0; level < levels && !mesh.lods.empty();
+                             level++) {
+                                size_t own = std::min(level, mesh.lods.size() - 1);
+                                lodErrors[level] =
+                                    std::max(lodErrors[level], mesh.lods[own].error);
+                        }
+                }
+        }
+
+        void clearPlaceholder()
+        {
+                if (!placeholder)
+                        return;
+                for (Mesh &mesh : meshes)
+                        mesh.destroy();
+                meshes.clear();
+                placeholder = false;
+        }
 
-                // process ASSIMP's root node recursively
-                processNode(scene->mRootNode, scene);
+        // axis aligned box with outward normals, used as a stand-in for the model
+        static Mesh boxMesh(const glm::vec3 &lo, const glm::vec3 &hi,
+                            const Texture &texture, VertexLayout layout)
+        {
+                static const float faces[6][3] = {{1, 0, 0},  {-1, 0, 0}, {0, 1, 0},
+                                                  {0, -1, 0}, {0, 0, 1},  {0, 0, -1}};
+                vector<Vertex> vertices;
+                vector<unsigned int> indices;
+                for (int f = 0; f < 6; f++) {
+                        glm::vec3 n(faces[f][0], faces[f][1], faces[f][2]);
+                        // two axes spanning the face, ordered so the winding is CCW
+                        // when seen from outside
+                        glm::vec3 u(n.y != 0.0f ? 1.0f : 0.0f, n.y == 0.0f ? 1.0f : 0.0f,
+                                    0.0f);
+                        if (n.x != 0.0f)
+                                u = glm::vec3(0.0f, 0.0f, 1.0f);
+                        glm::vec3 v = glm::cross(n, u);
+                        unsigned int base = vertices.size();
+                        for (int c = 0; c < 4; c++) {
+                                float su = (c == 1 || c == 2) ? 1.0f : -1.0f;
+                                float sv = (c >= 2) ? 1.0f : -1.0f;
+                                glm::vec3 unit = n + u * su + v * sv; // in [-1, 1]^3
+                                Vertex vertex;
+                                vertex.Position = lo + (unit * 0.5f + glm::vec3(0.5f)) * (hi - lo);
+                                vertex.Normal = n;
+                                vertex.TexCoords = glm::vec2((su + 1.0f) * 0.5f,
+                                                             (sv + 1.0f) * 0.5f);
+                                vertex.Tangent = u;
+                                vertex.Bitangent = v;
+                                vertices.push_back(vertex);
+                        }
+                        unsigned int quad[6] = {0, 1, 2, 0, 2, 3};
+                        for (unsigned int q : quad)
+                                indices.push_back(base + q);
+                }
+                return Mesh(std::move(vertices), std::move(indices),
+                            vector<Texture>(1, texture), layout);
         }
 
-        // processes a node in a recursive fashion. Processes each individual mesh
-        // located at the node and repeats this process on its children nodes (if
-        // any).
-        void processNode(aiNode *node, const aiScene *scene)
+        // registers every referenced texture that isn't known yet, with the key of
+        // its content. A texture keeps the type it was first referenced as.
+        static void listTextures(ModelData &data, const vector<TextureRef> &refs)
+        {
+                for (const TextureRef &ref : refs) {
+                        bool known = false;
+                        for (const ModelTexture &texture : data.textures) {
+                                if (texture.ref.path == ref.path) {
+                                        known = true;
+                                        break;
+                                }
+                        }
+                        if (known)
+                                continue;
+
+                        // model textures are flipped on the y-axis on load
+                        ModelTexture texture;
+                        texture.ref = ref;
+                        texture.file = data.directory + '/' + ref.path;
+                        texture.key =
+                            TextureCache::makeKey(vector<string>(1, texture.file),
+                                                  textureFormat(ref.type), true, false);
+                        data.textures.push_back(texture);
+                }
+        }
+
+        // collects the meshes located at a node in a recursive fashion, repeating
+        // the process on its children nodes (if any).
+        static void processNode(aiNode *node, const aiScene *scene,
+                                vector<aiMesh *> &sceneMeshes)
         {
                 // process each mesh located at the current node
                 for (unsigned int i = 0; i < node->mNumMeshes; i++) {
                         // the node object only contains indices to index the actual
                         // objects in the scene. the scene contains all the data, node is
                         // just to keep stuff organized (like relations between nodes).
-                        aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-                        meshes.push_back(processMesh(mesh, scene));
+                        sceneMeshes.push_back(scene->mMeshes[node->mMeshes[i]]);
                 }
                 // after we've processed all of the meshes (if any) we then recursively
                 // process each of the children nodes
                 for (unsigned int i = 0; i < node->mNumChildren; i++) {
-                        processNode(node->mChildren[i], scene);
+                        processNode(node->mChildren[i], scene, sceneMeshes);
                 }
         }
 
-        Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+        static MeshData processMesh(aiMesh *mesh, const aiScene *scene)
         {
                 // data to fill
-                vector<Vertex> vertices;
-                vector<unsigned int> indices;
-                vector<Texture> textures;
+                MeshData data;
+                vector<Vertex> &vertices = data.vertices;
+                vector<unsigned int> &indices = data.indices;
+                vector<TextureRef> &textures = data.textures;
+                vertices.reserve(mesh->mNumVertices);
+                indices.reserve(mesh->mNumFaces * 3);
 
                 // walk through each of the mesh's vertices
                 for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
@@ -174,61 +838,46 @@ class Model
                 material->Get(AI_MATKEY_COLOR_AMBIENT, color);
 
                 // 1. diffuse maps
-                vector<Texture> diffuseMaps = loadMaterialTextures(
-                    material, aiTextureType_DIFFUSE, "texture_diffuse");
-                textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+                collectMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse",
+                                        textures);
                 // 2. specular maps
-                vector<Texture> specularMaps = loadMaterialTextures(
-                    material, aiTextureType_SPECULAR, "texture_specular");
-                textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+                collectMaterialTextures(material, aiTextureType_SPECULAR,
+                                        "texture_specular", textures);
                 // 3. normal maps
-                std::vector<Texture> normalMaps = loadMaterialTextures(
-                    material, aiTextureType_HEIGHT, "texture_normal");
-                textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+                collectMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal",
+                                        textures);
                 // 4. height maps
-                std::vector<Texture> heightMaps = loadMaterialTextures(
-                    material, aiTextureType_AMBIENT, "texture_height");
-                textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+                collectMaterialTextures(material, aiTextureType_AMBIENT, "texture_height",
+                                        textures);
 
-                // return a mesh object created from the extracted mesh data
-                return Mesh(vertices, indices, textures);
+                // return the extracted mesh data, the GL objects are created by the
+                // caller
+                return data;
         }
 
-        // checks all material textures of a given type and loads the textures if
-        // they're not loaded yet. the required info is returned as a Texture
-        // struct.
-        vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type,
-                                             string typeName)
+        // appends references to all material textures of a given type
+        static void collectMaterialTextures(aiMaterial *mat, aiTextureType type,
+                                            string typeName, vector<TextureRef> &textures)
         {
-                vector<Texture> textures;
                 for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
                         aiString str;
                         mat->GetTexture(type, i, &str);
-                        // check if texture was loaded before and if so, continue to next
-                        // iteration: skip loading a new texture
-                        bool skip = false;
-                        for (unsigned int j = 0; j < textures_loaded.size(); j++) {
-                                if (std::strcmp(textures_loaded[j].path.data(),
-                                                str.C_Str()) == 0) {
-                                        textures.push_back(textures_loaded[j]);
-                                        skip = true; // a texture with the same filepath
-                                                     // has already been loaded, continue
-                                                     // to next one. (optimization)
-                                        break;
-                                }
-                        }
-                        if (!skip) { // if texture hasn't been loaded already, load it
-                                Texture texture;
-                                texture.id =
-                                    TextureFromFile(str.C_Str(), this->directory);
-                                texture.type = typeName;
-                                texture.path = str.C_Str();
-                                textures.push_back(texture);
-                                textures_loaded.push_back(
-                                    texture); // store it as texture loaded for entire
-                                              // model, to ensure we won't unnecesery load
-                                              // duplicate textures.
-                        }
+                        TextureRef ref;
+                        ref.type = typeName;
+                        ref.path = str.C_Str();
+                        textures.push_back(ref);
+                }
+        }
+
+        // looks up the loaded textures of a mesh. a texture with the same filepath
+        // is only loaded once (optimization).
+        vector<Texture> findTextures(const vector<TextureRef> &refs)
+        {
+                vector<Texture> textures;
+                for (const TextureRef &ref : refs) {
+                        auto it = texturesByPath.find(ref.path);
+                        if (it != texturesByPath.end())
+                                textures.push_back(textures_loaded[it->second]);
                 }
                 return textures;
         }
@@ -236,41 +885,16 @@ class Model
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
 {
-        string filename = string(path);
-        filename = directory + '/' + filename;
-
-        unsigned int textureID;
-        glGenTextures(1, &textureID);
-
-        int width, height, nrComponents;
-        unsigned char *data =
-            stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-        if (data) {
-                GLenum format;
-                if (nrComponents == 1)
-                        format = GL_RED;
-                else if (nrComponents == 3)
-                        format = GL_RGB;
-                else if (nrComponents == 4)
-                        format = GL_RGBA;
-
-                glBindTexture(GL_TEXTURE_2D, textureID);
-                glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format,
-                             GL_UNSIGNED_BYTE, data);
-                glGenerateMipmap(GL_TEXTURE_2D);
-
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-                                GL_LINEAR_MIPMAP_LINEAR);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-                stbi_image_free(data);
-        } else {
-                std::cout << "Texture failed to load at path: " << path << std::endl;
-                stbi_image_free(data);
-        }
+        ImageDecodeBatch images;
+        images.add(directory + '/' + string(path), true);
+        images.decode();
+        return TextureFromImage(images.image(0), gamma, images.image(0).pixels());
+}
 
-        return textureID;
+unsigned int TextureFromImage(const DecodedImage &image, bool gamma, const void *pixels)
+{
+        // model textures keep the format of the image and are repeated
+        TextureFormat format;
+        return createTexture2D(image, format, pixels);
 }
 #endif
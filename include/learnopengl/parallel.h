@@ -0,0 +1,129 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Process-wide pool of worker threads for CPU side loading work (image decoding,
+// mesh conversion...). There is one worker per hardware thread minus the caller,
+// which always takes part in the work it submits. Because the caller can finish a
+// parallelFor on its own, parallelFor calls may be nested or issued from several
+// threads at once without deadlocking the pool.
+class JobPool
+{
+      public:
+        static JobPool &instance()
+        {
+                static JobPool pool;
+                return pool;
+        }
+
+        JobPool(const JobPool &) = delete;
+        JobPool &operator=(const JobPool &) = delete;
+
+        ~JobPool()
+        {
+                {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        stopping = true;
+                }
+                wakeUp.notify_all();
+                for (std::thread &worker : workers)
+                        worker.join();
+        }
+
+        // number of threads that can work on a parallelFor, caller included
+        size_t concurrency() const { return workers.size() + 1; }
+
+        // calls fn(i) for every i in [0, count), spread over the pool. Returns when
+        // all calls have finished.
+        void parallelFor(size_t count, const std::function<void(size_t)> &fn)
+        {
+                if (count == 0)
+                        return;
+                if (count == 1 || workers.empty()) {
+                        for (size_t i = 0; i < count; i++)
+                                fn(i);
+                        return;
+                }
+
+                std::shared_ptr<Batch> batch = std::make_shared<Batch>(count, fn);
+                size_t helpers = std::min(count - 1, workers.size());
+                {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        for (size_t i = 0; i < helpers; i++)
+                                jobs.push_back([batch]() { batch->run(); });
+                }
+                wakeUp.notify_all();
+
+                batch->run();
+                std::unique_lock<std::mutex> lock(batch->mutex);
+                batch->finished.wait(lock, [&]() { return batch->done == count; });
+        }
+
+      private:
+        struct Batch {
+                Batch(size_t count, const std::function<void(size_t)> &fn)
+                    : next(0), done(0), count(count), fn(fn)
+                {
+                }
+
+                // claims and runs items until there are none left
+                void run()
+                {
+                        size_t i;
+                        while ((i = next++) < count) {
+                                fn(i);
+                                std::lock_guard<std::mutex> lock(mutex);
+                                if (++done == count)
+                                        finished.notify_all();
+                        }
+                }
+
+                std::atomic<size_t> next;
+                size_t done;
+                size_t count;
+                std::function<void(size_t)> fn;
+                std::mutex mutex;
+                std::condition_variable finished;
+        };
+
+        JobPool() : stopping(false)
+        {
+                unsigned int threads = std::thread::hardware_concurrency();
+                for (unsigned int i = 1; i < threads; i++)
+                        workers.emplace_back([this]() { workerLoop(); });
+        }
+
+        void workerLoop()
+        {
+                for (;;) {
+                        std::function<void()> job;
+                        {
+                                std::unique_lock<std::mutex> lock(mutex);
+                                wakeUp.wait(lock,
+                                            [this]() { return stopping || !jobs.empty(); });
+                                if (jobs.empty())
+                                        return;
+                                job = std::move(jobs.front());
+                                jobs.pop_front();
+                        }
+                        job();
+                }
+        }
+
+        std::vector<std::thread> workers;
+        std::deque<std::function<void()>> jobs;
+        std::mutex mutex;
+        std::condition_variable wakeUp;
+        bool stopping;
+};
+
+#endif
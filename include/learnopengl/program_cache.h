@@ -0,0 +1,232 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/resource_pack.h>
+
+#include <sys/stat.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// The core 3.3 loader doesn't know program binaries (core since 4.1, and
+// ARB_get_program_binary before that); the entry points are loaded by hand.
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+// Linked programs saved with glGetProgramBinary, so later runs skip compiling and
+// linking. A binary is keyed by a hash of the shader sources and stored under
+// program_cache/ in the project root; the GL vendor, renderer and version strings
+// are recorded with it, so a driver update or another GPU never loads a binary made
+// for something else. A binary the driver rejects anyway is compiled from source
+// again and replaced. Used from the thread that owns the main context only.
+const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+struct ProgramCacheHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t binaryFormat;
+        uint64_t sourceHash;
+        uint64_t driverHash;
+        uint64_t binarySize;
+};
+
+class ProgramBinaryCache
+{
+      public:
+        static ProgramBinaryCache &instance()
+        {
+                static ProgramBinaryCache cache;
+                return cache;
+        }
+
+        ProgramBinaryCache(const ProgramBinaryCache &) = delete;
+        ProgramBinaryCache &operator=(const ProgramBinaryCache &) = delete;
+
+        // looks the entry points up with the loader glad was given. Without them,
+        // or when the driver has no binary format, every program is compiled.
+        void init(GLADloadproc loader)
+        {
+                GLint major = 0, minor = 0, formats = 0;
+                glGetIntegerv(GL_MAJOR_VERSION, &major);
+                glGetIntegerv(GL_MINOR_VERSION, &minor);
+                bool core = major > 4 || (major == 4 && minor >= 1);
+                if (!core && !hasExtension("GL_ARB_get_program_binary"))
+                        return;
+                glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+                getProgramBinary = (GetProgramBinary)loader("glGetProgramBinary");
+                programBinary = (ProgramBinary)loader("glProgramBinary");
+                programParameteri = (ProgramParameteri)loader("glProgramParameteri");
+                if (formats <= 0 || !getProgramBinary || !programBinary ||
+                    !programParameteri)
+                        return;
+
+                std::string driver;
+                const GLenum names[] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+                for (GLenum name : names) {
+                        const char *value = (const char *)glGetString(name);
+                        driver += value ? value : "";
+                        driver += '\n';
+                }
+                driverHash =
+                    hashBytes((const unsigned char *)driver.data(), driver.size());
+                directory = FileSystem::getPath("program_cache");
+                mkdir(directory.c_str(), 0755);
+                enabled = true;
+        }
+
+        bool isEnabled() const { return enabled; }
+
+        // whether the driver exposes the given extension
+        static bool hasExtension(const char *extension)
+        {
+                GLint count = 0;
+                glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+                for (GLint i = 0; i < count; i++) {
+                        const char *name = (const char *)glGetStringi(GL_EXTENSIONS, i);
+                        if (name && strcmp(name, extension) == 0)
+                                return true;
+                }
+                return false;
+        }
+
+        // adds one shader source to a program key
+        static uint64_t hashSource(const char *source, size_t size,
+                                   uint64_t hash = 14695981039346656037ull)
+        {
+                uint64_t length = size;
+                hash = hashBytes((const unsigned char *)&length, sizeof(length), hash);
+                return hashBytes((const unsigned char *)source, size, hash);
+        }
+
+        // creates a program from the binary stored for the given sources. Returns 0
+        // when there is none or the driver rejects it.
+        unsigned int load(uint64_t sourceHash)
+        {
+                if (!enabled)
+                        return 0;
+                MappedFile file;
+                ProgramCacheHeader header;
+                if (!file.open(path(sourceHash)) || file.size < sizeof(header)) {
+                        misses++;
+                        return 0;
+                }
+                memcpy(&header, file.data, sizeof(header));
+                if (memcmp(header.magic, "LOGLPROG", 8) != 0 ||
+                    header.version != PROGRAM_CACHE_VERSION ||
+                    header.sourceHash != sourceHash || header.driverHash != driverHash ||
+                    header.binarySize != file.size - sizeof(header)) {
+                        misses++;
+                        return 0;
+                }
+
+                unsigned int program = glCreateProgram();
+                programBinary(program, header.binaryFormat, file.data + sizeof(header),
+                              (GLsizei)header.binarySize);
+                GLint linked = GL_FALSE;
+                glGetProgramiv(program, GL_LINK_STATUS, &linked);
+                if (!linked) {
+                        glDeleteProgram(program);
+                        rejected++;
+                        misses++;
+                        return 0;
+                }
+                hits++;
+                return program;
+        }
+
+        // to be called before glLinkProgram, so the binary can be retrieved later
+        void prepare(unsigned int program)
+        {
+                if (enabled)
+                        programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                                          GL_TRUE);
+        }
+
+        // saves the binary of a successfully linked program
+        void store(uint64_t sourceHash, unsigned int program)
+        {
+                GLint linked = GL_FALSE, length = 0;
+                if (!enabled)
+                        return;
+                glGetProgramiv(program, GL_LINK_STATUS, &linked);
+                glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+                if (!linked || length <= 0)
+                        return;
+                std::vector<char> binary(length);
+                GLenum format = 0;
+                getProgramBinary(program, length, &length, &format, binary.data());
+
+                ProgramCacheHeader header;
+                memcpy(header.magic, "LOGLPROG", 8);
+                header.version = PROGRAM_CACHE_VERSION;
+                header.binaryFormat = format;
+                header.sourceHash = sourceHash;
+                header.driverHash = driverHash;
+                header.binarySize = length;
+                std::string file = path(sourceHash);
+                std::string tmpFile = file + ".tmp";
+                {
+                        std::ofstream out(tmpFile, std::ios::binary | std::ios::trunc);
+                        out.write((const char *)&header, sizeof(header));
+                        out.write(binary.data(), length);
+                        if (!out)
+                                return;
+                }
+                std::rename(tmpFile.c_str(), file.c_str());
+        }
+
+        void report(std::ostream &out) const
+        {
+                if (!enabled) {
+                        out << "SHADER::PROGRAM_CACHE:: not supported by the driver"
+                            << std::endl;
+                        return;
+                }
+                out << "SHADER::PROGRAM_CACHE:: " << hits << " loaded, " << misses
+                    << " compiled (" << rejected << " binaries rejected by the driver)"
+                    << std::endl;
+        }
+
+      private:
+        typedef void(APIENTRYP GetProgramBinary)(GLuint, GLsizei, GLsizei *, GLenum *,
+                                                 void *);
+        typedef void(APIENTRYP ProgramBinary)(GLuint, GLenum, const void *, GLsizei);
+        typedef void(APIENTRYP ProgramParameteri)(GLuint, GLenum, GLint);
+
+        bool enabled = false;
+        uint64_t driverHash = 0;
+        std::string directory;
+        GetProgramBinary getProgramBinary = nullptr;
+        ProgramBinary programBinary = nullptr;
+        ProgramParameteri programParameteri = nullptr;
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t rejected = 0;
+
+        ProgramBinaryCache() {}
+
+        std::string path(uint64_t sourceHash) const
+        {
+                char name[32];
+                snprintf(name, sizeof(name), "/%016llx.bin",
+                         (unsigned long long)sourceHash);
+                return directory + name;
+        }
+};
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// Passes of a frame, in the order they are flushed. Sky is drawn after the opaque
+// pass, so early-z rejects it wherever something is in front, and before the
+// transparent pass, which blends over it.
+enum class RenderPass { Opaque, Sky, Transparent };
+
+// A draw submitted to a RenderQueue: the program and state it needs and the draw
+// calls, made with the program in use and that state set.
+struct RenderItem {
+        RenderPass pass = RenderPass::Opaque;
+        Shader *shader = nullptr;
+        // bound before drawing; 0 if the draw binds its own
+        unsigned int vertexArray = 0;
+        // bound to unit 0; 0 for none
+        unsigned int texture = 0;
+        GLenum textureTarget = GL_TEXTURE_2D;
+        bool cullFaces = true;
+        // set as the "model" uniform; its translation gives the depth of the draw
+        glm::mat4 model = glm::mat4(1.0f);
+        // the draw calls; the queue is flushed within the frame, so they may capture
+        // locals of it by reference
+        std::function<void(Shader &, const glm::mat4 &)> draw;
+};
+
+// Collects the draws of a frame and makes them sorted by a 64-bit key, one pass at
+// a time. The order is up to the key, not to the order of submission:
+//   opaque, sky:  pass (2 bits) | program (12) | material (12) | vertex array (14) |
+//                 depth (24), so draws sharing state go together and, with the
+//                 same state, front to back
+//   transparent:  pass | inverted depth | program | material | vertex array, back
+//                 to front, as blending needs
+// Program, material and vertex array are the low bits of their GL names; names
+// that collide are only grouped less well.
+class RenderQueue
+{
+      public:
+        // starts a frame seen through view, with depths up to farPlane told apart.
+        // Items of the last frame that weren't flushed are dropped.
+        void begin(const glm::mat4 &view, float farPlane)
+        {
+                this->view = view;
+                this->farPlane = farPlane;
+                items.clear();
+                keys.clear();
+        }
+
+        void submit(const RenderItem &item)
+        {
+                glm::vec4 position = view * item.model[3];
+                float depth = std::min(std::max(-position.z / farPlane, 0.0f), 1.0f);
+                uint64_t quantized = (uint64_t)(depth * DEPTH_MAX);
+                if (item.pass == RenderPass::Transparent)
+                        quantized = DEPTH_MAX - quantized;
+                uint64_t program = item.shader->ID & 0xfff;
+                uint64_t material = item.texture & 0xfff;
+                uint64_t vertexArray = item.vertexArray & 0x3fff;
+                uint64_t state = program << 26 | material << 14 | vertexArray;
+                uint64_t key = (uint64_t)item.pass << 62;
+                if (item.pass == RenderPass::Transparent)
+                        key |= quantized << 38 | state;
+                else
+                        key |= state << 24 | quantized;
+                items.push_back(item);
+                keys.push_back(std::make_pair(key, (uint32_t)(items.size() - 1)));
+        }
+
+        // draws the items of a pass, in key order, and drops them
+        void flush(RenderPass pass)
+        {
+                GLState &state = GLState::instance();
+                uint64_t first = (uint64_t)pass << 62;
+                uint64_t last = first | ((1ull << 62) - 1);
+                sorted.clear();
+                for (const std::pair<uint64_t, uint32_t> &key : keys)
+                        if (key.first >= first && key.first <= last)
+                                sorted.push_back(key);
+                // items with equal keys are drawn in the order they came in
+                std::stable_sort(sorted.begin(), sorted.end(),
+                                 [](const std::pair<uint64_t, uint32_t> &a,
+                                    const std::pair<uint64_t, uint32_t> &b) {
+                                         return a.first < b.first;
+                                 });
+
+                // the sky is at the far plane, where GL_LESS would reject it
+                if (pass == RenderPass::Sky)
+                        state.depthFunc(GL_LEQUAL);
+                for (const std::pair<uint64_t, uint32_t> &key : sorted) {
+                        RenderItem &item = items[key.second];
+                        Shader &shader = *item.shader;
+                        shader.use();
+                        state.enable(GL_CULL_FACE, item.cullFaces);
+                        if (item.vertexArray != 0)
+                                state.bindVertexArray(item.vertexArray);
+                        if (item.texture != 0)
+                                state.bindTexture(0, item.textureTarget, item.texture);
+                        shader.setMat4(UNIFORM("model"), item.model);
+                        item.draw(shader, item.model);
+                }
+                if (pass == RenderPass::Sky)
+                        state.depthFunc(GL_LESS);
+
+                keys.erase(std::remove_if(keys.begin(), keys.end(),
+                                          [&](const std::pair<uint64_t, uint32_t> &key) {
+                                                  return key.first >= first &&
+                                                         key.first <= last;
+                                          }),
+                           keys.end());
+        }
+
+        // draws every pass
+        void flush()
+        {
+                flush(RenderPass::Opaque);
+                flush(RenderPass::Sky);
+                flush(RenderPass::Transparent);
+        }
+
+      private:
+        static const uint64_t DEPTH_MAX = (1u << 24) - 1;
+
+        glm::mat4 view = glm::mat4(1.0f);
+        float farPlane = 100.0f;
+        std::vector<RenderItem> items;
+        // sort key and index in items of every item not drawn yet
+        std::vector<std::pair<uint64_t, uint32_t>> keys;
+        std::vector<std::pair<uint64_t, uint32_t>> sorted;
+};
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef RENDER_VIEW_H
+#define RENDER_VIEW_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/camera.h>
+#include <learnopengl/meshlet.h>
+
+#include <cmath>
+
+// What the per-instance decisions of a frame (level of detail, cluster culling)
+// need to know about the camera. Built once per frame and passed to Model::Draw.
+struct RenderView {
+        glm::vec3 eye;
+        glm::mat4 viewProjection;
+        // pixels covered by one unit of length at distance one
+        float pixelsPerUnit;
+        // drop meshlets outside the frustum or facing away (see meshlet.h)
+        bool cullClusters;
+        // optional, receives what the culling did
+        ClusterStats *stats;
+
+        RenderView(const Camera &camera, const glm::mat4 &projection,
+                   const glm::mat4 &view, float viewportHeight)
+            : eye(camera.Position), viewProjection(projection * view),
+              pixelsPerUnit(viewportHeight /
+                            (2.0f * std::tan(glm::radians(camera.Zoom) * 0.5f))),
+              cullClusters(true), stats(nullptr)
+        {
+        }
+};
+
+#endif
@@ -0,0 +1,368 @@
+#ifndef RESOURCE_PACK_H
+#define RESOURCE_PACK_H
+
+#include <learnopengl/filesystem.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// 64-bit FNV-1a, good enough to detect a changed source file
+inline uint64_t hashBytes(const unsigned char *data, size_t size,
+                          uint64_t hash = 14695981039346656037ull)
+{
+        for (size_t i = 0; i < size; i++) {
+                hash ^= data[i];
+                hash *= 1099511628211ull;
+        }
+        return hash;
+}
+
+// read-only memory mapping of a whole file
+class MappedFile
+{
+      public:
+        MappedFile() : data(nullptr), size(0) {}
+        ~MappedFile() { close(); }
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        bool open(const std::string &path)
+        {
+                close();
+                int fd = ::open(path.c_str(), O_RDONLY);
+                if (fd < 0)
+                        return false;
+                struct stat st;
+                if (fstat(fd, &st) != 0 || st.st_size == 0) {
+                        ::close(fd);
+                        return false;
+                }
+                void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                ::close(fd);
+                if (mapped == MAP_FAILED)
+                        return false;
+                data = static_cast<const unsigned char *>(mapped);
+                size = st.st_size;
+                return true;
+        }
+
+        void close()
+        {
+                if (data)
+                        munmap(const_cast<unsigned char *>(data), size);
+                data = nullptr;
+                size = 0;
+        }
+
+        const unsigned char *data;
+        size_t size;
+};
+
+// All of resources/ in one file, made by the asset cooker (tools/asset_cooker.cpp)
+// and mapped once at startup. It holds the shader sources and images as they are,
+// plus what the loaders would otherwise find cached next to a source file: the
+// "<model>.meshcache" of every model and the "<image>.ktx" of block compressed
+// images. Files are looked up by their path relative to the project root and served
+// straight out of the mapping. Without a pack every file is read from resources/
+// itself, and with one a loose file that is newer than the pack still wins over
+// its entry, so edits show up during development without cooking again.
+//
+// Layout (all integers little endian):
+//   PackHeader
+//   PackEntry[entryCount], sorted by path
+//   the paths of the entries, one after the other
+//   the file contents, each 16-byte aligned
+
+const uint32_t RESOURCE_PACK_VERSION = 1;
+
+struct PackHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t entryCount;
+        uint64_t pathBytes;
+};
+
+struct PackEntry {
+        // contents, from the start of the pack
+        uint64_t offset;
+        uint64_t size;
+        // hash of whatever the entry was cooked from, so the cooker can keep the
+        // entries whose inputs haven't changed
+        uint64_t inputHash;
+        uint32_t pathOffset;
+        uint32_t pathLength;
+};
+
+// a file to be written into a pack
+struct PackFile {
+        std::string path;
+        uint64_t inputHash;
+        std::vector<unsigned char> bytes;
+};
+
+class ResourcePack
+{
+      public:
+        static ResourcePack &instance()
+        {
+                static ResourcePack pack;
+                return pack;
+        }
+
+        ResourcePack(const ResourcePack &) = delete;
+        ResourcePack &operator=(const ResourcePack &) = delete;
+
+        static const size_t NOT_FOUND = (size_t)-1;
+
+        // maps a pack. Meant to be called once at startup, before any loading
+        // thread runs; lookups are thread safe from then on.
+        bool open(const std::string &path)
+        {
+                close();
+                struct stat st;
+                if (stat(path.c_str(), &st) != 0 || !file.open(path))
+                        return false;
+                written = st.st_mtime;
+                PackHeader header;
+                if (file.size < sizeof(header))
+                        return fail();
+                memcpy(&header, file.data, sizeof(header));
+                size_t tableBytes = (size_t)header.entryCount * sizeof(PackEntry);
+                if (memcmp(header.magic, "LOGLPACK", 8) != 0 ||
+                    header.version != RESOURCE_PACK_VERSION ||
+                    file.size - sizeof(header) < tableBytes ||
+                    file.size - sizeof(header) - tableBytes < header.pathBytes)
+                        return fail();
+                entries = reinterpret_cast<const PackEntry *>(file.data + sizeof(header));
+                paths = reinterpret_cast<const char *>(file.data + sizeof(header) +
+                                                       tableBytes);
+                count = header.entryCount;
+                for (size_t i = 0; i < count; i++) {
+                        const PackEntry &entry = entries[i];
+                        if (entry.offset > file.size ||
+                            entry.size > file.size - entry.offset ||
+                            (uint64_t)entry.pathOffset + entry.pathLength >
+                                header.pathBytes)
+                                return fail();
+                }
+                return true;
+        }
+
+        void close()
+        {
+                file.close();
+                entries = nullptr;
+                paths = nullptr;
+                count = 0;
+        }
+
+        bool isOpen() const { return file.data != nullptr; }
+        size_t size() const { return count; }
+        size_t bytes() const { return file.size; }
+
+        std::string path(size_t i) const
+        {
+                return std::string(paths + entries[i].pathOffset, entries[i].pathLength);
+        }
+        const PackEntry &entry(size_t i) const { return entries[i]; }
+        const unsigned char *contents(size_t i) const
+        {
+                return file.data + entries[i].offset;
+        }
+
+        // index of the entry of a file, given by its path relative to the project
+        // root or as FileSystem::getPath builds it; NOT_FOUND if it isn't packed
+        size_t find(const std::string &path) const
+        {
+                if (count == 0)
+                        return NOT_FOUND;
+                std::string key = relativePath(path);
+                size_t lo = 0, hi = count;
+                while (lo < hi) {
+                        size_t mid = (lo + hi) / 2;
+                        int order = compare(mid, key);
+                        if (order == 0)
+                                return mid;
+                        if (order < 0)
+                                lo = mid + 1;
+                        else
+                                hi = mid;
+                }
+                return NOT_FOUND;
+        }
+
+        bool find(const std::string &path, const unsigned char *&data,
+                  size_t &size) const
+        {
+                size_t i = find(path);
+                if (i == NOT_FOUND)
+                        return false;
+                data = contents(i);
+                size = entries[i].size;
+                return true;
+        }
+
+        // whether the loose file at path is newer than the pack, and so has to be
+        // read instead of its entry (and caches made from it checked again)
+        bool overridden(const std::string &path) const
+        {
+                struct stat st;
+                return isOpen() && stat(path.c_str(), &st) == 0 && st.st_mtime > written;
+        }
+
+        // the path a file is packed under: relative to the project root, without
+        // "./" components
+        static std::string relativePath(const std::string &path)
+        {
+                std::string root = FileSystem::getPath("");
+                std::string relative = path;
+                if (root.size() > 1 && relative.compare(0, root.size(), root) == 0)
+                        relative.erase(0, root.size());
+                while (relative.compare(0, 2, "./") == 0)
+                        relative.erase(0, 2);
+                for (size_t dot; (dot = relative.find("/./")) != std::string::npos;)
+                        relative.erase(dot, 2);
+                return relative;
+        }
+
+        // writes a pack of the given files (sorting them by path) under a temporary
+        // name and renames it, so a crash never leaves a torn pack behind
+        static bool write(const std::string &path, std::vector<PackFile> &files)
+        {
+                std::sort(files.begin(), files.end(),
+                          [](const PackFile &a, const PackFile &b) {
+                                  return a.path < b.path;
+                          });
+                PackHeader header;
+                memcpy(header.magic, "LOGLPACK", 8);
+                header.version = RESOURCE_PACK_VERSION;
+                header.entryCount = files.size();
+                header.pathBytes = 0;
+                std::vector<PackEntry> table(files.size());
+                for (size_t i = 0; i < files.size(); i++) {
+                        table[i].pathOffset = header.pathBytes;
+                        table[i].pathLength = files[i].path.size();
+                        header.pathBytes += files[i].path.size();
+                }
+                uint64_t offset = sizeof(header) + table.size() * sizeof(PackEntry) +
+                                  header.pathBytes;
+                for (size_t i = 0; i < files.size(); i++) {
+                        offset = align(offset);
+                        table[i].offset = offset;
+                        table[i].size = files[i].bytes.size();
+                        table[i].inputHash = files[i].inputHash;
+                        offset += files[i].bytes.size();
+                }
+
+                static const char zeros[16] = {0};
+                std::string tmpPath = path + ".tmp";
+                {
+                        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+                        if (!out)
+                                return false;
+                        out.write((const char *)&header, sizeof(header));
+                        out.write((const char *)table.data(),
+                                  table.size() * sizeof(PackEntry));
+                        for (const PackFile &file : files)
+                                out.write(file.path.data(), file.path.size());
+                        uint64_t written = sizeof(header) +
+                                           table.size() * sizeof(PackEntry) +
+                                           header.pathBytes;
+                        for (size_t i = 0; i < files.size(); i++) {
+                                out.write(zeros, table[i].offset - written);
+                                out.write((const char *)files[i].bytes.data(),
+                                          files[i].bytes.size());
+                                written = table[i].offset + table[i].size;
+                        }
+                        if (!out)
+                                return false;
+                }
+                return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+        }
+
+      private:
+        MappedFile file;
+        const PackEntry *entries;
+        const char *paths;
+        size_t count;
+        // modification time of the pack
+        time_t written;
+
+        ResourcePack() : entries(nullptr), paths(nullptr), count(0), written(0) {}
+
+        bool fail()
+        {
+                close();
+                return false;
+        }
+
+        int compare(size_t i, const std::string &key) const
+        {
+                const PackEntry &entry = entries[i];
+                int order = memcmp(paths + entry.pathOffset, key.data(),
+                                   std::min<size_t>(entry.pathLength, key.size()));
+                if (order != 0)
+                        return order;
+                return entry.pathLength < key.size() ? -1 : entry.pathLength > key.size();
+        }
+
+        static uint64_t align(uint64_t offset) { return (offset + 15) & ~(uint64_t)15; }
+};
+
+// Bytes of a file under resources/: a view into the resource pack when the file is
+// packed and not overridden by a newer loose file, the mapped loose file otherwise.
+// Nothing is copied either way.
+class FileView
+{
+      public:
+        FileView() : data(nullptr), size(0), packed(false) {}
+        explicit FileView(const std::string &path) : FileView() { open(path); }
+        FileView(const FileView &) = delete;
+        FileView &operator=(const FileView &) = delete;
+
+        bool open(const std::string &path)
+        {
+                close();
+                ResourcePack &pack = ResourcePack::instance();
+                if (pack.find(path, data, size) && !pack.overridden(path)) {
+                        packed = true;
+                        return true;
+                }
+                if (!file.open(path))
+                        return false;
+                data = file.data;
+                size = file.size;
+                return true;
+        }
+
+        void close()
+        {
+                file.close();
+                data = nullptr;
+                size = 0;
+                packed = false;
+        }
+
+        bool isOpen() const { return data != nullptr; }
+
+        const unsigned char *data;
+        size_t size;
+        // served from the resource pack
+        bool packed;
+
+      private:
+        MappedFile file;
+};
+
+#endif
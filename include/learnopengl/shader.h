@@ -5,236 +5,513 @@
 #include <glm/glm.hpp>
 
 #include <common.h>
-#include <fstream>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/shader_manager.h>
+#include <learnopengl/uniform_buffer.h>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
 #include <iostream>
-#include <sstream>
+#include <memory>
 #include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// a sampler uniform a program reads, and the texture unit it is set to
+struct ActiveSampler {
+        std::string name;
+        int unit;
+};
+
+// 64-bit FNV-1a hash (as hashBytes) of the first N characters of a uniform name,
+// a step per character so it can be evaluated as a constant
+template <size_t N> struct UniformHash {
+        static constexpr uint64_t of(const char *name, uint64_t hash)
+        {
+                return UniformHash<N - 1>::of(
+                    name + 1, (hash ^ (unsigned char)*name) * 1099511628211ull);
+        }
+};
 
-struct PointLight {
-    glm::vec3 position;
+template <> struct UniformHash<0> {
+        static constexpr uint64_t of(const char *, uint64_t hash) { return hash; }
+};
+
+// The name of a uniform, by its hash. UNIFORM("name") hashes a string literal at
+// compile time: the hash is a template argument of the constant it passes. A
+// std::string is hashed at run time.
+struct UniformName {
+        uint64_t hash;
 
-    glm::vec3 ambient;
-    glm::vec3 diffuse;
-    glm::vec3 specular;
+        template <uint64_t Hash>
+        constexpr UniformName(std::integral_constant<uint64_t, Hash>) : hash(Hash)
+        {
+        }
+        UniformName(const std::string &name) : hash(hashName(name)) {}
 
-    float constant;
-    float linear;
-    float quadratic;
+        static uint64_t hashName(const std::string &name)
+        {
+                return hashBytes(reinterpret_cast<const unsigned char *>(name.data()),
+                                 name.size());
+        }
 };
 
-struct DirLight {
-    glm::vec3 direction;
+#define UNIFORM(name)                                                                  \
+        std::integral_constant<uint64_t, UniformHash<sizeof(name) - 1>::of(            \
+                                             name, 14695981039346656037ull)>()
+
+// handle of a uniform of a program, from Shader::uniform(). An inactive uniform
+// (or one the program doesn't have) gets an invalid handle; setting it does nothing,
+// as with location -1.
+struct Uniform {
+        int index = -1;
 
-    glm::vec3 ambient;
-    glm::vec3 diffuse;
-    glm::vec3 specular;
+        bool valid() const { return index >= 0; }
 };
 
-struct SpotLight {
-    glm::vec3 position;
-    glm::vec3 direction;
-    float cutOff;
-    float outerCutOff;
+// The active uniforms of a program, read once it is linked, sorted by the hash of
+// their names. Array elements are entries of their own ("lights[2]"), and the bare
+// name of an array is its first element, as with glGetUniformLocation. Every entry
+// keeps the value last uploaded to it, so uploading the same value again can be
+// skipped: uniforms keep their values in the program while it isn't in use.
+class UniformTable
+{
+      public:
+        bool read = false;
+
+        void load(unsigned int program)
+        {
+                read = true;
+                GLint count = 0, maxLength = 0;
+                glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+                glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+                std::vector<char> name(maxLength > 0 ? maxLength : 1);
+                for (GLint i = 0; i < count; i++) {
+                        GLint size = 0;
+                        GLenum type = 0;
+                        GLsizei length = 0;
+                        glGetActiveUniform(program, i, name.size(), &length, &size, &type,
+                                           name.data());
+                        std::string full(name.data(), length);
+                        // members of uniform blocks have no location
+                        GLint location = glGetUniformLocation(program, full.c_str());
+                        if (location < 0)
+                                continue;
+                        add(full, location, type);
+                        if (full.size() < 3 ||
+                            full.compare(full.size() - 3, 3, "[0]") != 0)
+                                continue;
+                        std::string base = full.substr(0, full.size() - 3);
+                        add(base, location, type);
+                        for (GLint element = 1; element < size; element++) {
+                                std::string elementName =
+                                    base + "[" + std::to_string(element) + "]";
+                                add(elementName,
+                                    glGetUniformLocation(program, elementName.c_str()),
+                                    type);
+                        }
+                }
+                std::sort(entries.begin(), entries.end(),
+                          [](const Entry &a, const Entry &b) { return a.hash < b.hash; });
+                // an array and its first element share a location, and so a value
+                size_t bytes = 0;
+                for (size_t i = 0; i < entries.size(); i++) {
+                        Entry &entry = entries[i];
+                        entry.value = values.size();
+                        for (size_t j = 0; j < i; j++)
+                                if (entries[j].location == entry.location)
+                                        entry.value = entries[j].value;
+                        if (entry.value == values.size()) {
+                                values.push_back(Value{bytes, false});
+                                bytes += entry.size;
+                        }
+                }
+                storage.assign(bytes, 0);
+        }
+
+        Uniform find(uint64_t hash) const
+        {
+                auto it = std::lower_bound(
+                    entries.begin(), entries.end(), hash,
+                    [](const Entry &entry, uint64_t hash) { return entry.hash < hash; });
+                Uniform uniform;
+                if (it != entries.end() && it->hash == hash)
+                        uniform.index = (int)(it - entries.begin());
+                return uniform;
+        }
+
+        GLint location(Uniform uniform) const { return entries[uniform.index].location; }
+
+        // whether value differs from the one last uploaded to the uniform, which it
+        // then becomes. False for an invalid handle. A value of another size than the
+        // uniform's (a mistake GL reports) is never kept.
+        bool update(Uniform uniform, const void *value, size_t size)
+        {
+                if (!uniform.valid())
+                        return false;
+                const Entry &entry = entries[uniform.index];
+                Value &last = values[entry.value];
+                if (size != entry.size) {
+                        last.known = false;
+                        return true;
+                }
+                unsigned char *bytes = &storage[last.offset];
+                if (last.known && memcmp(bytes, value, size) == 0) {
+                        skipped++;
+                        return false;
+                }
+                memcpy(bytes, value, size);
+                last.known = true;
+                uploads++;
+                return true;
+        }
+
+        size_t uploads = 0;
+        size_t skipped = 0;
+
+      private:
+        struct Entry {
+                uint64_t hash;
+                GLint location;
+                size_t size;
+                size_t value; // index into values
+        };
 
-    float constant;
-    float linear;
-    float quadratic;
+        // where the last value uploaded to a location is kept in storage
+        struct Value {
+                size_t offset;
+                bool known;
+        };
 
-    glm::vec3 ambient;
-    glm::vec3 diffuse;
-    glm::vec3 specular;
+        std::vector<Entry> entries;
+        std::vector<Value> values;
+        std::vector<unsigned char> storage;
+
+        void add(const std::string &name, GLint location, GLenum type)
+        {
+                entries.push_back(Entry{UniformName::hashName(name), location,
+                                        valueSize(type), 0});
+        }
+
+        // bytes of a value of a uniform type, as the glUniform* calls take it
+        static size_t valueSize(GLenum type)
+        {
+                switch (type) {
+                case GL_FLOAT_VEC2:
+                case GL_INT_VEC2:
+                case GL_BOOL_VEC2:
+                        return 8;
+                case GL_FLOAT_VEC3:
+                case GL_INT_VEC3:
+                case GL_BOOL_VEC3:
+                        return 12;
+                case GL_FLOAT_VEC4:
+                case GL_INT_VEC4:
+                case GL_BOOL_VEC4:
+                case GL_FLOAT_MAT2:
+                        return 16;
+                case GL_FLOAT_MAT3:
+                        return 36;
+                case GL_FLOAT_MAT4:
+                        return 64;
+                default: // float, int, bool, samplers
+                        return 4;
+                }
+        }
 };
 
 class Shader
 {
       public:
         unsigned int ID;
-        // constructor generates the shader on the fly
+        // constructor starts building the program; it is finished (and its errors
+        // reported) by the first use(), so all shaders can compile at once.
+        // defines is put into the sources after #version (see ShaderManager).
+        // Copies of a Shader share its uniform table.
         // ------------------------------------------------------------------------
         Shader(const char *vertexPath, const char *fragmentPath,
-               const char *geometryPath = nullptr)
-        {
-                std::string vertexPathString(vertexPath);
-                std::string fragmentPathString(fragmentPath);
-
-                vertexPath = vertexPathString.c_str();
-                fragmentPath = fragmentPathString.c_str();
-                // 1. retrieve the vertex/fragment source code from filePath
-                std::string vertexCode;
-                std::string fragmentCode;
-                std::string geometryCode;
-                std::ifstream vShaderFile;
-                std::ifstream fShaderFile;
-                std::ifstream gShaderFile;
-                // ensure ifstream objects can throw exceptions:
-                vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-                fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-                gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-                try {
-                        // open files
-                        vShaderFile.open(vertexPath);
-                        fShaderFile.open(fragmentPath);
-                        std::stringstream vShaderStream, fShaderStream;
-                        // read file's buffer contents into streams
-                        vShaderStream << vShaderFile.rdbuf();
-                        fShaderStream << fShaderFile.rdbuf();
-                        // close file handlers
-                        vShaderFile.close();
-                        fShaderFile.close();
-                        // convert stream into string
-                        vertexCode = vShaderStream.str();
-                        fragmentCode = fShaderStream.str();
-                        // if geometry shader path is present, also load a geometry shader
-                        if (geometryPath != nullptr) {
-                                std::string geometryPathString(geometryPath);
-                                geometryPath = geometryPathString.c_str();
-                                gShaderFile.open(geometryPath);
-                                std::stringstream gShaderStream;
-                                gShaderStream << gShaderFile.rdbuf();
-                                gShaderFile.close();
-                                geometryCode = gShaderStream.str();
-                        }
-                } catch (std::ifstream::failure &e) {
-                        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ"
-                                  << std::endl;
-                }
-                const char *vShaderCode = vertexCode.c_str();
-                const char *fShaderCode = fragmentCode.c_str();
-                // 2. compile shaders
-                unsigned int vertex, fragment;
-                // vertex shader
-                vertex = glCreateShader(GL_VERTEX_SHADER);
-                glShaderSource(vertex, 1, &vShaderCode, NULL);
-                glCompileShader(vertex);
-                checkCompileErrors(vertex, "VERTEX");
-                // fragment Shader
-                fragment = glCreateShader(GL_FRAGMENT_SHADER);
-                glShaderSource(fragment, 1, &fShaderCode, NULL);
-                glCompileShader(fragment);
-                checkCompileErrors(fragment, "FRAGMENT");
-                // if geometry shader is given, compile geometry shader
-                unsigned int geometry;
-                if (geometryPath != nullptr) {
-                        const char *gShaderCode = geometryCode.c_str();
-                        geometry = glCreateShader(GL_GEOMETRY_SHADER);
-                        glShaderSource(geometry, 1, &gShaderCode, NULL);
-                        glCompileShader(geometry);
-                        checkCompileErrors(geometry, "GEOMETRY");
-                }
-                // shader Program
-                ID = glCreateProgram();
-                glAttachShader(ID, vertex);
-                glAttachShader(ID, fragment);
-                if (geometryPath != nullptr)
-                        glAttachShader(ID, geometry);
-                glLinkProgram(ID);
-                checkCompileErrors(ID, "PROGRAM");
-                // delete the shaders as they're linked into our program now and no
-                // longer necessery
-                glDeleteShader(vertex);
-                glDeleteShader(fragment);
-                if (geometryPath != nullptr)
-                        glDeleteShader(geometry);
+               const char *geometryPath = nullptr, const std::string &defines = "")
+            : ready(false), uniforms(std::make_shared<UniformTable>())
+        {
+                ID = ShaderManager::instance().submit(vertexPath, fragmentPath,
+                                                      geometryPath, defines);
         }
         // activate the shader
         // ------------------------------------------------------------------------
-        void use() { glUseProgram(ID); }
-        // utility uniform functions
+        void use()
+        {
+                if (!ready) {
+                        table();
+                        ready = true;
+                }
+                GLState::instance().useProgram(ID);
+        }
+        // handle of a uniform, to set it without looking it up by name
+        // ------------------------------------------------------------------------
+        Uniform uniform(UniformName name) const { return table().find(name.hash); }
+        // utility uniform functions. They set uniforms of this program, which has
+        // to be in use, and skip the upload when the uniform has the value already.
+        // Names are hashed at compile time when they are string literals.
+        // ------------------------------------------------------------------------
+        void setBool(Uniform uniform, bool value) const { setInt(uniform, (int)value); }
+        void setBool(UniformName name, bool value) const
+        {
+                setInt(uniform(name), (int)value);
+        }
+        // ------------------------------------------------------------------------
+        void setInt(Uniform uniform, int value) const
+        {
+                if (changed(uniform, &value, sizeof(value)))
+                        glUniform1i(location(uniform), value);
+        }
+        void setInt(UniformName name, int value) const { setInt(uniform(name), value); }
         // ------------------------------------------------------------------------
-        void setBool(const std::string &name, bool value) const
+        void setFloat(Uniform uniform, float value) const
         {
-                glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+                if (changed(uniform, &value, sizeof(value)))
+                        glUniform1f(location(uniform), value);
+        }
+        void setFloat(UniformName name, float value) const
+        {
+                setFloat(uniform(name), value);
         }
         // ------------------------------------------------------------------------
-        void setInt(const std::string &name, int value) const
+        void setVec2(Uniform uniform, const glm::vec2 &value) const
+        {
+                if (changed(uniform, &value[0], sizeof(value)))
+                        glUniform2fv(location(uniform), 1, &value[0]);
+        }
+        void setVec2(UniformName name, const glm::vec2 &value) const
         {
-                glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+                setVec2(uniform(name), value);
+        }
+        void setVec2(UniformName name, float x, float y) const
+        {
+                setVec2(uniform(name), glm::vec2(x, y));
         }
         // ------------------------------------------------------------------------
-        void setFloat(const std::string &name, float value) const
+        void setVec3(Uniform uniform, const glm::vec3 &value) const
+        {
+                if (changed(uniform, &value[0], sizeof(value)))
+                        glUniform3fv(location(uniform), 1, &value[0]);
+        }
+        void setVec3(UniformName name, const glm::vec3 &value) const
+        {
+                setVec3(uniform(name), value);
+        }
+        void setVec3(UniformName name, float x, float y, float z) const
         {
-                glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+                setVec3(uniform(name), glm::vec3(x, y, z));
         }
         // ------------------------------------------------------------------------
-        void setVec2(const std::string &name, const glm::vec2 &value) const
+        void setVec4(Uniform uniform, const glm::vec4 &value) const
         {
-                glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+                if (changed(uniform, &value[0], sizeof(value)))
+                        glUniform4fv(location(uniform), 1, &value[0]);
         }
-        void setVec2(const std::string &name, float x, float y) const
+        void setVec4(UniformName name, const glm::vec4 &value) const
         {
-                glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+                setVec4(uniform(name), value);
+        }
+        void setVec4(UniformName name, float x, float y, float z, float w) const
+        {
+                setVec4(uniform(name), glm::vec4(x, y, z, w));
         }
         // ------------------------------------------------------------------------
-        void setVec3(const std::string &name, const glm::vec3 &value) const
+        void setMat2(Uniform uniform, const glm::mat2 &mat) const
         {
-                glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+                if (changed(uniform, &mat[0][0], sizeof(mat)))
+                        glUniformMatrix2fv(location(uniform), 1, GL_FALSE, &mat[0][0]);
         }
-        void setVec3(const std::string &name, float x, float y, float z) const
+        void setMat2(UniformName name, const glm::mat2 &mat) const
         {
-                glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+                setMat2(uniform(name), mat);
         }
         // ------------------------------------------------------------------------
-        void setVec4(const std::string &name, const glm::vec4 &value) const
+        void setMat3(Uniform uniform, const glm::mat3 &mat) const
         {
-                glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+                if (changed(uniform, &mat[0][0], sizeof(mat)))
+                        glUniformMatrix3fv(location(uniform), 1, GL_FALSE, &mat[0][0]);
         }
-        void setVec4(const std::string &name, float x, float y, float z, float w)
+        void setMat3(UniformName name, const glm::mat3 &mat) const
         {
-                glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+                setMat3(uniform(name), mat);
         }
         // ------------------------------------------------------------------------
-        void setMat2(const std::string &name, const glm::mat2 &mat) const
+        void setMat4(Uniform uniform, const glm::mat4 &mat) const
+        {
+                if (changed(uniform, &mat[0][0], sizeof(mat)))
+                        glUniformMatrix4fv(location(uniform), 1, GL_FALSE, &mat[0][0]);
+        }
+        void setMat4(UniformName name, const glm::mat4 &mat) const
         {
-                glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE,
-                                   &mat[0][0]);
+                setMat4(uniform(name), mat);
         }
+
+        // uploads made and skipped (the value was there already) by the setters
+        // ------------------------------------------------------------------------
+        size_t uniformUploads() const { return uniforms->uploads; }
+        size_t uniformUploadsSkipped() const { return uniforms->skipped; }
+
+        // the samplers the program reads (the compiler drops the ones that don't
+        // contribute to the output), found through program introspection. The
+        // program has to be in use.
         // ------------------------------------------------------------------------
-        void setMat3(const std::string &name, const glm::mat3 &mat) const
+        std::vector<ActiveSampler> activeSamplers() const
         {
-                glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE,
-                                   &mat[0][0]);
+                std::vector<ActiveSampler> samplers;
+                GLint count = 0, maxLength = 0;
+                glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+                glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+                std::vector<char> name(maxLength > 0 ? maxLength : 1);
+                for (GLint i = 0; i < count; i++) {
+                        GLint size = 0;
+                        GLenum type = 0;
+                        GLsizei length = 0;
+                        glGetActiveUniform(ID, i, name.size(), &length, &size, &type,
+                                           name.data());
+                        if (!isSampler(type))
+                                continue;
+                        ActiveSampler sampler;
+                        sampler.name.assign(name.data(), length);
+                        sampler.unit = 0;
+                        glGetUniformiv(ID, glGetUniformLocation(ID, name.data()),
+                                       &sampler.unit);
+                        samplers.push_back(sampler);
+                }
+                return samplers;
         }
+
+        // the vertex attributes the program reads, bit i for location i (see
+        // ShaderManager::activeInputs). The program has to be built.
         // ------------------------------------------------------------------------
-        void setMat4(const std::string &name, const glm::mat4 &mat) const
+        unsigned int activeAttributes() const
         {
-                glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE,
-                                   &mat[0][0]);
+                return ShaderManager::instance().activeInputs(ID);
         }
 
       private:
-        // utility function for checking shader compilation/linking errors.
-        // ------------------------------------------------------------------------
-        void checkCompileErrors(GLuint shader, std::string type)
-        {
-                GLint success;
-                GLchar infoLog[1024];
-                if (type != "PROGRAM") {
-                        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-                        if (!success) {
-                                glGetShaderInfoLog(shader, 1024, NULL, infoLog);
-                                std::cout
-                                    << "ERROR::SHADER_COMPILATION_ERROR of type: " << type
-                                    << "\n"
-                                    << infoLog
-                                    << "\n -- "
-                                       "-------------------------------------------------"
-                                       "-- -- "
-                                    << std::endl;
-                        }
-                } else {
-                        glGetProgramiv(shader, GL_LINK_STATUS, &success);
-                        if (!success) {
-                                glGetProgramInfoLog(shader, 1024, NULL, infoLog);
-                                std::cout
-                                    << "ERROR::PROGRAM_LINKING_ERROR of type: " << type
-                                    << "\n"
-                                    << infoLog
-                                    << "\n -- "
-                                       "-------------------------------------------------"
-                                       "-- -- "
-                                    << std::endl;
-                        }
+        bool ready;
+        std::shared_ptr<UniformTable> uniforms;
+
+        // the uniform table, read the first time it is needed: by then the program
+        // has to be finished, as uniforms get their default values again when it
+        // is linked. Its shared uniform blocks are bound at the same time.
+        UniformTable &table() const
+        {
+                if (!uniforms->read) {
+                        ShaderManager::instance().finish(ID);
+                        bindUniformBlocks(ID);
+                        uniforms->load(ID);
+                }
+                return *uniforms;
+        }
+
+        GLint location(Uniform uniform) const { return uniforms->location(uniform); }
+
+        bool changed(Uniform uniform, const void *value, size_t size) const
+        {
+                return table().update(uniform, value, size);
+        }
+
+        static bool isSampler(GLenum type)
+        {
+                switch (type) {
+                case GL_SAMPLER_1D:
+                case GL_SAMPLER_2D:
+                case GL_SAMPLER_3D:
+                case GL_SAMPLER_CUBE:
+                case GL_SAMPLER_1D_SHADOW:
+                case GL_SAMPLER_2D_SHADOW:
+                case GL_SAMPLER_1D_ARRAY:
+                case GL_SAMPLER_2D_ARRAY:
+                case GL_SAMPLER_CUBE_SHADOW:
+                case GL_SAMPLER_2D_MULTISAMPLE:
+                case GL_SAMPLER_2D_RECT:
+                case GL_SAMPLER_BUFFER:
+                case GL_INT_SAMPLER_2D:
+                case GL_UNSIGNED_INT_SAMPLER_2D:
+                        return true;
+                default:
+                        return false;
+                }
+        }
+};
+
+// Variants of one shader program, each built with a different set of features
+// switched on. Feature i is bit i of a variant mask and, when set, is defined as
+// "#define <features[i]> 1" in the sources, so a switched off feature is compiled
+// out instead of branched over on the GPU. A variant is built the first time it is
+// asked for (or by prepare()) and kept from then on.
+class ShaderVariants
+{
+      public:
+        // setup runs once per variant, the first time it is used; for uniforms
+        // that never change, like the texture units of the samplers
+        ShaderVariants(const char *vertexPath, const char *fragmentPath,
+                       std::vector<std::string> features,
+                       std::function<void(Shader &)> setup = nullptr)
+            : vertexPath(vertexPath), fragmentPath(fragmentPath),
+              features(std::move(features)), setup(std::move(setup))
+        {
+        }
+
+        // starts building a variant, so it is ready by the time it is used
+        void prepare(unsigned int mask) { variant(mask); }
+
+        // starts building every variant
+        void prepareAll()
+        {
+                for (unsigned int mask = 0; mask < (1u << features.size()); mask++)
+                        prepare(mask);
+        }
+
+        // makes the given variant the current program and returns it
+        Shader &use(unsigned int mask)
+        {
+                Variant &found = variant(mask);
+                found.shader.use();
+                if (!found.initialized) {
+                        if (setup)
+                                setup(found.shader);
+                        found.initialized = true;
+                }
+                return found.shader;
+        }
+
+        std::string defines(unsigned int mask) const
+        {
+                std::vector<std::string> enabled;
+                for (size_t i = 0; i < features.size(); i++)
+                        if (mask & (1u << i))
+                                enabled.push_back(features[i]);
+                return ShaderSource::defines(enabled);
+        }
+
+      private:
+        struct Variant {
+                Shader shader;
+                bool initialized;
+        };
+
+        std::string vertexPath;
+        std::string fragmentPath;
+        std::vector<std::string> features;
+        std::function<void(Shader &)> setup;
+        std::unordered_map<unsigned int, Variant> variants;
+
+        Variant &variant(unsigned int mask)
+        {
+                mask &= (1u << features.size()) - 1;
+                auto it = variants.find(mask);
+                if (it == variants.end()) {
+                        Shader shader(vertexPath.c_str(), fragmentPath.c_str(), nullptr,
+                                      defines(mask));
+                        it = variants.emplace(mask, Variant{shader, false}).first;
                 }
+                return it->second;
         }
 };
 #endif
@@ -0,0 +1,713 @@
+#ifndef SHADER_MANAGER_H
+#define SHADER_MANAGER_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/program_cache.h>
+#include <learnopengl/resource_pack.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+#ifndef GL_SHADER_BINARY_FORMAT_SPIR_V_ARB
+#define GL_SHADER_BINARY_FORMAT_SPIR_V_ARB 0x9551
+#endif
+#ifndef GL_PROGRAM_INPUT
+#define GL_PROGRAM_INPUT 0x92E3
+#endif
+#ifndef GL_ACTIVE_RESOURCES
+#define GL_ACTIVE_RESOURCES 0x92F5
+#endif
+#ifndef GL_LOCATION
+#define GL_LOCATION 0x930E
+#endif
+
+// The source of one shader stage the way glShaderSource takes it: slices of the
+// mapped files, with the defines put in after #version and every #include "file"
+// line (relative to the including file) replaced by that file, once per file. Each
+// file is a source string number of its own, set with #line, so the driver messages
+// point into the right file. The offline shader compiler (tools/shader_compiler.cpp)
+// puts the sources together the same way.
+class ShaderSource
+{
+      public:
+        // the files the source was put together from, by source string number
+        std::vector<std::string> files;
+
+        // defines is cut down to the features the stage tests, so variants that
+        // only differ in features of other stages share the stage source, its
+        // cache key and its SPIR-V module
+        bool load(const std::string &path, const std::string &defines)
+        {
+                if (defines.empty())
+                        return expand(path, &defines);
+                ShaderSource plain;
+                if (!plain.load(path, ""))
+                        return false;
+                std::string used = select(defines, features(plain.text()));
+                return expand(path, &used);
+        }
+
+        uint64_t hash(uint64_t hash = 14695981039346656037ull) const
+        {
+                for (size_t i = 0; i < strings.size(); i++)
+                        hash = ProgramBinaryCache::hashSource(strings[i], lengths[i],
+                                                              hash);
+                return hash;
+        }
+
+        void upload(unsigned int shader) const
+        {
+                glShaderSource(shader, strings.size(), strings.data(), lengths.data());
+        }
+
+        // the whole source as one string
+        std::string text() const
+        {
+                std::string all;
+                for (size_t i = 0; i < strings.size(); i++)
+                        all.append(strings[i], lengths[i]);
+                return all;
+        }
+
+        // the defines of a set of features, in name order so that the same set
+        // always gives the same source
+        static std::string defines(std::vector<std::string> features)
+        {
+                std::sort(features.begin(), features.end());
+                std::string text;
+                for (const std::string &feature : features)
+                        text += "#define " + feature + " 1\n";
+                return text;
+        }
+
+        // the macros a source tests with #ifdef, #ifndef or defined() and doesn't
+        // define itself: the features its variants are built with
+        static std::vector<std::string> features(const std::string &text)
+        {
+                std::set<std::string> tested, defined;
+                std::istringstream lines(text);
+                std::string line;
+                while (std::getline(lines, line)) {
+                        std::istringstream words(line);
+                        std::string directive, name;
+                        words >> directive;
+                        if (directive == "#ifdef" || directive == "#ifndef") {
+                                words >> name;
+                                tested.insert(name);
+                        } else if (directive == "#define") {
+                                words >> name;
+                                defined.insert(name);
+                        } else if (directive == "#if" || directive == "#elif") {
+                                testedNames(line, tested);
+                        }
+                }
+                std::vector<std::string> names;
+                for (const std::string &name : tested)
+                        if (!defined.count(name) && name.compare(0, 3, "GL_") != 0 &&
+                            name.compare(0, 2, "__") != 0)
+                                names.push_back(name);
+                return names;
+        }
+
+      private:
+        static const size_t MAX_FILES = 32;
+
+        // the names tested with defined() on an #if line
+        static void testedNames(const std::string &line, std::set<std::string> &names)
+        {
+                for (size_t at = line.find("defined"); at != std::string::npos;
+                     at = line.find("defined", at + 1)) {
+                        size_t begin = line.find_first_not_of(" \t(", at + 7);
+                        size_t end = line.find_first_not_of(
+                            "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"
+                            "0123456789_",
+                            begin);
+                        if (begin != std::string::npos)
+                                names.insert(line.substr(begin, end - begin));
+                }
+        }
+
+        // the "#define NAME ..." lines of defines that define one of names
+        static std::string select(const std::string &defines,
+                                  const std::vector<std::string> &names)
+        {
+                std::istringstream lines(defines);
+                std::string line, selected;
+                while (std::getline(lines, line)) {
+                        std::istringstream words(line);
+                        std::string directive, name;
+                        words >> directive >> name;
+                        if (std::find(names.begin(), names.end(), name) != names.end())
+                                selected += line + "\n";
+                }
+                return selected;
+        }
+
+        std::vector<std::unique_ptr<FileView>> views;
+        // text that isn't in any file; a deque never moves its strings
+        std::deque<std::string> generated;
+        std::vector<const char *> strings;
+        std::vector<GLint> lengths;
+
+        // adds a file; defines is null for included files
+        bool expand(const std::string &path, const std::string *defines)
+        {
+                std::unique_ptr<FileView> view(new FileView(path));
+                if (files.size() >= MAX_FILES || !view->isOpen()) {
+                        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ "
+                                  << path << std::endl;
+                        return false;
+                }
+                const char *text = (const char *)view->data;
+                const char *end = text + view->size;
+                views.push_back(std::move(view));
+                std::string number = std::to_string(files.size());
+                files.push_back(path);
+
+                // the defines go after #version, which has to come first;
+                // included files start over at line 1
+                const char *copied = text;
+                int line = 1;
+                const char *version = defines ? findVersion(text, end, line) : nullptr;
+                if (version != nullptr) {
+                        append(text, version);
+                        copied = version;
+                        line++;
+                }
+                if (defines != nullptr)
+                        insert(*defines + "#line " + std::to_string(line) + " " +
+                               number + "\n");
+                else
+                        insert("#line 1 " + number + "\n");
+
+                bool ok = true;
+                for (const char *cursor = copied; cursor < end; line++) {
+                        const char *next = lineEnd(cursor, end);
+                        std::string name;
+                        if (includeName(cursor, next, name)) {
+                                append(copied, cursor);
+                                copied = next;
+                                std::string target = directory(path) + name;
+                                if (std::find(files.begin(), files.end(), target) ==
+                                    files.end())
+                                        ok = expand(target, nullptr) && ok;
+                                insert("#line " + std::to_string(line + 1) +
+                                       " " + number + "\n");
+                        }
+                        cursor = next;
+                }
+                append(copied, end);
+                return ok;
+        }
+
+        void append(const char *begin, const char *end)
+        {
+                if (begin == end)
+                        return;
+                strings.push_back(begin);
+                lengths.push_back(end - begin);
+        }
+
+        // a directive has to start on a line of its own, which the file before
+        // may not have ended
+        void insert(const std::string &text)
+        {
+                generated.push_back("\n" + text);
+                append(generated.back().data(),
+                       generated.back().data() + generated.back().size());
+        }
+
+        static const char *lineEnd(const char *cursor, const char *end)
+        {
+                cursor = std::find(cursor, end, '\n');
+                return cursor < end ? cursor + 1 : end;
+        }
+
+        static std::string directory(const std::string &path)
+        {
+                size_t slash = path.find_last_of('/');
+                return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+        }
+
+        // the directive on a line, without the '#'; the rest of the line after it
+        // goes to rest
+        static std::string directive(const char *cursor, const char *end,
+                                     const char *&rest)
+        {
+                while (cursor < end && (*cursor == ' ' || *cursor == '\t'))
+                        cursor++;
+                if (cursor == end || *cursor != '#')
+                        return "";
+                cursor++;
+                while (cursor < end && (*cursor == ' ' || *cursor == '\t'))
+                        cursor++;
+                const char *name = cursor;
+                while (cursor < end && isalpha((unsigned char)*cursor))
+                        cursor++;
+                rest = cursor;
+                return std::string(name, cursor);
+        }
+
+        // end of the #version line and its line number, null if there is none
+        static const char *findVersion(const char *cursor, const char *end,
+                                       int &line)
+        {
+                for (int l = 1; cursor < end; l++) {
+                        const char *rest, *next = lineEnd(cursor, end);
+                        if (directive(cursor, next, rest) == "version") {
+                                line = l;
+                                return next;
+                        }
+                        cursor = next;
+                }
+                return nullptr;
+        }
+
+        static bool includeName(const char *cursor, const char *end,
+                                std::string &name)
+        {
+                const char *rest;
+                if (directive(cursor, end, rest) != "include")
+                        return false;
+                const char *open = std::find(rest, end, '"');
+                const char *close = open < end ? std::find(open + 1, end, '"')
+                                               : end;
+                if (close == end)
+                        return false;
+                name.assign(open + 1, close);
+                return true;
+        }
+};
+
+// Compiles and links shader programs without waiting for the driver. submit()
+// hands the sources to GL and queues the link, but asks nothing back, so the driver
+// can work on every program at once (on its own threads where
+// KHR_parallel_shader_compile is there) while the caller goes on. The compile and
+// link status of a program is checked only by finish(), when the program is first
+// used; errors are reported with the file, line and source text they point at.
+// Sources may #include other files, and a program can be built with extra #defines,
+// which is how the variants of ShaderVariants (shader.h) are made.
+//
+// Where the driver takes SPIR-V (GL 4.6 or ARB_gl_spirv) and the build compiled
+// every stage of a program offline (tools/shader_compiler.cpp), the optimized
+// modules under resources/shaders/spirv/ are used instead of the GLSL. A module is
+// named after the hash of the source it was compiled from, so an edited shader
+// without a fresh module is compiled from GLSL as before. A driver that fails a
+// module, or keeps no uniform names for it, gets the GLSL too. Used from the
+// thread that owns the main context only.
+class ShaderManager
+{
+      public:
+        static ShaderManager &instance()
+        {
+                static ShaderManager manager;
+                return manager;
+        }
+
+        ShaderManager(const ShaderManager &) = delete;
+        ShaderManager &operator=(const ShaderManager &) = delete;
+
+        // lets the driver compile on as many threads as it likes, and sets up the
+        // program binary cache, SPIR-V and the program interface query. loader is
+        // the one glad was given.
+        void init(GLADloadproc loader)
+        {
+                ProgramBinaryCache::instance().init(loader);
+                typedef void(APIENTRYP MaxShaderCompilerThreads)(GLuint);
+                MaxShaderCompilerThreads maxThreads = nullptr;
+                if (ProgramBinaryCache::hasExtension("GL_KHR_parallel_shader_compile"))
+                        maxThreads = (MaxShaderCompilerThreads)loader(
+                            "glMaxShaderCompilerThreadsKHR");
+                else if (ProgramBinaryCache::hasExtension(
+                             "GL_ARB_parallel_shader_compile"))
+                        maxThreads = (MaxShaderCompilerThreads)loader(
+                            "glMaxShaderCompilerThreadsARB");
+                if (maxThreads) {
+                        // 0xFFFFFFFF leaves the number of threads to the driver
+                        maxThreads(0xFFFFFFFFu);
+                        parallel = true;
+                }
+
+                GLint major = 0, minor = 0;
+                glGetIntegerv(GL_MAJOR_VERSION, &major);
+                glGetIntegerv(GL_MINOR_VERSION, &minor);
+                shaderBinary = (ShaderBinary)loader("glShaderBinary");
+                if (major > 4 || (major == 4 && minor >= 6))
+                        specializeShader = (SpecializeShader)loader("glSpecializeShader");
+                else if (ProgramBinaryCache::hasExtension("GL_ARB_gl_spirv"))
+                        specializeShader =
+                            (SpecializeShader)loader("glSpecializeShaderARB");
+                spirv = shaderBinary && specializeShader;
+
+                if (major > 4 || (major == 4 && minor >= 3) ||
+                    ProgramBinaryCache::hasExtension("GL_ARB_program_interface_query")) {
+                        getProgramInterfaceiv =
+                            (GetProgramInterfaceiv)loader("glGetProgramInterfaceiv");
+                        getProgramResourceiv =
+                            (GetProgramResourceiv)loader("glGetProgramResourceiv");
+                }
+        }
+
+        bool isParallel() const { return parallel; }
+        bool isSpirvEnabled() const { return spirv; }
+
+        // the locations of the active vertex inputs of a linked program, bit i for
+        // location i. Read through the program interface query when the driver
+        // has it, which doesn't need the names of the inputs (SPIR-V programs may
+        // come without them), through the input names otherwise.
+        unsigned int activeInputs(unsigned int program) const
+        {
+                unsigned int mask = 0;
+                if (getProgramInterfaceiv && getProgramResourceiv) {
+                        GLint count = 0;
+                        getProgramInterfaceiv(program, GL_PROGRAM_INPUT,
+                                              GL_ACTIVE_RESOURCES, &count);
+                        const GLenum property = GL_LOCATION;
+                        for (GLint i = 0; i < count; i++) {
+                                GLint location = -1;
+                                getProgramResourceiv(program, GL_PROGRAM_INPUT, i, 1,
+                                                     &property, 1, nullptr, &location);
+                                // built-in inputs have no location
+                                if (location >= 0 && location < 32)
+                                        mask |= 1u << location;
+                        }
+                        return mask;
+                }
+                GLint count = 0, maxLength = 0;
+                glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+                glGetProgramiv(program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+                std::vector<char> name(maxLength > 0 ? maxLength : 1);
+                for (GLint i = 0; i < count; i++) {
+                        GLint size = 0;
+                        GLenum type = 0;
+                        glGetActiveAttrib(program, i, name.size(), nullptr, &size, &type,
+                                          name.data());
+                        GLint location = glGetAttribLocation(program, name.data());
+                        if (location >= 0 && location < 32)
+                                mask |= 1u << location;
+                }
+                return mask;
+        }
+
+        // where the offline compiled module of a stage source is looked for
+        static std::string spirvPath(uint64_t sourceHash)
+        {
+                char name[32];
+                snprintf(name, sizeof(name), "%016llx.spv",
+                         (unsigned long long)sourceHash);
+                return "resources/shaders/spirv/" + std::string(name);
+        }
+
+        // starts building a program from its source files, returns the program.
+        // defines is put into every stage right after its #version line, e.g.
+        // "#define BLINN 1\n"; programs differing in it are cached apart.
+        unsigned int submit(const char *vertexPath, const char *fragmentPath,
+                            const char *geometryPath = nullptr,
+                            const std::string &defines = "")
+        {
+                Pending build;
+                build.stages.push_back(Stage{GL_VERTEX_SHADER, vertexPath, 0, {}});
+                build.stages.push_back(Stage{GL_FRAGMENT_SHADER, fragmentPath, 0, {}});
+                if (geometryPath != nullptr)
+                        build.stages.push_back(
+                            Stage{GL_GEOMETRY_SHADER, geometryPath, 0, {}});
+                build.defines = defines;
+
+                // map the sources, out of the resource pack when they are packed,
+                // and put them together without copying them. A program is built
+                // from SPIR-V only when every stage has its module.
+                std::vector<ShaderSource> sources(build.stages.size());
+                std::vector<FileView> modules(build.stages.size());
+                build.key = 14695981039346656037ull;
+                build.spirv = spirv;
+                for (size_t i = 0; i < build.stages.size(); i++) {
+                        sources[i].load(build.stages[i].path, defines);
+                        build.stages[i].files = sources[i].files;
+                        build.key = sources[i].hash(build.key);
+                        if (build.spirv)
+                                build.spirv =
+                                    modules[i].open(spirvPath(sources[i].hash()));
+                }
+                if (build.spirv)
+                        for (const FileView &module : modules)
+                                build.key =
+                                    hashBytes(module.data, module.size, build.key);
+
+                // a program linked by an earlier run is loaded as it is
+                unsigned int program = ProgramBinaryCache::instance().load(build.key);
+                if (program != 0)
+                        return program;
+
+                program = glCreateProgram();
+                for (size_t i = 0; i < build.stages.size(); i++) {
+                        Stage &stage = build.stages[i];
+                        stage.shader = glCreateShader(stage.type);
+                        if (build.spirv) {
+                                shaderBinary(1, &stage.shader,
+                                             GL_SHADER_BINARY_FORMAT_SPIR_V_ARB,
+                                             modules[i].data, (GLsizei)modules[i].size);
+                                specializeShader(stage.shader, "main", 0, nullptr,
+                                                 nullptr);
+                        } else {
+                                sources[i].upload(stage.shader);
+                                glCompileShader(stage.shader);
+                        }
+                        glAttachShader(program, stage.shader);
+                }
+                ProgramBinaryCache::instance().prepare(program);
+                glLinkProgram(program);
+                pending[program] = build;
+                return program;
+        }
+
+        // whether finish() would return without waiting for the driver. Without
+        // the parallel compile extension there is no way to ask, so it says yes.
+        bool isReady(unsigned int program) const
+        {
+                if (!parallel || pending.find(program) == pending.end())
+                        return true;
+                GLint done = GL_FALSE;
+                glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &done);
+                return done == GL_TRUE;
+        }
+
+        // waits for a submitted program, reports its errors and caches its binary.
+        // Returns whether it linked; only the first call for a program does work.
+        bool finish(unsigned int program)
+        {
+                auto it = pending.find(program);
+                if (it == pending.end())
+                        return true;
+                Pending build = it->second;
+                pending.erase(it);
+
+                // the GLSL is there to fall back to; it is compiled into the same
+                // program object, which the caller already holds
+                if (build.spirv && !spirvUsable(program, build))
+                        compileSource(program, build);
+
+                for (const Stage &stage : build.stages) {
+                        GLint compiled = GL_FALSE;
+                        glGetShaderiv(stage.shader, GL_COMPILE_STATUS, &compiled);
+                        if (!compiled) {
+                                std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: "
+                                          << stageName(stage.type) << "\n";
+                                reportLog(shaderLog(stage.shader), &stage.files);
+                        }
+                }
+                GLint linked = GL_FALSE;
+                glGetProgramiv(program, GL_LINK_STATUS, &linked);
+                if (!linked) {
+                        std::cout << "ERROR::PROGRAM_LINKING_ERROR of";
+                        for (const Stage &stage : build.stages)
+                                std::cout << " " << stage.path;
+                        std::cout << "\n";
+                        // a link log doesn't say which stage a line is in
+                        reportLog(programLog(program), nullptr);
+                } else {
+                        ProgramBinaryCache::instance().store(build.key, program);
+                }
+                // the shaders are linked into the program now and no longer needed
+                for (const Stage &stage : build.stages) {
+                        glDetachShader(program, stage.shader);
+                        glDeleteShader(stage.shader);
+                }
+                return linked == GL_TRUE;
+        }
+
+        // prints a compiler log, each message with the file and line it is about
+        // and the source text of that line. files are the files of the source, by
+        // source string number; null when the log isn't about a single source.
+        static void reportLog(const std::string &log,
+                              const std::vector<std::string> *files)
+        {
+                std::istringstream lines(log);
+                std::string message;
+                while (std::getline(lines, message)) {
+                        if (message.empty())
+                                continue;
+                        int number = 0, line = 0;
+                        if (files && messageLine(message, number, line) && number >= 0 &&
+                            (size_t)number < files->size()) {
+                                const std::string &path = (*files)[number];
+                                std::cout << path << ":" << line << ": " << message
+                                          << "\n    " << sourceLine(path, line) << "\n";
+                        } else {
+                                std::cout << message << "\n";
+                        }
+                }
+                std::cout << " -- --------------------------------------------------- -- "
+                          << std::endl;
+        }
+
+      private:
+        typedef void(APIENTRYP ShaderBinary)(GLsizei, const GLuint *, GLenum,
+                                             const void *, GLsizei);
+        typedef void(APIENTRYP SpecializeShader)(GLuint, const GLchar *, GLuint,
+                                                 const GLuint *, const GLuint *);
+        typedef void(APIENTRYP GetProgramInterfaceiv)(GLuint, GLenum, GLenum, GLint *);
+        typedef void(APIENTRYP GetProgramResourceiv)(GLuint, GLenum, GLuint, GLsizei,
+                                                     const GLenum *, GLsizei, GLsizei *,
+                                                     GLint *);
+
+        struct Stage {
+                GLenum type;
+                std::string path;
+                unsigned int shader;
+                // the files the source was put together from, by source string
+                // number
+                std::vector<std::string> files;
+        };
+
+        struct Pending {
+                std::vector<Stage> stages;
+                std::string defines;
+                uint64_t key;
+                // built from the offline compiled SPIR-V modules
+                bool spirv;
+        };
+
+        bool parallel = false;
+        bool spirv = false;
+        ShaderBinary shaderBinary = nullptr;
+        SpecializeShader specializeShader = nullptr;
+        GetProgramInterfaceiv getProgramInterfaceiv = nullptr;
+        GetProgramResourceiv getProgramResourceiv = nullptr;
+        std::unordered_map<unsigned int, Pending> pending;
+
+        ShaderManager() {}
+
+        // whether a program built from SPIR-V linked and can be used by uniform
+        // name. Names are optional for SPIR-V in GL and some drivers drop them;
+        // then every later program is built from GLSL right away.
+        bool spirvUsable(unsigned int program, const Pending &build)
+        {
+                GLint status = GL_FALSE;
+                for (const Stage &stage : build.stages) {
+                        glGetShaderiv(stage.shader, GL_COMPILE_STATUS, &status);
+                        if (!status)
+                                return false;
+                }
+                glGetProgramiv(program, GL_LINK_STATUS, &status);
+                if (!status)
+                        return false;
+                GLint uniforms = 0;
+                glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniforms);
+                if (uniforms == 0)
+                        return true;
+                char name[256];
+                GLsizei length = 0;
+                GLint size;
+                GLenum type;
+                glGetActiveUniform(program, 0, sizeof(name), &length, &size, &type, name);
+                if (length > 0)
+                        return true;
+                std::cout << "SHADER::SPIRV:: the driver keeps no uniform names, "
+                             "using GLSL" << std::endl;
+                spirv = false;
+                return false;
+        }
+
+        // replaces the shaders of a program with ones compiled from GLSL and
+        // links it again
+        void compileSource(unsigned int program, Pending &build)
+        {
+                for (Stage &stage : build.stages) {
+                        glDetachShader(program, stage.shader);
+                        glDeleteShader(stage.shader);
+                        ShaderSource source;
+                        source.load(stage.path, build.defines);
+                        stage.shader = glCreateShader(stage.type);
+                        source.upload(stage.shader);
+                        glCompileShader(stage.shader);
+                        glAttachShader(program, stage.shader);
+                }
+                glLinkProgram(program);
+                build.spirv = false;
+        }
+
+        static const char *stageName(GLenum type)
+        {
+                switch (type) {
+                case GL_VERTEX_SHADER:
+                        return "VERTEX";
+                case GL_FRAGMENT_SHADER:
+                        return "FRAGMENT";
+                default:
+                        return "GEOMETRY";
+                }
+        }
+
+        static std::string shaderLog(unsigned int shader)
+        {
+                GLint length = 0;
+                glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+                std::string log(length > 0 ? length : 0, '\0');
+                if (length > 0)
+                        glGetShaderInfoLog(shader, length, nullptr, &log[0]);
+                return log.c_str();
+        }
+
+        static std::string programLog(unsigned int program)
+        {
+                GLint length = 0;
+                glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+                std::string log(length > 0 ? length : 0, '\0');
+                if (length > 0)
+                        glGetProgramInfoLog(program, length, nullptr, &log[0]);
+                return log.c_str();
+        }
+
+        // Source string and line number a driver message points at, false if
+        // none. The drivers write the location as "<string>:<line>" (Mesa, AMD,
+        // Intel) or "<string>(<line>)" (NVIDIA), before anything else like it.
+        static bool messageLine(const std::string &message, int &number, int &line)
+        {
+                for (size_t i = 0; i < message.size(); i++) {
+                        if (!isdigit(message[i]) || (i > 0 && isalnum(message[i - 1])))
+                                continue;
+                        size_t separator = i;
+                        while (separator < message.size() && isdigit(message[separator]))
+                                separator++;
+                        if (separator + 1 < message.size() &&
+                            (message[separator] == ':' || message[separator] == '(') &&
+                            isdigit(message[separator + 1])) {
+                                number = atoi(message.c_str() + i);
+                                line = atoi(message.c_str() + separator + 1);
+                                return true;
+                        }
+                        i = separator;
+                }
+                return false;
+        }
+
+        static std::string sourceLine(const std::string &path, int line)
+        {
+                FileView file(path);
+                const char *cursor = (const char *)file.data;
+                const char *end = cursor + file.size;
+                for (int l = 1; cursor < end && l < line; cursor++)
+                        if (*cursor == '\n')
+                                l++;
+                const char *start = cursor;
+                while (cursor < end && *cursor != '\n' && *cursor != '\r')
+                        cursor++;
+                return std::string(start, cursor);
+        }
+};
+
+#endif
@@ -0,0 +1,207 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/image_decoder.h>
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// how a decoded image is turned into a GL texture
+struct TextureFormat {
+        // color data is stored as sRGB and linearized by the sampler
+        bool srgb = false;
+        // images with an alpha channel are clamped instead of repeated, so that
+        // interpolation doesn't take texels from the next repeat (semi-transparent
+        // borders)
+        bool clampAlpha = false;
+        bool mipmaps = true;
+        // block compress the texture (with a precomputed mip chain cached as .ktx)
+        // in the format suited to what the map holds, when the driver supports it
+        bool compress = false;
+        TextureMap map = TextureMap::Color;
+};
+
+inline CompressionRequest compressionRequest(const TextureFormat &fmt)
+{
+        CompressionRequest request;
+        request.enabled = fmt.compress;
+        request.map = fmt.map;
+        request.srgb = fmt.srgb;
+        request.mipmaps = fmt.mipmaps;
+        return request;
+}
+
+inline GLenum pixelFormat(int channels)
+{
+        if (channels == 1)
+                return GL_RED;
+        if (channels == 4)
+                return GL_RGBA;
+        return GL_RGB;
+}
+
+inline GLenum internalFormat(int channels, bool srgb)
+{
+        if (srgb && channels == 3)
+                return GL_SRGB;
+        if (srgb && channels == 4)
+                return GL_SRGB_ALPHA;
+        return pixelFormat(channels);
+}
+
+// copies the pixels of the images into one new pixel unpack buffer and leaves it
+// bound, so the following texture uploads read from the buffer instead of client
+// memory. offsets receives, per image, the byte offset to pass as the pixels
+// pointer. The caller unbinds and deletes the returned buffer after the uploads.
+inline unsigned int stagePixels(const std::vector<const DecodedImage *> &images,
+                                std::vector<const void *> &offsets)
+{
+        size_t size = 0;
+        offsets.clear();
+        for (const DecodedImage *image : images) {
+                offsets.push_back(reinterpret_cast<const void *>(size));
+                size += image->pixelBytes();
+        }
+
+        unsigned int pbo;
+        glGenBuffers(1, &pbo);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        if (size == 0)
+                return pbo;
+        unsigned char *mapped = static_cast<unsigned char *>(glMapBufferRange(
+            GL_PIXEL_UNPACK_BUFFER, 0, size,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+        for (size_t i = 0; i < images.size(); i++) {
+                const DecodedImage *image = images[i];
+                size_t offset = reinterpret_cast<size_t>(offsets[i]);
+                size_t bytes = image->pixelBytes();
+                if (bytes == 0)
+                        continue;
+                if (mapped)
+                        memcpy(mapped + offset, image->pixels(), bytes);
+                else
+                        glBufferSubData(GL_PIXEL_UNPACK_BUFFER, offset, bytes,
+                                        image->pixels());
+        }
+        if (mapped)
+                glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        return pbo;
+}
+
+inline void releasePixels(unsigned int pbo)
+{
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &pbo);
+}
+
+// uploads the first levels of a compressed mip chain. pixels is image.bytes() or
+// the offset of the chain in the bound pixel unpack buffer.
+inline void uploadCompressed(GLenum target, const CompressedImage &image,
+                             const void *pixels, size_t levels)
+{
+        GLenum format = compressedInternalFormat(image.format, image.srgb);
+        for (size_t l = 0; l < levels && l < image.levels.size(); l++) {
+                const CompressedLevel &level = image.levels[l];
+                const void *data = reinterpret_cast<const void *>(
+                    reinterpret_cast<size_t>(pixels) + level.offset);
+                glCompressedTexImage2D(target, l, format, level.width, level.height, 0,
+                                       level.size, data);
+        }
+}
+
+// single channel maps are sampled as grey, so shaders reading .rgb see the same
+// thing as with an uncompressed texture. BC5 normal maps hold x and y only: their
+// .b is 0, and shaders rebuild z with NormalFromMap (lighting.glsl), which gives the
+// same normal for uncompressed maps.
+inline void setCompressedSwizzle(GLenum target, BlockFormat format)
+{
+        if (format == BlockFormat::BC4) {
+                glTexParameteri(target, GL_TEXTURE_SWIZZLE_G, GL_RED);
+                glTexParameteri(target, GL_TEXTURE_SWIZZLE_B, GL_RED);
+        }
+}
+
+// creates a 2D texture from a decoded image. pixels is image.pixels(), or the
+// offset of the image when it has been staged in a bound pixel unpack buffer.
+// Callable on any thread with a context of the share group; GLState caches the
+// bind only on the main one.
+inline unsigned int createTexture2D(const DecodedImage &image, const TextureFormat &fmt,
+                                    const void *pixels)
+{
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+
+        if (image.loaded()) {
+                GLenum format = pixelFormat(image.channels);
+                bool mipmaps = fmt.mipmaps;
+                GLState::instance().bindTexture(GL_TEXTURE_2D, textureID);
+                if (image.isCompressed()) {
+                        // the mip chain comes precomputed
+                        uploadCompressed(GL_TEXTURE_2D, image.compressed, pixels,
+                                         image.compressed.levels.size());
+                        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+                                        image.compressed.levels.size() - 1);
+                        setCompressedSwizzle(GL_TEXTURE_2D, image.compressed.format);
+                        mipmaps = image.compressed.levels.size() > 1;
+                } else {
+                        GLenum internal = internalFormat(image.channels, fmt.srgb);
+                        glTexImage2D(GL_TEXTURE_2D, 0, internal, image.width,
+                                     image.height, 0, format, GL_UNSIGNED_BYTE, pixels);
+                        if (mipmaps)
+                                glGenerateMipmap(GL_TEXTURE_2D);
+                }
+
+                GLenum wrap =
+                    fmt.clampAlpha && format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                                mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        } else {
+                std::cout << "Texture failed to load at path: " << image.path << std::endl;
+        }
+
+        return textureID;
+}
+
+// creates a cubemap from six decoded faces (+X, -X, +Y, -Y, +Z, -Z). pixels[i] is
+// faces[i]->data or an offset into the bound pixel unpack buffer.
+inline unsigned int createCubemap(const std::vector<const DecodedImage *> &faces,
+                                  const TextureFormat &fmt,
+                                  const std::vector<const void *> &pixels)
+{
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        GLState::instance().bindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+
+        for (unsigned int i = 0; i < faces.size(); i++) {
+                const DecodedImage &face = *faces[i];
+                if (face.isCompressed()) {
+                        // only the first level, cubemaps aren't mipmapped
+                        uploadCompressed(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
+                                         face.compressed, pixels[i], 1);
+                } else if (face.data) {
+                        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0,
+                                     fmt.srgb ? GL_SRGB : GL_RGB, face.width, face.height,
+                                     0, GL_RGB, GL_UNSIGNED_BYTE, pixels[i]);
+                } else {
+                        std::cout << "Cubemap texture failed to load at path: "
+                                  << face.path << std::endl;
+                }
+        }
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+        return textureID;
+}
+
+#endif
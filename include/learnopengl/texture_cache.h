@@ -0,0 +1,186 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/resource_pack.h>
+#include <learnopengl/texture.h>
+
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// identifies a GL texture by what is in it: the hash of the source file(s) plus
+// everything that changes the uploaded texels or how they are sampled
+struct TextureKey {
+        uint64_t content;
+        uint32_t params;
+
+        bool operator==(const TextureKey &other) const
+        {
+                return content == other.content && params == other.params;
+        }
+};
+
+struct TextureKeyHash {
+        size_t operator()(const TextureKey &key) const
+        {
+                return key.content ^ ((uint64_t)key.params * 0x9e3779b97f4a7c15ull);
+        }
+};
+
+// Process-wide cache of GL textures, shared by every model and by the streamer.
+// Two requests for byte-identical images with the same format share a single GL
+// texture, whatever the file is called. Textures are reference counted and deleted
+// when the last user releases them. All methods are thread safe; the GL calls in
+// insert() and release() need a current context of the share group.
+class TextureCache
+{
+      public:
+        static TextureCache &instance()
+        {
+                static TextureCache cache;
+                return cache;
+        }
+
+        TextureCache(const TextureCache &) = delete;
+        TextureCache &operator=(const TextureCache &) = delete;
+
+        // builds the key of a texture made of the given files, at the size cap of
+        // the quality tier. The content part is 0 (and the texture uncacheable) when
+        // a file can't be read.
+        static TextureKey makeKey(const std::vector<std::string> &paths,
+                                  const TextureFormat &format, bool flip, bool cubemap)
+        {
+                TextureKey key;
+                key.content = 14695981039346656037ull;
+                for (const std::string &path : paths) {
+                        FileView file;
+                        if (!file.open(path)) {
+                                key.content = 0;
+                                break;
+                        }
+                        key.content = hashBytes(file.data, file.size, key.content);
+                }
+                key.params = (format.srgb ? 1u : 0u) | (format.clampAlpha ? 2u : 0u) |
+                             (format.mipmaps ? 4u : 0u) | (flip ? 8u : 0u) |
+                             (cubemap ? 16u : 0u) | (format.compress ? 32u : 0u) |
+                             (uint32_t)format.map << 6 |
+                             (uint32_t)TextureQuality::instance().maxSize() << 10;
+                return key;
+        }
+
+        static bool cacheable(const TextureKey &key) { return key.content != 0; }
+
+        // true if a texture with this key is already resident
+        bool contains(const TextureKey &key)
+        {
+                std::lock_guard<std::mutex> lock(mutex);
+                return cacheable(key) && entries.count(key) != 0;
+        }
+
+        // returns the resident texture for the key with one more reference, or 0
+        unsigned int acquire(const TextureKey &key)
+        {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto it = cacheable(key) ? entries.find(key) : entries.end();
+                if (it == entries.end())
+                        return 0;
+                it->second.refs++;
+                hits++;
+                savedBytes += it->second.bytes;
+                return it->second.id;
+        }
+
+        // registers a freshly created texture and returns the name to use. If another
+        // thread registered the same content in the meantime, the new texture is
+        // deleted and the resident one is returned instead.
+        unsigned int insert(const TextureKey &key, unsigned int id, size_t bytes)
+        {
+                if (!cacheable(key))
+                        return id;
+                std::lock_guard<std::mutex> lock(mutex);
+                auto it = entries.find(key);
+                if (it != entries.end()) {
+                        glDeleteTextures(1, &id);
+                        GLState::instance().textureDeleted(id);
+                        it->second.refs++;
+                        hits++;
+                        savedBytes += it->second.bytes;
+                        return it->second.id;
+                }
+                Entry entry;
+                entry.id = id;
+                entry.refs = 1;
+                entry.bytes = bytes;
+                entries[key] = entry;
+                keys[id] = key;
+                residentBytes += bytes;
+                return id;
+        }
+
+        // drops one reference, deleting the texture with the last one. Names that
+        // the cache doesn't know about (e.g. placeholders) are left alone.
+        void release(unsigned int id)
+        {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto key = keys.find(id);
+                if (key == keys.end())
+                        return;
+                auto it = entries.find(key->second);
+                if (--it->second.refs > 0)
+                        return;
+                residentBytes -= it->second.bytes;
+                glDeleteTextures(1, &id);
+                GLState::instance().textureDeleted(id);
+                entries.erase(it);
+                keys.erase(key);
+        }
+
+        // video memory taken by the level 0 and (optionally) the mip chain of an image.
+        // A compressed image brings its chain along; without mipmaps only its first
+        // level is uploaded (cubemaps, see createCubemap).
+        static size_t textureBytes(const DecodedImage &image, bool mipmaps,
+                                   int layers = 1)
+        {
+                if (image.isCompressed())
+                        return (mipmaps ? image.compressed.byteCount()
+                                        : image.compressed.levels[0].size) *
+                               layers;
+                size_t bytes =
+                    (size_t)image.width * image.height * image.channels * layers;
+                return mipmaps ? bytes * 4 / 3 : bytes;
+        }
+
+        void report(std::ostream &out)
+        {
+                std::lock_guard<std::mutex> lock(mutex);
+                out << "TEXTURE::CACHE " << entries.size() << " textures, " << std::fixed
+                    << std::setprecision(2) << residentBytes / 1048576.0
+                    << " MB resident, " << hits << " shared, " << savedBytes / 1048576.0
+                    << " MB saved by sharing" << std::endl;
+        }
+
+      private:
+        struct Entry {
+                unsigned int id;
+                unsigned int refs;
+                size_t bytes;
+        };
+
+        TextureCache() : hits(0), residentBytes(0), savedBytes(0) {}
+
+        std::mutex mutex;
+        std::unordered_map<TextureKey, Entry, TextureKeyHash> entries;
+        std::unordered_map<unsigned int, TextureKey> keys;
+        size_t hits;
+        size_t residentBytes;
+        size_t savedBytes;
+};
+
+#endif
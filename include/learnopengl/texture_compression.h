@@ -0,0 +1,972 @@
+#ifndef TEXTURE_COMPRESSION_H
+#define TEXTURE_COMPRESSION_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/resource_pack.h>
+#include <learnopengl/parallel.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TEXTURE_COMPRESSION_SSE2 1
+#endif
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// The core 3.3 loader doesn't know the S3TC and BPTC formats. Both are exposed by
+// practically every desktop driver and are checked for at run time.
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+#define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+#endif
+
+// what a texture holds, which decides the block format it is compressed to
+enum class TextureMap { Color, Normal, Specular };
+
+enum class BlockFormat {
+        None,
+        BC1, // opaque color, 4 bpp
+        BC3, // color with alpha (BC1 color + BC4 alpha), 8 bpp
+        BC4, // single channel (grey specular maps, sampled as grey), 4 bpp
+        BC5, // two channels (tangent space normal maps, x and y), 8 bpp
+        BC7  // color with alpha, higher quality than BC3 (mode 6 only), 8 bpp
+};
+
+// asks the decoder to block compress an image right after decoding it
+struct CompressionRequest {
+        bool enabled = false;
+        TextureMap map = TextureMap::Color;
+        bool srgb = false;
+        bool mipmaps = true;
+};
+
+// one level of a compressed mip chain, as a slice of CompressedImage::bytes()
+struct CompressedLevel {
+        int width;
+        int height;
+        size_t offset;
+        size_t size;
+};
+
+struct CompressedImage {
+        BlockFormat format = BlockFormat::None;
+        bool srgb = false;
+        std::vector<CompressedLevel> levels;
+        std::vector<unsigned char> data;
+        // set instead of data when the chain is read in place from the resource pack
+        const unsigned char *external = nullptr;
+        size_t externalSize = 0;
+
+        const unsigned char *bytes() const { return external ? external : data.data(); }
+        size_t byteCount() const { return external ? externalSize : data.size(); }
+};
+
+inline const char *blockFormatName(BlockFormat format)
+{
+        static const char *names[] = {"raw", "BC1", "BC3", "BC4", "BC5", "BC7"};
+        return names[(int)format];
+}
+
+// channels the sampler sees for a block format
+inline int blockChannels(BlockFormat format)
+{
+        switch (format) {
+        case BlockFormat::BC1:
+                return 3;
+        case BlockFormat::BC4:
+                return 1;
+        case BlockFormat::BC5:
+                return 2;
+        default:
+                return 4;
+        }
+}
+
+inline size_t blockBytes(BlockFormat format)
+{
+        return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+}
+
+inline GLenum compressedInternalFormat(BlockFormat format, bool srgb)
+{
+        switch (format) {
+        case BlockFormat::BC1:
+                return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+                            : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case BlockFormat::BC3:
+                return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+                            : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case BlockFormat::BC4:
+                return GL_COMPRESSED_RED_RGTC1;
+        case BlockFormat::BC5:
+                return GL_COMPRESSED_RG_RGTC2;
+        case BlockFormat::BC7:
+                return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+                            : GL_COMPRESSED_RGBA_BPTC_UNORM;
+        default:
+                return 0;
+        }
+}
+
+// Which block formats the driver accepts. detect() must be called once on the main
+// thread with a current context before anything is loaded; until then nothing is
+// compressed and textures are uploaded as before.
+class BlockCompression
+{
+      public:
+        static void detect()
+        {
+                GLint count = 0;
+                glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+                for (GLint i = 0; i < count; i++) {
+                        const char *name = (const char *)glGetStringi(GL_EXTENSIONS, i);
+                        if (!name)
+                                continue;
+                        if (strcmp(name, "GL_EXT_texture_compression_s3tc") == 0)
+                                flags() |= 1u << (int)BlockFormat::BC1 |
+                                           1u << (int)BlockFormat::BC3;
+                        if (strcmp(name, "GL_ARB_texture_compression_bptc") == 0)
+                                flags() |= 1u << (int)BlockFormat::BC7;
+                }
+                // RGTC is core since 3.0
+                flags() |= 1u << (int)BlockFormat::BC4 | 1u << (int)BlockFormat::BC5;
+        }
+
+        // marks a format as usable without asking the driver, for the asset cooker
+        // that compresses images without a GL context
+        static void assume(BlockFormat format) { flags() |= 1u << (int)format; }
+
+        static bool supported(BlockFormat format)
+        {
+                return format != BlockFormat::None && (flags() & 1u << (int)format) != 0;
+        }
+
+        // block format for a map with the given content, None if it stays raw. A
+        // specular map goes to BC4 only when it is grey; a coloured one is
+        // compressed like any color map.
+        static BlockFormat choose(TextureMap map, bool hasAlpha, bool grey)
+        {
+                BlockFormat format;
+                if (map == TextureMap::Normal)
+                        format = BlockFormat::BC5;
+                else if (map == TextureMap::Specular && grey && !hasAlpha)
+                        format = BlockFormat::BC4;
+                else if (!hasAlpha)
+                        format = BlockFormat::BC1;
+                else
+                        format = supported(BlockFormat::BC7) ? BlockFormat::BC7
+                                                             : BlockFormat::BC3;
+                return supported(format) ? format : BlockFormat::None;
+        }
+
+      private:
+        static unsigned int &flags()
+        {
+                static unsigned int supportedFormats = 0;
+                return supportedFormats;
+        }
+};
+
+namespace bc {
+
+// picks, for each of the 16 RGBA pixels of a block, the palette entry at the
+// smallest squared distance (first one on ties)
+inline void nearestIndices(const unsigned char *pixels, const unsigned char *palette,
+                           int count, unsigned char *indices)
+{
+#ifdef TEXTURE_COMPRESSION_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        for (int p = 0; p < 16; p += 4) {
+                __m128i quad = _mm_loadu_si128((const __m128i *)(pixels + p * 4));
+                __m128i lo = _mm_unpacklo_epi8(quad, zero);
+                __m128i hi = _mm_unpackhi_epi8(quad, zero);
+                __m128i best = _mm_set1_epi32(INT_MAX);
+                __m128i bestIndex = zero;
+                for (int c = 0; c < count; c++) {
+                        int color;
+                        memcpy(&color, palette + c * 4, 4);
+                        __m128i entry = _mm_unpacklo_epi8(_mm_set1_epi32(color), zero);
+                        __m128i dlo = _mm_sub_epi16(lo, entry);
+                        __m128i dhi = _mm_sub_epi16(hi, entry);
+                        // per pixel: r*r + g*g and b*b + a*a
+                        __m128 slo = _mm_castsi128_ps(_mm_madd_epi16(dlo, dlo));
+                        __m128 shi = _mm_castsi128_ps(_mm_madd_epi16(dhi, dhi));
+                        __m128i even = _mm_castps_si128(
+                            _mm_shuffle_ps(slo, shi, _MM_SHUFFLE(2, 0, 2, 0)));
+                        __m128i odd = _mm_castps_si128(
+                            _mm_shuffle_ps(slo, shi, _MM_SHUFFLE(3, 1, 3, 1)));
+                        __m128i dist = _mm_add_epi32(even, odd);
+                        __m128i closer = _mm_cmplt_epi32(dist, best);
+                        best = _mm_or_si128(_mm_and_si128(closer, dist),
+                                            _mm_andnot_si128(closer, best));
+                        bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(c)),
+                                                 _mm_andnot_si128(closer, bestIndex));
+                }
+                int result[4];
+                _mm_storeu_si128((__m128i *)result, bestIndex);
+                for (int i = 0; i < 4; i++)
+                        indices[p + i] = (unsigned char)result[i];
+        }
+#else
+        for (int p = 0; p < 16; p++) {
+                int best = INT_MAX;
+                for (int c = 0; c < count; c++) {
+                        int dist = 0;
+                        for (int ch = 0; ch < 4; ch++) {
+                                int d = pixels[p * 4 + ch] - palette[c * 4 + ch];
+                                dist += d * d;
+                        }
+                        if (dist < best) {
+                                best = dist;
+                                indices[p] = (unsigned char)c;
+                        }
+                }
+        }
+#endif
+}
+
+// endpoints of the principal axis of the block colors (first channels only),
+// pulled in by 1/16 of the range to reduce the error of the interpolated colors
+inline void fitEndpoints(const unsigned char *pixels, int channels, float *e0, float *e1)
+{
+        float mean[4] = {0, 0, 0, 0};
+        for (int p = 0; p < 16; p++)
+                for (int c = 0; c < channels; c++)
+                        mean[c] += pixels[p * 4 + c] / 16.0f;
+        float cov[4][4] = {};
+        for (int p = 0; p < 16; p++)
+                for (int i = 0; i < channels; i++)
+                        for (int j = 0; j < channels; j++)
+                                cov[i][j] += (pixels[p * 4 + i] - mean[i]) *
+                                             (pixels[p * 4 + j] - mean[j]);
+
+        // power iteration, starting from the diagonal of the bounding box
+        float axis[4] = {0, 0, 0, 0};
+        for (int c = 0; c < channels; c++) {
+                int lo = 255, hi = 0;
+                for (int p = 0; p < 16; p++) {
+                        lo = std::min(lo, (int)pixels[p * 4 + c]);
+                        hi = std::max(hi, (int)pixels[p * 4 + c]);
+                }
+                axis[c] = (float)(hi - lo);
+        }
+        for (int iteration = 0; iteration < 8; iteration++) {
+                float next[4] = {0, 0, 0, 0};
+                float length = 0.0f;
+                for (int i = 0; i < channels; i++) {
+                        for (int j = 0; j < channels; j++)
+                                next[i] += cov[i][j] * axis[j];
+                        length = std::max(length, std::fabs(next[i]));
+                }
+                if (length < 1e-6f)
+                        break;
+                for (int i = 0; i < channels; i++)
+                        axis[i] = next[i] / length;
+        }
+
+        float lo = FLT_MAX, hi = -FLT_MAX;
+        for (int p = 0; p < 16; p++) {
+                float t = 0.0f;
+                for (int c = 0; c < channels; c++)
+                        t += (pixels[p * 4 + c] - mean[c]) * axis[c];
+                lo = std::min(lo, t);
+                hi = std::max(hi, t);
+        }
+        float norm = 0.0f;
+        for (int c = 0; c < channels; c++)
+                norm += axis[c] * axis[c];
+        float inset = (hi - lo) / 16.0f;
+        for (int c = 0; c < channels; c++) {
+                float scale = norm > 0.0f ? axis[c] / norm : 0.0f;
+                e0[c] = std::min(255.0f, std::max(0.0f, mean[c] + (hi - inset) * scale));
+                e1[c] = std::min(255.0f, std::max(0.0f, mean[c] + (lo + inset) * scale));
+        }
+}
+
+inline int quantize(float value, int bits)
+{
+        int max = (1 << bits) - 1;
+        return std::min(max, std::max(0, (int)(value * max / 255.0f + 0.5f)));
+}
+
+inline void encodeBC1(const unsigned char *block, unsigned char *out)
+{
+        // alpha doesn't take part in the fit nor in the index selection
+        unsigned char pixels[64];
+        memcpy(pixels, block, 64);
+        for (int p = 0; p < 16; p++)
+                pixels[p * 4 + 3] = 0;
+
+        float e0[4], e1[4];
+        fitEndpoints(pixels, 3, e0, e1);
+        unsigned int c0 = quantize(e0[0], 5) << 11 | quantize(e0[1], 6) << 5 |
+                          quantize(e0[2], 5);
+        unsigned int c1 = quantize(e1[0], 5) << 11 | quantize(e1[1], 6) << 5 |
+                          quantize(e1[2], 5);
+        // four color mode needs c0 > c1
+        if (c0 < c1)
+                std::swap(c0, c1);
+
+        unsigned char indices[16] = {};
+        if (c0 != c1) {
+                unsigned char palette[16] = {};
+                unsigned int colors[2] = {c0, c1};
+                for (int i = 0; i < 2; i++) {
+                        unsigned int r = colors[i] >> 11, g = colors[i] >> 5 & 63,
+                                     b = colors[i] & 31;
+                        palette[i * 4 + 0] = (unsigned char)(r << 3 | r >> 2);
+                        palette[i * 4 + 1] = (unsigned char)(g << 2 | g >> 4);
+                        palette[i * 4 + 2] = (unsigned char)(b << 3 | b >> 2);
+                }
+                for (int c = 0; c < 3; c++) {
+                        palette[8 + c] =
+                            (unsigned char)((2 * palette[c] + palette[4 + c]) / 3);
+                        palette[12 + c] =
+                            (unsigned char)((palette[c] + 2 * palette[4 + c]) / 3);
+                }
+                nearestIndices(pixels, palette, 4, indices);
+        }
+
+        uint32_t bits = 0;
+        for (int p = 0; p < 16; p++)
+                bits |= (uint32_t)indices[p] << (2 * p);
+        out[0] = c0 & 0xff;
+        out[1] = c0 >> 8;
+        out[2] = c1 & 0xff;
+        out[3] = c1 >> 8;
+        memcpy(out + 4, &bits, 4);
+}
+
+// one channel of the block in 8 interpolated steps between its min and max. The
+// steps are evenly spaced, so the closest one is found arithmetically.
+inline void encodeBC4(const unsigned char *values, int stride, unsigned char *out)
+{
+        int hi = 0, lo = 255;
+        for (int p = 0; p < 16; p++) {
+                hi = std::max(hi, (int)values[p * stride]);
+                lo = std::min(lo, (int)values[p * stride]);
+        }
+        uint64_t bits = 0;
+        if (hi != lo) {
+                for (int p = 0; p < 16; p++) {
+                        int step = ((hi - values[p * stride]) * 14 + (hi - lo)) /
+                                   (2 * (hi - lo));
+                        // step 0 is a0 (hi), step 7 is a1 (lo), the others are 2..7
+                        uint64_t index = step == 0 ? 0 : step == 7 ? 1 : step + 1;
+                        bits |= index << (3 * p);
+                }
+        }
+        out[0] = (unsigned char)hi;
+        out[1] = (unsigned char)lo;
+        for (int i = 0; i < 6; i++)
+                out[2 + i] = (unsigned char)(bits >> (8 * i));
+}
+
+inline void writeBits(unsigned char *out, unsigned int &position, unsigned int value,
+                      int count)
+{
+        for (int i = 0; i < count; i++, position++)
+                out[position >> 3] |= ((value >> i) & 1) << (position & 7);
+}
+
+const int BC7_WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+// quantized BC7 mode 6 endpoints, their indices and the resulting squared error
+struct BC7Fit {
+        int q[2][4];
+        int pbit[2];
+        unsigned char indices[16];
+        int error;
+};
+
+inline void fitBC7(const unsigned char *pixels, const float e[2][4], BC7Fit &fit)
+{
+        // per endpoint, the low bit giving the smallest error
+        unsigned char endpoint[2][4];
+        for (int i = 0; i < 2; i++) {
+                float bestError = FLT_MAX;
+                for (int p = 0; p < 2; p++) {
+                        float error = 0.0f;
+                        int candidate[4];
+                        for (int c = 0; c < 4; c++) {
+                                candidate[c] = std::min(
+                                    127, std::max(0, (int)((e[i][c] - p) / 2.0f + 0.5f)));
+                                float d = (candidate[c] << 1 | p) - e[i][c];
+                                error += d * d;
+                        }
+                        if (error < bestError) {
+                                bestError = error;
+                                fit.pbit[i] = p;
+                                memcpy(fit.q[i], candidate, sizeof(candidate));
+                        }
+                }
+                for (int c = 0; c < 4; c++)
+                        endpoint[i][c] = (unsigned char)(fit.q[i][c] << 1 | fit.pbit[i]);
+        }
+
+        unsigned char palette[64];
+        for (int s = 0; s < 16; s++)
+                for (int c = 0; c < 4; c++)
+                        palette[s * 4 + c] = (unsigned char)(
+                            ((64 - BC7_WEIGHTS[s]) * endpoint[0][c] +
+                             BC7_WEIGHTS[s] * endpoint[1][c] + 32) >>
+                            6);
+        nearestIndices(pixels, palette, 16, fit.indices);
+        fit.error = 0;
+        for (int p = 0; p < 16; p++) {
+                for (int c = 0; c < 4; c++) {
+                        int d = pixels[p * 4 + c] - palette[fit.indices[p] * 4 + c];
+                        fit.error += d * d;
+                }
+        }
+}
+
+// least squares endpoints for a given choice of indices
+inline bool refitBC7(const unsigned char *pixels, const unsigned char *indices,
+                     float e[2][4])
+{
+        float aa = 0, ab = 0, bb = 0, ax[4] = {}, bx[4] = {};
+        for (int p = 0; p < 16; p++) {
+                float b = BC7_WEIGHTS[indices[p]] / 64.0f, a = 1.0f - b;
+                aa += a * a;
+                ab += a * b;
+                bb += b * b;
+                for (int c = 0; c < 4; c++) {
+                        ax[c] += a * pixels[p * 4 + c];
+                        bx[c] += b * pixels[p * 4 + c];
+                }
+        }
+        float det = aa * bb - ab * ab;
+        if (std::fabs(det) < 1e-6f)
+                return false;
+        for (int c = 0; c < 4; c++) {
+                float e0 = (ax[c] * bb - bx[c] * ab) / det;
+                float e1 = (bx[c] * aa - ax[c] * ab) / det;
+                e[0][c] = std::min(255.0f, std::max(0.0f, e0));
+                e[1][c] = std::min(255.0f, std::max(0.0f, e1));
+        }
+        return true;
+}
+
+// BC7 mode 6: one subset, RGBA endpoints of 7 bits plus a shared low bit per
+// endpoint, 16 interpolation steps. The principal axis fit is refined once by
+// least squares.
+inline void encodeBC7(const unsigned char *pixels, unsigned char *out)
+{
+        float e[2][4];
+        fitEndpoints(pixels, 4, e[0], e[1]);
+        BC7Fit fit, refined;
+        fitBC7(pixels, e, fit);
+        if (fit.error > 0 && refitBC7(pixels, fit.indices, e)) {
+                fitBC7(pixels, e, refined);
+                if (refined.error < fit.error)
+                        fit = refined;
+        }
+
+        // the top bit of the first index is implicit zero
+        if (fit.indices[0] & 8) {
+                std::swap(fit.q[0], fit.q[1]);
+                std::swap(fit.pbit[0], fit.pbit[1]);
+                for (int p = 0; p < 16; p++)
+                        fit.indices[p] = 15 - fit.indices[p];
+        }
+
+        memset(out, 0, 16);
+        unsigned int position = 0;
+        writeBits(out, position, 1 << 6, 7);
+        for (int c = 0; c < 4; c++) {
+                writeBits(out, position, fit.q[0][c], 7);
+                writeBits(out, position, fit.q[1][c], 7);
+        }
+        writeBits(out, position, fit.pbit[0], 1);
+        writeBits(out, position, fit.pbit[1], 1);
+        writeBits(out, position, fit.indices[0], 3);
+        for (int p = 1; p < 16; p++)
+                writeBits(out, position, fit.indices[p], 4);
+}
+
+inline void encodeBlock(BlockFormat format, const unsigned char *pixels,
+                        unsigned char *out)
+{
+        switch (format) {
+        case BlockFormat::BC1:
+                encodeBC1(pixels, out);
+                break;
+        case BlockFormat::BC3:
+                encodeBC4(pixels + 3, 4, out);
+                encodeBC1(pixels, out + 8);
+                break;
+        case BlockFormat::BC4: {
+                unsigned char luma[16];
+                for (int p = 0; p < 16; p++)
+                        luma[p] = (unsigned char)((pixels[p * 4] * 77 +
+                                                   pixels[p * 4 + 1] * 150 +
+                                                   pixels[p * 4 + 2] * 29 + 128) >>
+                                                  8);
+                encodeBC4(luma, 1, out);
+                break;
+        }
+        case BlockFormat::BC5:
+                encodeBC4(pixels, 4, out);
+                encodeBC4(pixels + 1, 4, out + 8);
+                break;
+        case BlockFormat::BC7:
+                encodeBC7(pixels, out);
+                break;
+        default:
+                break;
+        }
+}
+
+inline float srgbToLinear(unsigned char value)
+{
+        static const std::vector<float> table = []() {
+                std::vector<float> t(256);
+                for (int i = 0; i < 256; i++) {
+                        float c = i / 255.0f;
+                        t[i] = c <= 0.04045f ? c / 12.92f
+                                             : std::pow((c + 0.055f) / 1.055f, 2.4f);
+                }
+                return t;
+        }();
+        return table[value];
+}
+
+inline unsigned char linearToSrgb(float value)
+{
+        static const std::vector<unsigned char> table = []() {
+                std::vector<unsigned char> t(4096);
+                for (int i = 0; i < 4096; i++) {
+                        float c = i / 4095.0f;
+                        c = c <= 0.0031308f ? c * 12.92f
+                                            : 1.055f * std::pow(c, 1 / 2.4f) - 0.055f;
+                        t[i] = (unsigned char)(c * 255.0f + 0.5f);
+                }
+                return t;
+        }();
+        int index = (int)(value * 4095.0f + 0.5f);
+        return table[std::min(4095, std::max(0, index))];
+}
+
+// next level of an RGBA mip chain, 2x2 box filter. sRGB colors are averaged in
+// linear space, as glGenerateMipmap does on sRGB textures.
+inline std::vector<unsigned char> downsample(const std::vector<unsigned char> &src,
+                                             int width, int height, bool srgb)
+{
+        int w = std::max(1, width / 2), h = std::max(1, height / 2);
+        std::vector<unsigned char> dst((size_t)w * h * 4);
+        JobPool::instance().parallelFor(h, [&](size_t y) {
+                int y0 = std::min(height - 1, (int)y * 2);
+                int y1 = std::min(height - 1, y0 + 1);
+                for (int x = 0; x < w; x++) {
+                        int x0 = std::min(width - 1, x * 2);
+                        int x1 = std::min(width - 1, x0 + 1);
+                        const unsigned char *p[4] = {
+                            &src[((size_t)y0 * width + x0) * 4],
+                            &src[((size_t)y0 * width + x1) * 4],
+                            &src[((size_t)y1 * width + x0) * 4],
+                            &src[((size_t)y1 * width + x1) * 4]};
+                        unsigned char *out = &dst[((size_t)y * w + x) * 4];
+                        for (int c = 0; c < 4; c++) {
+                                if (srgb && c < 3) {
+                                        float sum = 0.0f;
+                                        for (int i = 0; i < 4; i++)
+                                                sum += srgbToLinear(p[i][c]);
+                                        out[c] = linearToSrgb(sum / 4.0f);
+                                } else {
+                                        int sum = p[0][c] + p[1][c] + p[2][c] + p[3][c];
+                                        out[c] = (unsigned char)((sum + 2) / 4);
+                                }
+                        }
+                }
+        });
+        return dst;
+}
+
+} // namespace bc
+
+// true if an image has at least one pixel that isn't fully opaque
+inline bool hasTransparency(const unsigned char *pixels, int width, int height,
+                            int channels)
+{
+        if (channels != 4)
+                return false;
+        size_t count = (size_t)width * height;
+        for (size_t i = 0; i < count; i++)
+                if (pixels[i * 4 + 3] != 255)
+                        return true;
+        return false;
+}
+
+// true if an image has a single channel (plus alpha), or red, green and blue that
+// differ by no more than the noise a JPEG encoder adds to grey pixels
+inline bool isGrey(const unsigned char *pixels, int width, int height, int channels)
+{
+        if (channels < 3)
+                return true;
+        const int tolerance = 2;
+        size_t count = (size_t)width * height;
+        for (size_t i = 0; i < count; i++) {
+                const unsigned char *p = pixels + i * channels;
+                if (std::abs(p[0] - p[1]) > tolerance ||
+                    std::abs(p[0] - p[2]) > tolerance)
+                        return false;
+        }
+        return true;
+}
+
+// Compresses an 8-bit image (1 to 4 channels) to the given block format, with the
+// whole mip chain down to 1x1 when mipmaps is set. Blocks are encoded on all cores.
+inline void compressImage(const unsigned char *pixels, int width, int height,
+                          int channels, BlockFormat format, bool srgb, bool mipmaps,
+                          CompressedImage &out)
+{
+        std::vector<unsigned char> rgba((size_t)width * height * 4);
+        for (size_t i = 0; i < (size_t)width * height; i++) {
+                const unsigned char *src = pixels + i * channels;
+                unsigned char *dst = &rgba[i * 4];
+                dst[0] = src[0];
+                dst[1] = channels >= 3 ? src[1] : src[0];
+                dst[2] = channels >= 3 ? src[2] : src[0];
+                dst[3] = channels == 4 ? src[3] : channels == 2 ? src[1] : 255;
+        }
+
+        out.format = format;
+        out.srgb = srgb;
+        out.levels.clear();
+        for (int w = width, h = height;; w = std::max(1, w / 2), h = std::max(1, h / 2)) {
+                CompressedLevel level;
+                level.width = w;
+                level.height = h;
+                level.offset = out.levels.empty()
+                                   ? 0
+                                   : out.levels.back().offset + out.levels.back().size;
+                level.size = (size_t)((w + 3) / 4) * ((h + 3) / 4) * blockBytes(format);
+                out.levels.push_back(level);
+                if (!mipmaps || (w == 1 && h == 1))
+                        break;
+        }
+        out.data.assign(out.levels.back().offset + out.levels.back().size, 0);
+        out.external = nullptr;
+        out.externalSize = 0;
+
+        for (size_t l = 0; l < out.levels.size(); l++) {
+                const CompressedLevel &level = out.levels[l];
+                if (l > 0)
+                        rgba = bc::downsample(rgba, out.levels[l - 1].width,
+                                              out.levels[l - 1].height, srgb);
+                int blocksX = (level.width + 3) / 4, blocksY = (level.height + 3) / 4;
+                JobPool::instance().parallelFor(blocksY, [&](size_t by) {
+                        unsigned char block[64];
+                        for (int bx = 0; bx < blocksX; bx++) {
+                                // blocks overhanging the edge repeat the last texel
+                                for (int i = 0; i < 16; i++) {
+                                        int x = bx * 4 + i % 4, y = (int)by * 4 + i / 4;
+                                        x = std::min(level.width - 1, x);
+                                        y = std::min(level.height - 1, y);
+                                        size_t texel = (size_t)y * level.width + x;
+                                        memcpy(block + i * 4, &rgba[texel * 4], 4);
+                                }
+                                size_t offset = level.offset +
+                                                (by * blocksX + bx) * blockBytes(format);
+                                bc::encodeBlock(format, block, &out.data[offset]);
+                        }
+                });
+        }
+}
+
+// Compressed images are cached next to their source as "<source>.ktx", a standard
+// KTX 1.1 file holding the whole mip chain. A key/value entry records the hash and
+// size of the source plus the settings it was compressed with, so a stale cache is
+// rebuilt by itself.
+namespace ktx {
+
+// 2: coloured specular maps are no longer reduced to BC4
+const uint32_t ENCODER_VERSION = 2;
+const char SOURCE_KEY[] = "LOGL.source";
+const unsigned char IDENTIFIER[12] = {0xAB, 'K',  'T',  'X',  ' ',  '1',
+                                      '1',  0xBB, '\r', '\n', 0x1A, '\n'};
+
+struct Header {
+        unsigned char identifier[12];
+        uint32_t endianness;
+        uint32_t glType;
+        uint32_t glTypeSize;
+        uint32_t glFormat;
+        uint32_t glInternalFormat;
+        uint32_t glBaseInternalFormat;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t numberOfArrayElements;
+        uint32_t numberOfFaces;
+        uint32_t numberOfMipmapLevels;
+        uint32_t bytesOfKeyValueData;
+};
+
+struct Source {
+        uint64_t hash;
+        uint64_t size;
+        // request and flip the image was compressed with
+        uint32_t settings;
+        uint32_t encoderVersion;
+};
+
+inline std::string cachePath(const std::string &sourcePath)
+{
+        return sourcePath + ".ktx";
+}
+
+// the size cap (see texture_quality.h) takes bits 8-23
+inline uint32_t settings(const CompressionRequest &request, bool flip, int maxSize = 0)
+{
+        return (uint32_t)request.map | (request.srgb ? 16u : 0u) |
+               (request.mipmaps ? 32u : 0u) | (flip ? 64u : 0u) |
+               ((uint32_t)std::min(std::max(maxSize, 0), 0xffff) << 8);
+}
+
+// the request, flip and size cap packed into settings
+inline CompressionRequest request(uint32_t settings, bool &flip, int &maxSize)
+{
+        CompressionRequest request;
+        request.enabled = true;
+        request.map = (TextureMap)(settings & 15u);
+        request.srgb = (settings & 16u) != 0;
+        request.mipmaps = (settings & 32u) != 0;
+        flip = (settings & 64u) != 0;
+        maxSize = (settings >> 8) & 0xffff;
+        return request;
+}
+
+inline bool describeSource(const std::string &sourcePath, uint32_t settings,
+                           Source &source)
+{
+        FileView file;
+        if (!file.open(sourcePath))
+                return false;
+        source.hash = hashBytes(file.data, file.size);
+        source.size = file.size;
+        source.settings = settings;
+        source.encoderVersion = ENCODER_VERSION;
+        return true;
+}
+
+inline BlockFormat blockFormat(uint32_t internalFormat, bool &srgb)
+{
+        const BlockFormat formats[] = {BlockFormat::BC1, BlockFormat::BC3,
+                                       BlockFormat::BC4, BlockFormat::BC5,
+                                       BlockFormat::BC7};
+        for (BlockFormat format : formats) {
+                for (int s = 0; s < 2; s++) {
+                        if (compressedInternalFormat(format, s == 1) == internalFormat) {
+                                srgb = s == 1;
+                                return format;
+                        }
+                }
+        }
+        return BlockFormat::None;
+}
+
+// reads the header and the source entry of a cache, leaving cursor on the first level
+inline bool readHeader(const unsigned char *&cursor, const unsigned char *end,
+                       Header &header, Source &source)
+{
+        if ((size_t)(end - cursor) < sizeof(header))
+                return false;
+        memcpy(&header, cursor, sizeof(header));
+        cursor += sizeof(header);
+        if (memcmp(header.identifier, IDENTIFIER, sizeof(IDENTIFIER)) != 0 ||
+            header.endianness != 0x04030201 || header.numberOfFaces != 1 ||
+            header.bytesOfKeyValueData > (size_t)(end - cursor))
+                return false;
+
+        // the source entry is the only key/value pair we write
+        const unsigned char *values = cursor;
+        cursor += header.bytesOfKeyValueData;
+        uint32_t pairSize;
+        if (header.bytesOfKeyValueData < 4 + sizeof(SOURCE_KEY) + sizeof(source))
+                return false;
+        memcpy(&pairSize, values, 4);
+        if (pairSize != sizeof(SOURCE_KEY) + sizeof(source) ||
+            memcmp(values + 4, SOURCE_KEY, sizeof(SOURCE_KEY)) != 0)
+                return false;
+        memcpy(&source, values + 4 + sizeof(SOURCE_KEY), sizeof(source));
+        return true;
+}
+
+// settings the loose cache of a source image was made with, as long as the cache
+// is up to date with the source
+inline bool cachedSettings(const std::string &sourcePath, uint32_t &settings)
+{
+        MappedFile file;
+        if (!file.open(cachePath(sourcePath)))
+                return false;
+        const unsigned char *cursor = file.data;
+        Header header;
+        Source source, current;
+        if (!readHeader(cursor, file.data + file.size, header, source) ||
+            !describeSource(sourcePath, source.settings, current) ||
+            memcmp(&source, &current, sizeof(source)) != 0)
+                return false;
+        settings = source.settings;
+        return true;
+}
+
+// loads the cached compression of a source image. Returns false when there is no
+// cache, when it is stale or when the driver can't sample its format. A cache in
+// the resource pack was checked against its source by the asset cooker, so unless
+// the source is newer than the pack only the settings have to match; its levels are
+// used in place instead of being copied.
+inline bool load(const std::string &sourcePath, uint32_t settings, CompressedImage &image)
+{
+        FileView file;
+        if (!file.open(cachePath(sourcePath)))
+                return false;
+        Source expected;
+        bool trusted = file.packed && !ResourcePack::instance().overridden(sourcePath);
+        if (trusted) {
+                expected.settings = settings;
+                expected.encoderVersion = ENCODER_VERSION;
+        } else if (!describeSource(sourcePath, settings, expected)) {
+                return false;
+        }
+
+        const unsigned char *cursor = file.data, *end = file.data + file.size;
+        Header header;
+        Source source;
+        if (!readHeader(cursor, end, header, source))
+                return false;
+        if (trusted) {
+                expected.hash = source.hash;
+                expected.size = source.size;
+        }
+        if (memcmp(&source, &expected, sizeof(source)) != 0)
+                return false;
+
+        bool formatSrgb = false;
+        BlockFormat format = blockFormat(header.glInternalFormat, formatSrgb);
+        if (!BlockCompression::supported(format))
+                return false;
+
+        image.format = format;
+        image.srgb = formatSrgb;
+        image.levels.clear();
+        image.data.clear();
+        image.external = nullptr;
+        image.externalSize = 0;
+        const unsigned char *base = cursor;
+        int w = header.pixelWidth, h = header.pixelHeight;
+        for (uint32_t l = 0; l < std::max(1u, header.numberOfMipmapLevels); l++) {
+                uint32_t size;
+                if ((size_t)(end - cursor) < 4)
+                        return false;
+                memcpy(&size, cursor, 4);
+                cursor += 4;
+                if ((size_t)(end - cursor) < size)
+                        return false;
+                CompressedLevel level;
+                level.width = w;
+                level.height = h;
+                level.offset = file.packed ? cursor - base : image.data.size();
+                level.size = size;
+                image.levels.push_back(level);
+                if (!file.packed)
+                        image.data.insert(image.data.end(), cursor, cursor + size);
+                cursor += (size + 3) & ~3u;
+                w = std::max(1, w / 2);
+                h = std::max(1, h / 2);
+        }
+        if (file.packed) {
+                image.external = base;
+                image.externalSize = cursor - base;
+        }
+        return true;
+}
+
+// writes the cache of a source image to a stream (the asset cooker puts it into the
+// resource pack)
+inline bool write(const std::string &sourcePath, uint32_t settings,
+                  const CompressedImage &image, std::ostream &out)
+{
+        Source source;
+        if (image.levels.empty() || !describeSource(sourcePath, settings, source))
+                return false;
+
+        Header header;
+        memcpy(header.identifier, IDENTIFIER, sizeof(IDENTIFIER));
+        header.endianness = 0x04030201;
+        header.glType = 0;
+        header.glTypeSize = 1;
+        header.glFormat = 0;
+        header.glInternalFormat = compressedInternalFormat(image.format, image.srgb);
+        header.glBaseInternalFormat = image.format == BlockFormat::BC4   ? GL_RED
+                                      : image.format == BlockFormat::BC5 ? GL_RG
+                                      : image.format == BlockFormat::BC1 ? GL_RGB
+                                                                         : GL_RGBA;
+        header.pixelWidth = image.levels[0].width;
+        header.pixelHeight = image.levels[0].height;
+        header.pixelDepth = 0;
+        header.numberOfArrayElements = 0;
+        header.numberOfFaces = 1;
+        header.numberOfMipmapLevels = image.levels.size();
+        uint32_t pairSize = sizeof(SOURCE_KEY) + sizeof(source);
+        uint32_t padding = ((pairSize + 3) & ~3u) - pairSize;
+        header.bytesOfKeyValueData = 4 + pairSize + padding;
+
+        static const char zeros[4] = {0, 0, 0, 0};
+        out.write((const char *)&header, sizeof(header));
+        out.write((const char *)&pairSize, 4);
+        out.write(SOURCE_KEY, sizeof(SOURCE_KEY));
+        out.write((const char *)&source, sizeof(source));
+        out.write(zeros, padding);
+        for (const CompressedLevel &level : image.levels) {
+                uint32_t size = level.size;
+                out.write((const char *)&size, 4);
+                out.write((const char *)image.bytes() + level.offset, level.size);
+                out.write(zeros, ((size + 3) & ~3u) - size);
+        }
+        return (bool)out;
+}
+
+// writes the cache of a source image under a temporary name and renames it, so a
+// crash never leaves a torn file behind
+inline bool write(const std::string &sourcePath, uint32_t settings,
+                  const CompressedImage &image)
+{
+        std::string path = cachePath(sourcePath);
+        std::string tmpPath = path + ".tmp";
+        {
+                std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+                if (!out || !write(sourcePath, settings, image, out))
+                        return false;
+        }
+        return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+} // namespace ktx
+
+#endif
@@ -0,0 +1,232 @@
+#ifndef TEXTURE_QUALITY_H
+#define TEXTURE_QUALITY_H
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TEXTURE_QUALITY_SSE2 1
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+// Quality tiers cap the resolution textures are loaded at, for machines with little
+// video memory. An image larger than the cap is halved (2x2 box filter) on the CPU
+// right after decoding, until it fits, so the smaller image is what gets compressed,
+// cached as .ktx and uploaded. The cap is part of the texture cache key and of the
+// .ktx settings, so images of another tier are never mixed in.
+enum class QualityTier { Full, High, Medium, Low };
+
+const int QUALITY_TIERS = 4;
+
+class TextureQuality
+{
+      public:
+        static TextureQuality &instance()
+        {
+                static TextureQuality quality;
+                return quality;
+        }
+
+        TextureQuality(const TextureQuality &) = delete;
+        TextureQuality &operator=(const TextureQuality &) = delete;
+
+        // picks the tier; a maxSize other than 0 caps the size instead of the
+        // tier. Meant to be called once at startup, before anything is loaded.
+        void set(QualityTier tier, int maxSize = 0)
+        {
+                std::lock_guard<std::mutex> lock(mutex);
+                current = tier;
+                cap = maxSize > 0 ? maxSize : tierMaxSize(tier);
+        }
+
+        QualityTier tier() const { return current; }
+
+        // largest width or height of a texture, 0 for no cap
+        int maxSize() const { return cap; }
+
+        static int tierMaxSize(QualityTier tier)
+        {
+                static const int sizes[QUALITY_TIERS] = {0, 2048, 1024, 512};
+                return sizes[(int)tier];
+        }
+
+        static const char *tierName(QualityTier tier)
+        {
+                static const char *names[QUALITY_TIERS] = {"full", "high", "medium",
+                                                           "low"};
+                return names[(int)tier];
+        }
+
+        // the tier of a name as tierName gives it; false if there is none
+        static bool parseTier(const char *name, QualityTier &tier)
+        {
+                for (int i = 0; i < QUALITY_TIERS; i++) {
+                        if (strcmp(name, tierName((QualityTier)i)) == 0) {
+                                tier = (QualityTier)i;
+                                return true;
+                        }
+                }
+                return false;
+        }
+
+        // the size an image is loaded at under a cap
+        static void cappedSize(int maxSize, int &width, int &height)
+        {
+                while (maxSize > 0 && std::max(width, height) > maxSize) {
+                        width = std::max(1, width / 2);
+                        height = std::max(1, height / 2);
+                }
+        }
+
+        // notes a loaded image, by the size of its source and the bits per texel of
+        // the texture made of it, for report()
+        void record(int width, int height, double bitsPerTexel, bool mipmaps)
+        {
+                std::lock_guard<std::mutex> lock(mutex);
+                images.push_back(Image{width, height, bitsPerTexel, mipmaps});
+        }
+
+        // video memory the images loaded so far take at every tier, and what each
+        // tier saves against full resolution
+        void report(std::ostream &out)
+        {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (images.empty())
+                        return;
+                double full = videoMemory(0);
+                out << std::fixed << std::setprecision(2);
+                for (int i = 0; i < QUALITY_TIERS; i++) {
+                        QualityTier tier = (QualityTier)i;
+                        double bytes = videoMemory(tierMaxSize(tier));
+                        out << "TEXTURE::QUALITY " << (tier == current ? "* " : "  ")
+                            << std::setw(6) << tierName(tier) << " " << std::setw(8)
+                            << bytes / 1048576.0 << " MB, " << (full - bytes) / 1048576.0
+                            << " MB saved" << '\n';
+                }
+                if (cap != tierMaxSize(current))
+                        out << "TEXTURE::QUALITY max size " << cap << ": "
+                            << videoMemory(cap) / 1048576.0 << " MB, "
+                            << (full - videoMemory(cap)) / 1048576.0 << " MB saved"
+                            << '\n';
+                out << "TEXTURE::QUALITY " << images.size() << " images" << std::endl;
+        }
+
+      private:
+        struct Image {
+                int width;
+                int height;
+                double bitsPerTexel;
+                bool mipmaps;
+        };
+
+        std::mutex mutex;
+        QualityTier current;
+        int cap;
+        std::vector<Image> images;
+
+        TextureQuality() : current(QualityTier::Full), cap(0) {}
+
+        double videoMemory(int maxSize) const
+        {
+                double bytes = 0.0;
+                for (const Image &image : images) {
+                        int width = image.width, height = image.height;
+                        cappedSize(maxSize, width, height);
+                        double level = (double)width * height * image.bitsPerTexel / 8.0;
+                        bytes += image.mipmaps ? level * 4.0 / 3.0 : level;
+                }
+                return bytes;
+        }
+};
+
+// 2x2 box filter of two rows of 8-bit pixels into one row half as wide. The rows
+// are summed first, 16 bytes at a time, then neighbouring pixels; with four
+// channels that step is vectorized too. An odd last column is averaged with
+// itself. out may overlap the rows: it is written only once both have been summed.
+inline void halveRows(const unsigned char *top, const unsigned char *bottom, int width,
+                      int channels, unsigned char *out, std::vector<uint16_t> &sums)
+{
+        size_t bytes = (size_t)width * channels;
+        sums.resize(bytes);
+        size_t i = 0;
+#ifdef TEXTURE_QUALITY_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= bytes; i += 16) {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(top + i));
+                __m128i b =
+                    _mm_loadu_si128(reinterpret_cast<const __m128i *>(bottom + i));
+                __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero),
+                                           _mm_unpacklo_epi8(b, zero));
+                __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero),
+                                           _mm_unpackhi_epi8(b, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(&sums[i]), lo);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(&sums[i + 8]), hi);
+        }
+#endif
+        for (; i < bytes; i++)
+                sums[i] = top[i] + bottom[i];
+
+        int halfWidth = std::max(1, width / 2);
+        int x = 0;
+#ifdef TEXTURE_QUALITY_SSE2
+        if (channels == 4) {
+                // four pixels out of eight: the sums of pixel pairs, rounded
+                const __m128i two = _mm_set1_epi16(2);
+                for (; x + 4 <= halfWidth && 2 * x + 8 <= width; x += 4) {
+                        const __m128i *in =
+                            reinterpret_cast<const __m128i *>(&sums[8 * x]);
+                        __m128i s0 = _mm_loadu_si128(in);
+                        __m128i s1 = _mm_loadu_si128(in + 1);
+                        __m128i s2 = _mm_loadu_si128(in + 2);
+                        __m128i s3 = _mm_loadu_si128(in + 3);
+                        __m128i p01 = _mm_add_epi16(_mm_unpacklo_epi64(s0, s1),
+                                                    _mm_unpackhi_epi64(s0, s1));
+                        __m128i p23 = _mm_add_epi16(_mm_unpacklo_epi64(s2, s3),
+                                                    _mm_unpackhi_epi64(s2, s3));
+                        p01 = _mm_srli_epi16(_mm_add_epi16(p01, two), 2);
+                        p23 = _mm_srli_epi16(_mm_add_epi16(p23, two), 2);
+                        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 4 * x),
+                                         _mm_packus_epi16(p01, p23));
+                }
+        }
+#endif
+        for (; x < halfWidth; x++) {
+                size_t left = (size_t)2 * x * channels;
+                size_t right = (size_t)std::min(2 * x + 1, width - 1) * channels;
+                for (int c = 0; c < channels; c++)
+                        out[(size_t)x * channels + c] =
+                            (unsigned char)((sums[left + c] + sums[right + c] + 2) >> 2);
+        }
+}
+
+// halves an image in place until neither side is larger than maxSize. Returns
+// whether it was resized.
+inline bool downscaleImage(unsigned char *pixels, int &width, int &height, int channels,
+                           int maxSize)
+{
+        if (maxSize <= 0 || std::max(width, height) <= maxSize)
+                return false;
+        std::vector<uint16_t> sums;
+        while (std::max(width, height) > maxSize) {
+                int halfWidth = std::max(1, width / 2);
+                int halfHeight = std::max(1, height / 2);
+                size_t stride = (size_t)width * channels;
+                for (int y = 0; y < halfHeight; y++) {
+                        const unsigned char *top = pixels + 2 * y * stride;
+                        const unsigned char *bottom =
+                            pixels + std::min(2 * y + 1, height - 1) * stride;
+                        halveRows(top, bottom, width, channels,
+                                  pixels + (size_t)y * halfWidth * channels, sums);
+                }
+                width = halfWidth;
+                height = halfHeight;
+        }
+        return true;
+}
+
+#endif
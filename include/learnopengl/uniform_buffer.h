@@ -0,0 +1,209 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+struct PointLight {
+    glm::vec3 position;
+
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+struct DirLight {
+    glm::vec3 direction;
+
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+};
+
+struct SpotLight {
+    glm::vec3 position;
+    glm::vec3 direction;
+    float cutOff;
+    float outerCutOff;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+};
+
+// Uniform blocks every program shares, by the binding point their buffer is bound
+// to. The blocks are declared in resources/shaders/camera.glsl and lighting.glsl;
+// the structs below are their std140 layout, padding included, and have to be kept
+// in step with them.
+enum UniformBlockBinding { CAMERA_BLOCK_BINDING, LIGHTS_BLOCK_BINDING };
+
+// NR_POINT_LIGHTS in lighting.glsl
+const int MAX_POINT_LIGHTS = 1;
+
+// uniform Camera, set once per frame
+struct CameraBlock {
+        glm::mat4 projection;
+        glm::mat4 view;
+        glm::vec3 viewPos;
+        float pad0;
+};
+static_assert(sizeof(CameraBlock) == 144, "CameraBlock must match std140");
+
+// std140 images of the light structs of lighting.glsl: a vec3 is aligned to 16
+// bytes, a float after it takes the slot left over
+struct DirLightBlock {
+        glm::vec3 direction;
+        float pad0;
+        glm::vec3 ambient;
+        float pad1;
+        glm::vec3 diffuse;
+        float pad2;
+        glm::vec3 specular;
+        float pad3;
+
+        DirLightBlock() = default;
+        explicit DirLightBlock(const DirLight &light)
+            : direction(light.direction), pad0(0.0f), ambient(light.ambient),
+              pad1(0.0f), diffuse(light.diffuse), pad2(0.0f),
+              specular(light.specular), pad3(0.0f)
+        {
+        }
+};
+static_assert(sizeof(DirLightBlock) == 64, "DirLightBlock must match std140");
+
+struct PointLightBlock {
+        glm::vec3 position;
+        float constant;
+        float linear;
+        float quadratic;
+        float pad0[2];
+        glm::vec3 ambient;
+        float pad1;
+        glm::vec3 diffuse;
+        float pad2;
+        glm::vec3 specular;
+        float pad3;
+
+        PointLightBlock() = default;
+        explicit PointLightBlock(const PointLight &light)
+            : position(light.position), constant(light.constant),
+              linear(light.linear), quadratic(light.quadratic), pad0{0.0f, 0.0f},
+              ambient(light.ambient), pad1(0.0f), diffuse(light.diffuse),
+              pad2(0.0f), specular(light.specular), pad3(0.0f)
+        {
+        }
+};
+static_assert(offsetof(PointLightBlock, ambient) == 32 && sizeof(PointLightBlock) == 80,
+              "PointLightBlock must match std140");
+
+struct SpotLightBlock {
+        glm::vec3 position;
+        float pad0;
+        glm::vec3 direction;
+        float cutOff;
+        float outerCutOff;
+        float constant;
+        float linear;
+        float quadratic;
+        glm::vec3 ambient;
+        float pad1;
+        glm::vec3 diffuse;
+        float pad2;
+        glm::vec3 specular;
+        float pad3;
+
+        SpotLightBlock() = default;
+        explicit SpotLightBlock(const SpotLight &light)
+            : position(light.position), pad0(0.0f), direction(light.direction),
+              cutOff(light.cutOff), outerCutOff(light.outerCutOff),
+              constant(light.constant), linear(light.linear),
+              quadratic(light.quadratic), ambient(light.ambient), pad1(0.0f),
+              diffuse(light.diffuse), pad2(0.0f), specular(light.specular),
+              pad3(0.0f)
+        {
+        }
+};
+static_assert(offsetof(SpotLightBlock, ambient) == 48 && sizeof(SpotLightBlock) == 96,
+              "SpotLightBlock must match std140");
+
+// uniform Lights. The spot light is in the block even for programs built without
+// SPOT_LIGHT, so the layout is the same in every variant.
+struct LightsBlock {
+        DirLightBlock dirLight;
+        PointLightBlock pointLights[MAX_POINT_LIGHTS];
+        SpotLightBlock spotLight;
+};
+static_assert(offsetof(LightsBlock, spotLight) == 64 + 80 * MAX_POINT_LIGHTS,
+              "LightsBlock must match std140");
+
+// binds the shared uniform blocks a program has to their binding points. GLSL 330
+// can't give a block its binding in the source, so this is done once a program is
+// linked (see Shader).
+inline void bindUniformBlocks(unsigned int program)
+{
+        static const struct {
+                const char *name;
+                UniformBlockBinding binding;
+        } blocks[] = {{"Camera", CAMERA_BLOCK_BINDING}, {"Lights", LIGHTS_BLOCK_BINDING}};
+        for (const auto &block : blocks) {
+                GLuint index = glGetUniformBlockIndex(program, block.name);
+                if (index != GL_INVALID_INDEX)
+                        glUniformBlockBinding(program, index, block.binding);
+        }
+}
+
+// A uniform buffer bound to a binding point for good, holding one block. update()
+// uploads the block only when it changed since the last upload.
+class UniformBuffer
+{
+      public:
+        UniformBuffer(UniformBlockBinding binding, size_t size) : ID(0), last(size)
+        {
+                glGenBuffers(1, &ID);
+                glBindBuffer(GL_UNIFORM_BUFFER, ID);
+                glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+                glBindBuffer(GL_UNIFORM_BUFFER, 0);
+                glBindBufferBase(GL_UNIFORM_BUFFER, binding, ID);
+        }
+
+        UniformBuffer(const UniformBuffer &) = delete;
+        UniformBuffer &operator=(const UniformBuffer &) = delete;
+
+        ~UniformBuffer() { glDeleteBuffers(1, &ID); }
+
+        template <typename Block> void update(const Block &block)
+        {
+                static_assert(std::is_trivially_copyable<Block>::value,
+                              "a uniform block is copied byte for byte");
+                // a block of another size isn't the one this buffer holds
+                if (sizeof(block) != last.size())
+                        return;
+                if (uploaded && memcmp(last.data(), &block, sizeof(block)) == 0)
+                        return;
+                memcpy(last.data(), &block, sizeof(block));
+                uploaded = true;
+                glBindBuffer(GL_UNIFORM_BUFFER, ID);
+                glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &block);
+                glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        }
+
+      private:
+        unsigned int ID;
+        std::vector<unsigned char> last;
+        bool uploaded = false;
+};
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// How the vertices of a mesh are laid out in its vertex buffer.
+//   Full   - struct Vertex, 56 bytes of floats
+//   Packed - struct PackedVertex, 20 bytes, decoded by the vertex shader (see
+//            resources/shaders/modelLightingPacked.vs)
+enum class VertexLayout { Full, Packed };
+
+// Vertex attributes, by the location the vertex shaders read them from. Every
+// attribute is a vertex buffer (stream) of its own, so a mesh uploads only the
+// attributes its programs read. The packed layout keeps the whole tangent frame in
+// ATTRIBUTE_TANGENT and has no bitangent.
+enum VertexAttribute {
+        ATTRIBUTE_POSITION,
+        ATTRIBUTE_NORMAL,
+        ATTRIBUTE_TEXCOORDS,
+        ATTRIBUTE_TANGENT,
+        ATTRIBUTE_BITANGENT,
+        ATTRIBUTE_COUNT
+};
+
+// set of vertex attributes, bit i for location i
+typedef unsigned int AttributeMask;
+
+inline AttributeMask attributeBit(VertexAttribute attribute) { return 1u << attribute; }
+
+const AttributeMask ALL_ATTRIBUTES = (1u << ATTRIBUTE_COUNT) - 1;
+
+// Quantized vertex:
+//   Position     - 16-bit unsigned normalized coordinates inside the mesh bounds.
+//                  The 4th component is the handedness of the tangent frame
+//                  (0 = right handed, 65535 = mirrored UVs).
+//   Normal       - octahedral encoding, 2 x 16-bit signed normalized
+//   TexCoords    - 2 x half float
+//   TangentFrame - rotation taking (x, y, z) to (tangent, bitangent, normal) as a
+//                  "smallest three" quaternion: the index of the largest
+//                  component in bits 30-31, the other three in 3 x 10 bits
+struct PackedVertex {
+        uint16_t Position[4];
+        int16_t Normal[2];
+        uint16_t TexCoords[2];
+        uint32_t TangentFrame;
+};
+static_assert(sizeof(PackedVertex) == 20, "PackedVertex must stay tightly packed");
+
+// maps the normalized positions of packed vertices back to model space:
+// position = offset + scale * quantized
+struct VertexQuantization {
+        glm::vec3 offset = glm::vec3(0.0f);
+        glm::vec3 scale = glm::vec3(1.0f);
+};
+
+inline uint16_t floatToHalf(float value)
+{
+        uint32_t bits;
+        memcpy(&bits, &value, 4);
+        uint32_t sign = (bits >> 16) & 0x8000;
+        int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+        uint32_t mantissa = bits & 0x7fffff;
+        if (((bits >> 23) & 0xff) == 0xff) // inf, nan
+                return (uint16_t)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+        if (exponent >= 31) // overflow
+                return (uint16_t)(sign | 0x7c00);
+        if (exponent <= 0) {
+                if (exponent < -10) // underflow
+                        return (uint16_t)sign;
+                // denormal, with the implicit leading one
+                mantissa |= 0x800000;
+                uint32_t shift = 14 - exponent;
+                uint32_t half = mantissa >> shift;
+                // round to nearest even
+                uint32_t rest = mantissa & ((1u << shift) - 1);
+                uint32_t halfway = 1u << (shift - 1);
+                if (rest > halfway || (rest == halfway && (half & 1)))
+                        half++;
+                return (uint16_t)(sign | half);
+        }
+        uint32_t half = sign | (uint32_t)exponent << 10 | mantissa >> 13;
+        uint32_t rest = mantissa & 0x1fff;
+        if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+                half++; // may carry into the exponent, which is still correct
+        return (uint16_t)half;
+}
+
+inline int16_t packSnorm16(float value)
+{
+        return (int16_t)std::lround(std::min(1.0f, std::max(-1.0f, value)) * 32767.0f);
+}
+
+inline uint16_t packUnorm16(float value)
+{
+        return (uint16_t)std::lround(std::min(1.0f, std::max(0.0f, value)) * 65535.0f);
+}
+
+// octahedral normal encoding: the unit sphere is projected onto an octahedron and
+// the lower half is folded over the upper one, giving a square in [-1, 1]^2
+inline void encodeOctahedral(glm::vec3 n, int16_t out[2])
+{
+        float sum = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+        if (sum == 0.0f) {
+                out[0] = out[1] = 0;
+                return;
+        }
+        float x = n.x / sum, y = n.y / sum;
+        if (n.z < 0.0f) {
+                float fx = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+                float fy = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+                x = fx;
+                y = fy;
+        }
+        out[0] = packSnorm16(x);
+        out[1] = packSnorm16(y);
+}
+
+// any unit vector orthogonal to n
+inline glm::vec3 orthogonal(const glm::vec3 &n)
+{
+        glm::vec3 axis = std::fabs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f)
+                                               : glm::vec3(0.0f, 1.0f, 0.0f);
+        return glm::normalize(glm::cross(n, axis));
+}
+
+// Orthonormalizes the tangent frame (Gram-Schmidt, normal first) and packs it as a
+// quaternion. handedness receives -1 when the bitangent points against
+// cross(normal, tangent), as it does with mirrored UVs.
+inline uint32_t packTangentFrame(glm::vec3 tangent, glm::vec3 bitangent,
+                                 glm::vec3 normal, float &handedness)
+{
+        glm::vec3 n = glm::length(normal) > 0.0f ? glm::normalize(normal)
+                                                : glm::vec3(0.0f, 0.0f, 1.0f);
+        glm::vec3 t = tangent - n * glm::dot(n, tangent);
+        t = glm::length(t) > 1e-6f ? glm::normalize(t) : orthogonal(n);
+        glm::vec3 b = glm::cross(n, t);
+        handedness = glm::dot(b, bitangent) < 0.0f ? -1.0f : 1.0f;
+
+        // quaternion of the rotation matrix with columns t, b, n
+        float q[4]; // x, y, z, w
+        float trace = t.x + b.y + n.z;
+        if (trace > 0.0f) {
+                float s = std::sqrt(trace + 1.0f) * 2.0f;
+                q[3] = 0.25f * s;
+                q[0] = (b.z - n.y) / s;
+                q[1] = (n.x - t.z) / s;
+                q[2] = (t.y - b.x) / s;
+        } else if (t.x > b.y && t.x > n.z) {
+                float s = std::sqrt(1.0f + t.x - b.y - n.z) * 2.0f;
+                q[3] = (b.z - n.y) / s;
+                q[0] = 0.25f * s;
+                q[1] = (b.x + t.y) / s;
+                q[2] = (n.x + t.z) / s;
+        } else if (b.y > n.z) {
+                float s = std::sqrt(1.0f + b.y - t.x - n.z) * 2.0f;
+                q[3] = (n.x - t.z) / s;
+                q[0] = (b.x + t.y) / s;
+                q[1] = 0.25f * s;
+                q[2] = (n.y + b.z) / s;
+        } else {
+                float s = std::sqrt(1.0f + n.z - t.x - b.y) * 2.0f;
+                q[3] = (t.y - b.x) / s;
+                q[0] = (n.x + t.z) / s;
+                q[1] = (n.y + b.z) / s;
+                q[2] = 0.25f * s;
+        }
+
+        // q and -q are the same rotation, so the largest component is made positive
+        // and left out; the others are within +-1/sqrt(2)
+        int largest = 0;
+        for (int i = 1; i < 4; i++)
+                if (std::fabs(q[i]) > std::fabs(q[largest]))
+                        largest = i;
+        float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+        const float range = 0.70710678f;
+        uint32_t packed = (uint32_t)largest << 30;
+        for (int i = 0, slot = 0; i < 4; i++) {
+                if (i == largest)
+                        continue;
+                float v = (q[i] * sign + range) / (2.0f * range);
+                v = std::min(1.0f, std::max(0.0f, v));
+                uint32_t bits = (uint32_t)std::lround(v * 1023.0f);
+                packed |= bits << (10 * slot++);
+        }
+        return packed;
+}
+
+#endif
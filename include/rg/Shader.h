@@ -10,6 +10,7 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <iostream>
+#include <learnopengl/program_cache.h>
 #include <rg/Error.h>
 #include <sstream>
 #include <string>
@@ -27,6 +28,16 @@ class Shader
                 // vertex shader
                 std::string vsString = readFileContents(vertexShaderPath);
                 ASSERT(!vsString.empty(), "Vertex shader source is empty!");
+                std::string fsString = readFileContents(fragmentShaderPath);
+                ASSERT(!fsString.empty(), "Fragment shader empty!");
+                // a program linked by an earlier run is loaded as it is
+                ProgramBinaryCache &programCache = ProgramBinaryCache::instance();
+                uint64_t key = ProgramBinaryCache::hashSource(
+                    fsString.data(), fsString.size(),
+                    ProgramBinaryCache::hashSource(vsString.data(), vsString.size()));
+                m_Id = programCache.load(key);
+                if (m_Id != 0)
+                        return;
                 const char *vertexShaderSource = vsString.c_str();
                 int vertexShader = glCreateShader(GL_VERTEX_SHADER);
                 glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
@@ -42,8 +53,6 @@ class Shader
                 }
                 // fragment shader
                 int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-                std::string fsString = readFileContents(fragmentShaderPath);
-                ASSERT(!fsString.empty(), "Fragment shader empty!");
                 const char *fragmentShaderSource = fsString.c_str();
                 glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
                 glCompileShader(fragmentShader);
@@ -58,6 +67,7 @@ class Shader
                 int shaderProgram = glCreateProgram();
                 glAttachShader(shaderProgram, vertexShader);
                 glAttachShader(shaderProgram, fragmentShader);
+                programCache.prepare(shaderProgram);
                 glLinkProgram(shaderProgram);
                 // check for linking errors
                 glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
@@ -66,6 +76,7 @@ class Shader
                         std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n"
                                   << infoLog << std::endl;
                 }
+                programCache.store(key, shaderProgram);
                 glDeleteShader(vertexShader);
                 glDeleteShader(fragmentShader);
                 m_Id = shaderProgram;
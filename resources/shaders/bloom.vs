@@ -1,9 +1,10 @@
 #version 330 core
+#include "varying.glsl"
 
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoords;
 
-out vec2 TexCoords;
+LOCATION(2) out vec2 TexCoords;
 
 void main() {
     TexCoords = aTexCoords;
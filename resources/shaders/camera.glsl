@@ -0,0 +1,7 @@
+// kamera, zajednicka za sve programe; ukljucuje se sa #include "camera.glsl".
+// Blok se puni jednom po frejmu (CameraBlock u uniform_buffer.h, std140)
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
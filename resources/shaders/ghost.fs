@@ -1,7 +1,8 @@
 #version 330 core
+#include "varying.glsl"
 out vec4 FragColor;
 
-in vec2 TexCoords;
+LOCATION(2) in vec2 TexCoords;
 
 uniform sampler2D texture1;
 
@@ -1,12 +1,13 @@
 #version 330 core
+#include "varying.glsl"
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoords;
 
-out vec2 TexCoords;
+LOCATION(2) out vec2 TexCoords;
+
+#include "camera.glsl"
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main()
 {
@@ -1,30 +1,29 @@
 #version 330 core
+#include "varying.glsl"
 out vec4 FragColor;
 
-in vec2 TexCoords;
+// HDR i BLOOM se definisu pri pravljenju varijante sejdera
+
+LOCATION(2) in vec2 TexCoords;
 
 uniform sampler2D hdrBuffer;
+#ifdef BLOOM
 uniform sampler2D bloomBlur;
-uniform bool hdr;
-uniform bool bloom;
+#endif
 uniform float exposure;
 
 void main()
 {
     const float gamma = 2.2;
     vec3 hdrColor = texture(hdrBuffer, TexCoords).rgb;
-    vec3 bloomColor = texture(bloomBlur, TexCoords).rgb;
-    if (bloom) {
-                     hdrColor += bloomColor;
-    }
-    vec3 result = hdrColor;
-    if(hdr){
-        result = vec3(1.0) - exp(-hdrColor * exposure);
-        result = pow(result, vec3(1.0 / gamma));
-        FragColor = vec4(result, 1.0);
-    }
-    else{
-        vec3 result = pow(hdrColor, vec3(1.0 / gamma));
-        FragColor = vec4(result, 1.0);
-    }
+#ifdef BLOOM
+    hdrColor += texture(bloomBlur, TexCoords).rgb;
+#endif
+#ifdef HDR
+    vec3 result = vec3(1.0) - exp(-hdrColor * exposure);
+    result = pow(result, vec3(1.0 / gamma));
+#else
+    vec3 result = pow(hdrColor, vec3(1.0 / gamma));
+#endif
+    FragColor = vec4(result, 1.0);
 }
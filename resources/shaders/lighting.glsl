@@ -0,0 +1,128 @@
+// zajednicka biblioteka osvetljenja, ukljucuje se sa #include "lighting.glsl"
+// BLINN: Blin-Fong umesto Fongovog spekularnog sencenja
+
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct PointLight {
+    vec3 position;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct SpotLight {
+    vec3 position;
+    vec3 direction;
+    float cutOff;
+    float outerCutOff;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+#define NR_POINT_LIGHTS 1
+
+// svetla scene, zajednicka za sve programe; blok se puni jednom po frejmu
+// (LightsBlock u uniform_buffer.h, std140). Spot svetlo je u bloku i kada
+// SPOT_LIGHT nije definisan, da bi raspored bio isti u svim varijantama.
+layout (std140) uniform Lights {
+    DirLight dirLight;
+    PointLight pointLights[NR_POINT_LIGHTS];
+    SpotLight spotLight;
+};
+
+// boje materijala u fragmentu, teksture se citaju samo jednom za sva svetla
+struct Surface {
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    float shininess;
+};
+
+// normala iz mape normala u tangentnom prostoru; koriste se samo x i y, a z se
+// racuna iz njih, jer BC5 mape (texture_compression.h) cuvaju samo dva kanala
+vec3 NormalFromMap(sampler2D normalMap, vec2 texCoords)
+{
+    vec2 xy = texture(normalMap, texCoords).rg * 2.0 - 1.0;
+    return vec3(xy, sqrt(max(1.0 - dot(xy, xy), 0.0)));
+}
+
+// spekularno sencenje
+float CalcSpecular(vec3 lightDir, vec3 normal, vec3 viewDir, float shininess)
+{
+#ifdef BLINN
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    return pow(max(dot(normal, halfwayDir), 0.0), shininess);
+#else
+    vec3 reflectDir = reflect(-lightDir, normal);
+    return pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+#endif
+}
+
+// izracunavanje boje koriscenjem direkcionog svetla
+vec3 CalcDirLight(DirLight light, Surface surface, vec3 normal, vec3 viewDir)
+{
+    vec3 lightDir = normalize(-light.direction);
+    // difuzno sencenje
+    float diff = max(dot(normal, lightDir), 0.0);
+    float spec = CalcSpecular(lightDir, normal, viewDir, surface.shininess);
+    // kombinovanje rezultata
+    vec3 ambient = light.ambient * surface.ambient;
+    vec3 diffuse = light.diffuse * diff * surface.diffuse;
+    vec3 specular = light.specular * spec * surface.specular;
+    return (ambient + diffuse + specular);
+}
+
+// racunanje vrednosti boje koriscenjem point light
+vec3 CalcPointLight(PointLight light, Surface surface, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    // difuzno sencenje
+    float diff = max(dot(normal, lightDir), 0.0);
+    float spec = CalcSpecular(lightDir, normal, viewDir, surface.shininess);
+    // attenuation
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    // kombinovanje rezultata
+    vec3 ambient = light.ambient * surface.ambient;
+    vec3 diffuse = light.diffuse * diff * surface.diffuse;
+    vec3 specular = light.specular * spec * surface.specular;
+    return (ambient + diffuse + specular) * attenuation;
+}
+
+// racunanje boje koriscenjem spotlight-a
+vec3 CalcSpotLight(SpotLight light, Surface surface, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    // difuzno sencenje
+    float diff = max(dot(normal, lightDir), 0.0);
+    float spec = CalcSpecular(lightDir, normal, viewDir, surface.shininess);
+    // attenuation
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    // intenzitet svetla
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    // kombinovanje rezultata
+    vec3 ambient = light.ambient * surface.ambient;
+    vec3 diffuse = light.diffuse * diff * surface.diffuse;
+    vec3 specular = light.specular * spec * surface.specular;
+    return (ambient + diffuse + specular) * attenuation * intensity;
+}
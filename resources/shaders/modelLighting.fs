@@ -1,6 +1,11 @@
 #version 330 core
+#include "varying.glsl"
 out vec4 FragColor;
 
+// BLINN i SPOT_LIGHT se definisu pri pravljenju varijante sejdera
+#include "camera.glsl"
+#include "lighting.glsl"
+
 struct Material {
     sampler2D ambient;
     sampler2D diffuse;
@@ -8,165 +13,32 @@ struct Material {
     float shininess;
 };
 
-struct DirLight {
-    vec3 direction;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct PointLight {
-    vec3 position;
-
-    float constant;
-    float linear;
-    float quadratic;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct SpotLight {
-    vec3 position;
-    vec3 direction;
-    float cutOff;
-    float outerCutOff;
-
-    float constant;
-    float linear;
-    float quadratic;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-#define NR_POINT_LIGHTS 1
+LOCATION(0) in vec3 FragPos;
+LOCATION(1) in vec3 Normal;
+LOCATION(2) in vec2 TexCoords;
 
-in vec3 FragPos;
-in vec3 Normal;
-in vec2 TexCoords;
-uniform bool blinn;
-
-uniform vec3 viewPos;
 uniform Material material;
 
-uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform SpotLight spotLight;
-
-
-// prototipovi funkcija
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
-vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
-
 void main()
 {
     // properties
     vec3 norm = normalize(Normal);
     vec3 viewDir = normalize(viewPos - FragPos);
+    Surface surface;
+    surface.ambient = vec3(texture(material.ambient, TexCoords));
+    surface.diffuse = vec3(texture(material.diffuse, TexCoords));
+    surface.specular = vec3(texture(material.specular, TexCoords));
+    surface.shininess = material.shininess;
 
     //direkciono svetlo
-    vec3 result = CalcDirLight(dirLight, norm, viewDir);
+    vec3 result = CalcDirLight(dirLight, surface, norm, viewDir);
     //point lights
     for(int i = 0; i < NR_POINT_LIGHTS; i++)
-        result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
+        result += CalcPointLight(pointLights[i], surface, norm, FragPos, viewDir);
     //spotlight
-    result += CalcSpotLight(spotLight, norm, FragPos, viewDir);
+#ifdef SPOT_LIGHT
+    result += CalcSpotLight(spotLight, surface, norm, FragPos, viewDir);
+#endif
 
     FragColor = vec4(result, 1.0);
 }
-
-// izracunavanje boje koriscenjem direkcionog svetla
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
-{
-    vec3 lightDir = normalize(-light.direction);
-    // Blin-Fong
-    vec3 halfwayDir = normalize(lightDir + viewDir);
-    // difuzno sencenje
-    float diff = max(dot(normal, lightDir), 0.0);
-    // spekularno sencenje
-    vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = 0.0f;
-    if(blinn){
-        vec3 halfwayDir = normalize(lightDir + viewDir);
-        spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
-    }
-    else{
-        spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    }
-    // kombinovanje rezultata
-    vec3 ambient = light.ambient * vec3(texture(material.ambient, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
-    return (ambient + diffuse + specular);
-}
-
-// racunanje vrednosti boje koriscenjem point light
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
-{
-    vec3 lightDir = normalize(light.position - fragPos);
-    // Blin-Fong
-    vec3 halfwayDir = normalize(lightDir + viewDir);
-    // difuzno sencenje
-    float diff = max(dot(normal, lightDir), 0.0);
-    // sprekulatno sencenje
-    vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = 0.0f;
-    if(blinn){
-        vec3 halfwayDir = normalize(lightDir + viewDir);
-        spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
-    }
-    else{
-        spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    }
-    // attenuation
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
-    // kombinovanje rezultata
-    vec3 ambient = light.ambient * vec3(texture(material.ambient, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = (light.specular * spec * vec3(texture(material.specular, TexCoords))).rgb;
-    ambient *= attenuation;
-    diffuse *= attenuation;
-    specular *= attenuation;
-    return (ambient + diffuse + specular);
-}
-
-// racunanje boje koriscenjem spotlight-a
-vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
-{
-    vec3 lightDir = normalize(light.position - fragPos);
-    // Blin-Fong
-    vec3 halfwayDir = normalize(lightDir + viewDir);
-    // difuzno sencenje
-    float diff = max(dot(normal, lightDir), 0.0);
-    // spekularno sencenje
-    vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = 0.0f;
-    if(blinn){
-        vec3 halfwayDir = normalize(lightDir + viewDir);
-        spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
-    }
-    else{
-        spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    }
-    // attenuation
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
-    // intenzitet svetla
-    float theta = dot(lightDir, normalize(-light.direction));
-    float epsilon = light.cutOff - light.outerCutOff;
-    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
-    // kombinovanje rezultata
-    vec3 ambient = light.ambient * vec3(texture(material.ambient, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
-    ambient *= attenuation * intensity;
-    diffuse *= attenuation * intensity;
-    specular *= attenuation * intensity;
-    return (ambient + diffuse + specular);
-}
\ No newline at end of file
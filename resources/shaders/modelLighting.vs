@@ -1,15 +1,16 @@
 #version 330 core
+#include "varying.glsl"
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 
-out vec2 TexCoords;
-out vec3 Normal;
-out vec3 FragPos;
+LOCATION(2) out vec2 TexCoords;
+LOCATION(1) out vec3 Normal;
+LOCATION(0) out vec3 FragPos;
+
+#include "camera.glsl"
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main()
 {
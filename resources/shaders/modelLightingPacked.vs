@@ -0,0 +1,77 @@
+#version 330 core
+#include "varying.glsl"
+// isto kao modelLighting.vs, ali za sazet format verteksa (PackedVertex)
+layout (location = 0) in vec4 aPos;          // kvantizovana pozicija, w = orijentacija
+layout (location = 1) in vec2 aNormal;       // oktaedarski kodirana normala
+layout (location = 2) in vec2 aTexCoords;    // half float
+// tangentni prostor treba samo za normal mape; bez NORMAL_MAP se atribut 3 ne
+// cita, pa ga model ni ne salje na GPU
+#ifdef NORMAL_MAP
+layout (location = 3) in uint aTangentFrame; // kvaternion tangentnog prostora
+#endif
+
+LOCATION(2) out vec2 TexCoords;
+LOCATION(1) out vec3 Normal;
+LOCATION(0) out vec3 FragPos;
+#ifdef NORMAL_MAP
+LOCATION(3) out mat3 TBN;
+#endif
+
+#include "camera.glsl"
+
+uniform mat4 model;
+
+// preslikavanje kvantizovane pozicije nazad u prostor modela
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) {
+        vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+        n.xy = (1.0 - abs(n.yx)) * signs;
+    }
+    return normalize(n);
+}
+
+#ifdef NORMAL_MAP
+// "smallest three": najveca komponenta se izracunava iz ostale tri
+vec4 decodeQuaternion(uint packed)
+{
+    const float range = 0.70710678;
+    vec3 v = vec3(uvec3(packed, packed >> 10, packed >> 20) & 1023u) / 1023.0;
+    v = v * (2.0 * range) - range;
+    float largest = sqrt(max(0.0, 1.0 - dot(v, v)));
+    uint index = packed >> 30;
+    if (index == 0u)
+        return vec4(largest, v);
+    if (index == 1u)
+        return vec4(v.x, largest, v.yz);
+    if (index == 2u)
+        return vec4(v.xy, largest, v.z);
+    return vec4(v, largest);
+}
+
+vec3 rotate(vec4 q, vec3 v)
+{
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+#endif
+
+void main()
+{
+    vec3 position = positionOffset + positionScale * aPos.xyz;
+#ifdef NORMAL_MAP
+    float handedness = 1.0 - 2.0 * aPos.w;
+    vec4 q = decodeQuaternion(aTangentFrame);
+    TBN = mat3(rotate(q, vec3(1.0, 0.0, 0.0)),
+               rotate(q, vec3(0.0, 1.0, 0.0)) * handedness,
+               rotate(q, vec3(0.0, 0.0, 1.0)));
+#endif
+
+    FragPos = vec3(model * vec4(position, 1.0));
+    Normal = decodeOctahedral(aNormal);
+    TexCoords = aTexCoords;
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -1,8 +1,9 @@
 #version 330 core
+#include "varying.glsl"
 layout (location = 0) out vec4 FragColor;
 layout (location = 1) out vec4 BrightColor;
 
-in vec3 TexCoords;
+LOCATION(2) in vec3 TexCoords;
 
 uniform samplerCube skybox;
 
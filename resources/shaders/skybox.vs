@@ -1,14 +1,15 @@
 #version 330 core
+#include "varying.glsl"
 layout (location = 0) in vec3 aPos;
 
-out vec3 TexCoords;
+LOCATION(2) out vec3 TexCoords;
 
-uniform mat4 projection;
-uniform mat4 view;
+#include "camera.glsl"
 
 void main()
 {
     TexCoords = aPos;
-    vec4 pos = projection * view * vec4(aPos, 1.0);
+    // bez translacije iz matrice pogleda, nebo je uvek oko kamere
+    vec4 pos = projection * mat4(mat3(view)) * vec4(aPos, 1.0);
     gl_Position = pos.xyww;
 }
@@ -1,106 +1,36 @@
 #version 330 core
+#include "varying.glsl"
 layout (location = 0) out vec4 FragColor;
 layout (location = 1) out vec4 BrightColor;
 
-in vec2 TexCoord;
-in vec3 Normal;
-in vec3 FragPos;
+// BLINN i SPOT_LIGHT se definisu pri pravljenju varijante sejdera
+#include "camera.glsl"
+#include "lighting.glsl"
 
-struct DirLight {
-    vec3 direction;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct SpotLight {
-    vec3 position;
-    vec3 direction;
-    float cutOff;
-    float outerCutOff;
-
-    float constant;
-    float linear;
-    float quadratic;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
+LOCATION(2) in vec2 TexCoord;
+LOCATION(1) in vec3 Normal;
+LOCATION(0) in vec3 FragPos;
 
 struct Material {
     sampler2D texture_diffuse1;
     float shininess;
 };
 
-
-uniform DirLight dirLight;
-uniform SpotLight spotLight;
-uniform vec3 viewPosition;
 uniform Material material;
 
-vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
-
 void main() {
 
     vec3 normal = normalize(Normal);
-    vec3 viewDir = normalize(viewPosition - FragPos);
-    vec3 result = CalcDirLight(dirLight, normal, viewDir) + CalcSpotLight(spotLight, normal, FragPos, viewDir);
-    FragColor = vec4(result, 1.0);
+    vec3 viewDir = normalize(viewPos - FragPos);
+    // sve komponente materijala su iz iste teksture
+    vec3 color = vec3(texture(material.texture_diffuse1, TexCoord));
+    Surface surface = Surface(color, color, color, material.shininess);
+
+    vec3 result = CalcDirLight(dirLight, surface, normal, viewDir);
+#ifdef SPOT_LIGHT
+    result += CalcSpotLight(spotLight, surface, normal, FragPos, viewDir);
+#endif
 
         BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
         FragColor = vec4(result, 1.0);
 }
-
-
-vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
-{
-    vec3 lightDir = normalize(light.position - fragPos);
-
-    // difuzno
-    float diff = max(dot(normal, lightDir), 0.0);
-
-    // spekularno
-    vec3 halfwayDir = normalize(lightDir + viewDir);
-    float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
-
-    // attenuation
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
-
-    // jacina spotlighta
-    float theta = dot(lightDir, normalize(-light.direction));
-    float epsilon = light.cutOff - light.outerCutOff;
-    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
-
-
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoord));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoord));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_diffuse1, TexCoord));
-
-    ambient *= attenuation * intensity;
-    diffuse *= attenuation * intensity;
-    specular *= attenuation * intensity;
-
-    return (ambient + diffuse + specular);
-}
-
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir){
-
-    vec3 lightDir = normalize(-light.direction);
-
-    //difuzno
-    float diff = max(dot(normal, lightDir), 0.0);
-
-    //spekularno
-    vec3 halfwayDir = normalize(lightDir + viewDir);
-    float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
-
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoord));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoord));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_diffuse1, TexCoord));
-
-    return (ambient + diffuse + specular);
-}
\ No newline at end of file
@@ -0,0 +1,11 @@
+// lokacije promenljivih izmedju stepena; ukljucuje se odmah posle #version.
+// glslang (tools/shader_compiler) prevodi svaki stepen posebno, pa u SPIR-V izlazi i
+// ulazi moraju imati iste lokacije; u GLSL 330 se vezuju po imenu i layout nije
+// dozvoljen. Lokacije su iste u svim shaderima:
+//   FragPos 0, Normal 1, TexCoords/TexCoord 2, TBN 3 (mat3, zauzima 3..5)
+#ifdef GL_SPIRV
+#extension GL_ARB_separate_shader_objects : enable
+#define LOCATION(n) layout (location = n)
+#else
+#define LOCATION(n)
+#endif
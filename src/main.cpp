@@ -10,9 +10,12 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <learnopengl/filesystem.h>
+#include <learnopengl/gl_state.h>
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/asset_streamer.h>
 
 #include <iostream>
 
@@ -26,9 +29,7 @@ void processInput(GLFWwindow *window);
 
 void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods);
 
-unsigned int loadTexture(char const *path, bool gammaCorrection);
-
-void setOurLights(Shader shader);
+void updateLights(UniformBuffer &lightsBuffer);
 
 void renderQuad();
 
@@ -47,7 +48,22 @@ bool spotLightOn = false;
 bool blinn = true;
 bool hdr= false;
 bool bloom= false;
+
+// bitovi varijanti sejdera, redom kao imena u ShaderVariants
+const unsigned int LIGHTING_BLINN = 1;
+const unsigned int LIGHTING_SPOT_LIGHT = 2;
+const unsigned int POST_HDR = 1;
+const unsigned int POST_BLOOM = 2;
+
+unsigned int lightingVariant(bool useBlinn)
+{
+        return (useBlinn ? LIGHTING_BLINN : 0) | (spotLightOn ? LIGHTING_SPOT_LIGHT : 0);
+}
+
 float exposure = 2.0f;
+// odsecanje klastera (meshleta) modela; C ukljucuje/iskljucuje radi poredjenja
+bool meshletCulling = true;
+ClusterStats clusterStats;
 
 glm::vec3 lightPosition(-15.0f, 4.3f, 2.6f);
 
@@ -66,7 +82,36 @@ struct ProgramState {
         PointLight pointLight;
         DirLight dirLight;
         SpotLight spotLight;
-        ProgramState() : camera(glm::vec3(0.0f, 0.0f, 3.0f)) {}
+        // nivo kvaliteta tekstura (QualityTier) i najveca dimenzija teksture
+        // (0 = kako nivo kaze); vaze od sledeceg pokretanja
+        int textureQuality = 0;
+        int maxTextureSize = 0;
+        ProgramState() : camera(glm::vec3(0.0f, 0.0f, 3.0f))
+        {
+                // direkciono svetlo
+                dirLight.direction = glm::vec3(0.0f, -1.0f, 0.0f);
+                dirLight.ambient = glm::vec3(0.05f);
+                dirLight.diffuse = glm::vec3(0.4f);
+                dirLight.specular = glm::vec3(0.4f);
+
+                // osobine pointlight svetla, pozicija je lightPosition
+                pointLight.ambient = glm::vec3(0.05f);
+                pointLight.diffuse = glm::vec3(0.8f);
+                pointLight.specular = glm::vec3(0.4f);
+                pointLight.constant = 1.0f;
+                pointLight.linear = 0.09f;
+                pointLight.quadratic = 0.032f;
+
+                // spotlight prati kameru
+                spotLight.ambient = glm::vec3(0.0f);
+                spotLight.diffuse = glm::vec3(1.0f);
+                spotLight.specular = glm::vec3(1.0f);
+                spotLight.constant = 1.0f;
+                spotLight.linear = 0.09f;
+                spotLight.quadratic = 0.032f;
+                spotLight.cutOff = glm::cos(glm::radians(12.5f));
+                spotLight.outerCutOff = glm::cos(glm::radians(15.0f));
+        }
 
         void saveToFile(std::string filename);
 
@@ -86,7 +131,9 @@ void ProgramState::saveToFile(std::string filename)
             << camera.Position.z << '\n'
             << camera.Front.x << '\n'
             << camera.Front.y << '\n'
-            << camera.Front.z << '\n';
+            << camera.Front.z << '\n'
+            << textureQuality << '\n'
+            << maxTextureSize << '\n';
 }
 
 //! Ucitavamo stanje iz fajla.
@@ -97,6 +144,12 @@ void ProgramState::loadFromFile(std::string filename)
                 in >> clearColor.r >> clearColor.g >> clearColor.b >> ImGuiEnabled >>
                     camera.Position.x >> camera.Position.y >> camera.Position.z >>
                     camera.Front.x >> camera.Front.y >> camera.Front.z;
+                // starije datoteke nemaju podesavanja tekstura
+                if (!(in >> textureQuality >> maxTextureSize) || textureQuality < 0 ||
+                    textureQuality >= QUALITY_TIERS) {
+                        textureQuality = 0;
+                        maxTextureSize = 0;
+                }
         }
 }
 
@@ -104,8 +157,6 @@ ProgramState *programState;
 
 void drawImGui(ProgramState *programState);
 
-unsigned int loadCubemap(vector<string> vector1);
-
 int main()
 {
         // glfw: initialize and configure
@@ -143,9 +194,12 @@ int main()
                 return -1;
         }
 
-        // tell stb_image.h to flip loaded texture's on the y-axis (before loading
-        // model).
-        stbi_set_flip_vertically_on_load(true);
+        // ako postoji resources.pack (pravi ga asset_cooker), resursi se citaju
+        // iz njega; bez njega, i za fajlove iz resources/ menjane posle pakovanja,
+        // citaju se fajlovi iz resources/
+        if (ResourcePack::instance().open(FileSystem::getPath("resources.pack")))
+                std::cout << "RESOURCE_PACK:: " << ResourcePack::instance().size()
+                          << " files" << std::endl;
 
         programState = new ProgramState;
         programState->loadFromFile("resources/program_state.txt");
@@ -161,42 +215,119 @@ int main()
         ImGui_ImplGlfw_InitForOpenGL(window, true);
         ImGui_ImplOpenGL3_Init("#version 330 core");
 
-        // configure global opengl state
+        // configure global opengl state; sve promene stanja idu kroz GLState, koji
+        // ne salje drajveru ono sto je vec postavljeno. Pamti stanje konteksta niti
+        // koja ga prva pozove, pa mora biti ovde, pre AssetStreamer-a
         // -----------------------------
-        glEnable(GL_DEPTH_TEST);
+        GLState &glState = GLState::instance();
+        glState.enable(GL_DEPTH_TEST);
 
         // Face culling
-        glEnable(GL_CULL_FACE);
-        glCullFace(GL_BACK);
+        glState.enable(GL_CULL_FACE);
+        glState.cullFace(GL_BACK);
 
         // Blending
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glState.enable(GL_BLEND);
+        glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        // koji formati kompresije tekstura su podrzani
+        BlockCompression::detect();
+        // shaderi se kompajliraju paralelno, a linkovani programi se cuvaju u
+        // program_cache/ i ucitavaju u sledecem pokretanju umesto ponovnog kompajliranja
+        ShaderManager::instance().init((GLADloadproc)glfwGetProcAddress);
 
-        // build and compile shaders
+        // prevelike teksture se pri ucitavanju smanjuju na velicinu nivoa kvaliteta
+        TextureQuality::instance().set((QualityTier)programState->textureQuality,
+                                       programState->maxTextureSize);
+
+        // modeli i teksture se ucitavaju u pozadini; dok ne stignu, crtamo
+        // zamene (kutiju oko modela i teksturu 1x1)
+        // -----------
+        AssetStreamer streamer(window);
+
+        // modeli koriste sazet format verteksa (20 umesto 56 bajtova), koji
+        // dekodira modelLightingPacked.vs. On cita samo poziciju, normalu i
+        // koordinate teksture, pa se tangentni prostor ne salje na GPU
+        const AttributeMask modelAttributes = attributeBit(ATTRIBUTE_POSITION) |
+                                              attributeBit(ATTRIBUTE_NORMAL) |
+                                              attributeBit(ATTRIBUTE_TEXCOORDS);
+        Model myModel;
+        Model myModel2;
+        Model myModel3;
+        // rada se crta dva puta, svaka kopija pamti svoj nivo detalja
+        LodState daisyLod[2];
+        streamer.streamModel(myModel, "resources/objects/skull/12140_Skull_v3_L2.obj",
+                             VertexLayout::Packed, false, modelAttributes);
+        streamer.streamModel(myModel2,
+                             "resources/objects/daisy/10441_Daisy_v1_max2010_iteration-2.obj",
+                             VertexLayout::Packed, false, modelAttributes);
+        streamer.streamModel(myModel3, "resources/objects/book/ScrollBookCandle.obj",
+                             VertexLayout::Packed, false, modelAttributes);
+
+        TextureFormat colorFormat;
+        colorFormat.srgb = true;
+        colorFormat.clampAlpha = true;
+        colorFormat.compress = true;
+        unsigned int texture;
+        unsigned int transparentTexture;
+        streamer.streamTexture(texture, FileSystem::getPath("resources/textures/ophelia.jpg"),
+                               true, colorFormat);
+        streamer.streamTexture(transparentTexture,
+                               FileSystem::getPath("resources/textures/ghost.png"), false,
+                               colorFormat);
+
+        TextureFormat skyboxFormat;
+        skyboxFormat.srgb = true;
+        skyboxFormat.mipmaps = false;
+        skyboxFormat.compress = true;
+        unsigned int cubemapTexture;
+        streamer.streamCubemap(cubemapTexture,
+                               {FileSystem::getPath("resources/textures/right.jpg"),
+                                FileSystem::getPath("resources/textures/left.jpg"),
+                                FileSystem::getPath("resources/textures/top.jpg"),
+                                FileSystem::getPath("resources/textures/bottom.jpg"),
+                                FileSystem::getPath("resources/textures/front.jpg"),
+                                FileSystem::getPath("resources/textures/back.jpg")},
+                               skyboxFormat);
+
+        // build and compile shaders; greske se proveravaju tek pri prvom use()
         // -------------------------
-        Shader ourShader("resources/shaders/modelLighting.vs",
-                         "resources/shaders/modelLighting.fs");
+        // varijante se prave za svaku kombinaciju prekidaca, iskljucene
+        // mogucnosti se ne racunaju na GPU
+        ShaderVariants ourShaders("resources/shaders/modelLightingPacked.vs",
+                                  "resources/shaders/modelLighting.fs",
+                                  {"BLINN", "SPOT_LIGHT"});
         // shader za kocku
         Shader yellowShader("resources/shaders/yellow_light.vs",
                             "resources/shaders/yellow_light.fs");
         // dodajemo skybox shader
         Shader skyboxShader("resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
-        Shader textureShader("resources/shaders/texture.vs",
-                             "resources/shaders/texture.fs");
+        ShaderVariants textureShaders("resources/shaders/texture.vs",
+                                      "resources/shaders/texture.fs",
+                                      {"BLINN", "SPOT_LIGHT"}, [](Shader &shader) {
+                                              shader.setInt(
+                                                  UNIFORM("texture_diffuse1"), 0);
+                                      });
         // dodajemo shader za duhove
         Shader ghostShader("resources/shaders/ghost.vs", "resources/shaders/ghost.fs");
         // dodajemo shader za hdr i bloom
-        Shader hdrShader("resources/shaders/hdr.vs", "resources/shaders/hdr.fs");
+        ShaderVariants hdrShaders("resources/shaders/hdr.vs", "resources/shaders/hdr.fs",
+                                  {"HDR", "BLOOM"}, [](Shader &shader) {
+                                          shader.setInt(UNIFORM("hdrBuffer"), 0);
+                                          shader.setInt(UNIFORM("bloomBlur"), 1);
+                                  });
         Shader bloomShader("resources/shaders/bloom.vs", "resources/shaders/bloom.fs");
+        // kamera i svetla su u uniform blokovima zajednickim za sve programe; baferi
+        // su stalno vezani i pune se jednom po frejmu
+        UniformBuffer cameraBuffer(CAMERA_BLOCK_BINDING, sizeof(CameraBlock));
+        UniformBuffer lightsBuffer(LIGHTS_BLOCK_BINDING, sizeof(LightsBlock));
+        ourShaders.prepareAll();
+        textureShaders.prepare(LIGHTING_BLINN);
+        textureShaders.prepare(LIGHTING_BLINN | LIGHTING_SPOT_LIGHT);
+        hdrShaders.prepareAll();
+        ProgramBinaryCache::instance().report(std::cout);
 
 
-        // load models
-        // -----------
-        Model myModel("resources/objects/skull/12140_Skull_v3_L2.obj");
-        Model myModel2("resources/objects/daisy/10441_Daisy_v1_max2010_iteration-2.obj");
-        Model myModel3("resources/objects/book/ScrollBookCandle.obj");
-
         myModel.SetShaderTextureNamePrefix("material.");
         myModel2.SetShaderTextureNamePrefix("material.");
         myModel3.SetShaderTextureNamePrefix("material.");
@@ -225,7 +356,7 @@ int main()
         unsigned int skyboxVAO, skyboxVBO;
         glGenVertexArrays(1, &skyboxVAO);
         glGenBuffers(1, &skyboxVBO);
-        glBindVertexArray(skyboxVAO);
+        glState.bindVertexArray(skyboxVAO);
         glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices,
                      GL_STATIC_DRAW);
@@ -279,7 +410,7 @@ int main()
         glGenVertexArrays(1, &VAO_cube);
         glGenBuffers(1, &VBO_cube);
 
-        glBindVertexArray(VAO_cube);
+        glState.bindVertexArray(VAO_cube);
         glBindBuffer(GL_ARRAY_BUFFER, VBO_cube);
         glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
@@ -297,7 +428,7 @@ int main()
         glGenVertexArrays(1, &VAO_texture);
         glGenBuffers(1, &VBO_texture);
 
-        glBindVertexArray(VAO_texture);
+        glState.bindVertexArray(VAO_texture);
         glBindBuffer(GL_ARRAY_BUFFER, VBO_texture);
         glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
@@ -310,12 +441,6 @@ int main()
                               (void *)(5 * sizeof(float)));
         glEnableVertexAttribArray(2);
 
-        stbi_set_flip_vertically_on_load(true);
-        unsigned int texture =
-            loadTexture(FileSystem::getPath("resources/textures/ophelia.jpg").c_str(), true);
-        stbi_set_flip_vertically_on_load(false);
-        textureShader.use();
-        textureShader.setInt("texture_diffuse1", 0);
          float transparentVertices[] = {
             // positions         // koordiante tekstura
             0.0f,  0.5f,  0.0f,  0.0f,  0.0f,
@@ -330,14 +455,14 @@ int main()
         unsigned int transparentVAO, transparentVBO;
         glGenVertexArrays(1, &transparentVAO);
         glGenBuffers(1, &transparentVBO);
-        glBindVertexArray(transparentVAO);
+        glState.bindVertexArray(transparentVAO);
         glBindBuffer(GL_ARRAY_BUFFER, transparentVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(transparentVertices), transparentVertices, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
         glEnableVertexAttribArray(1);
         glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-        glBindVertexArray(0);
+        glState.bindVertexArray(0);
         vector<glm::vec3> ghosts
             {
                     glm::vec3(-15.3f, -50.5f, -44.45f),
@@ -346,46 +471,28 @@ int main()
                     glm::vec3(-68.58f, -35.65f, -14.57f),
                     glm::vec3(-85.34f, -24.86f, -25.67f)
             };
-        unsigned int transparentTexture = loadTexture(FileSystem::getPath("resources/textures/ghost.png").c_str(), true);
-        stbi_set_flip_vertically_on_load(true);
         ghostShader.use();
-        ghostShader.setInt("texture1", 0);
-
-        // ucitavanje skybox modela
-
-        stbi_set_flip_vertically_on_load(false);
-        vector<std::string> faces{FileSystem::getPath("resources/textures/right.jpg"),
-                                  FileSystem::getPath("resources/textures/left.jpg"),
-                                  FileSystem::getPath("resources/textures/top.jpg"),
-                                  FileSystem::getPath("resources/textures/bottom.jpg"),
-                                  FileSystem::getPath("resources/textures/front.jpg"),
-                                  FileSystem::getPath("resources/textures/back.jpg")};
-
-        unsigned int cubemapTexture = loadCubemap(faces);
+        ghostShader.setInt(UNIFORM("texture1"), 0);
 
         skyboxShader.use();
-        skyboxShader.setInt("skybox", 0);
+        skyboxShader.setInt(UNIFORM("skybox"), 0);
 
         // draw in wireframe
         // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
         bloomShader.use();
-        bloomShader.setInt("image", 0);
-
-        hdrShader.use();
-        hdrShader.setInt("hdrBuffer", 0);
-        hdrShader.setInt("bloomBlur", 1);
+        bloomShader.setInt(UNIFORM("image"), 0);
 
         //  hdr
         unsigned int hdrFBO;
         glGenFramebuffers(1, &hdrFBO);
-        glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
+        glState.bindFramebuffer(hdrFBO);
 
         unsigned int colorBuffers[2];
         glGenTextures(2, colorBuffers);
         for (unsigned int i = 0; i < 2; i++)
         {
-            glBindTexture(GL_TEXTURE_2D, colorBuffers[i]);
+            glState.bindTexture(GL_TEXTURE_2D, colorBuffers[i]);
             glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -407,7 +514,7 @@ int main()
         glDrawBuffers(2, attachments);
         if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
             std::cout << "Framebuffer not complete!" << std::endl;
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glState.bindFramebuffer(0);
 
 
         // pingpong frejmbafer za blur
@@ -417,8 +524,8 @@ int main()
         glGenTextures(2, pingpongColorbuffers);
         for (unsigned int i = 0; i < 2; i++)
         {
-            glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
-            glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[i]);
+            glState.bindFramebuffer(pingpongFBO[i]);
+            glState.bindTexture(GL_TEXTURE_2D, pingpongColorbuffers[i]);
             glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -429,6 +536,9 @@ int main()
                 std::cout << "Framebuffer not complete!" << std::endl;
         }
 
+        // red crtanja scene, prazni se jednom po prolazu
+        RenderQueue renderQueue;
+
         // render loop
         // -----------
         while (!glfwWindowShouldClose(window)) {
@@ -442,6 +552,9 @@ int main()
                 // -----
                 processInput(window);
 
+                // zamenjujemo placeholder-e resursima koji su u meduvremenu stigli
+                streamer.poll();
+
                 // render
                 // ------
                 glClearColor(programState->clearColor.r, programState->clearColor.g,
@@ -449,22 +562,37 @@ int main()
                 glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
                 // dodajemo hdr frejmbafer
-                glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
+                glState.bindFramebuffer(hdrFBO);
                 glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-                // don't forget to enable shader before setting uniforms
-                ourShader.use();
-                setOurLights(ourShader);
-
-                // view/projection transformations
+                // view/projection transformations, za sve programe odjednom
                 glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
                                                     (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
                 glm::mat4 view = programState->camera.GetViewMatrix();
-                ourShader.setMat4("projection", projection);
-                ourShader.setMat4("view", view);
-                ourShader.setInt("blinn", blinn);
+                CameraBlock cameraBlock = {};
+                cameraBlock.projection = projection;
+                cameraBlock.view = view;
+                cameraBlock.viewPos = programState->camera.Position;
+                cameraBuffer.update(cameraBlock);
+                updateLights(lightsBuffer);
+
+                // sve sto se crta u sceni ide u red, a red odlucuje o redosledu:
+                // neprozirno po stanju pa od blizeg ka daljem, nebo, pa providno od
+                // daljeg ka blizem
+                renderQueue.begin(view, 100.0f);
+
+                Shader &ourShader = ourShaders.use(lightingVariant(blinn));
+                // nivo detalja modela se bira prema gresci projektovanoj na ekran,
+                // a klasteri van kadra ili okrenuti od kamere se ne crtaju
+                RenderView renderView(programState->camera, projection, view,
+                                      (float) SCR_HEIGHT);
+                renderView.cullClusters = meshletCulling;
+                clusterStats = ClusterStats();
+                renderView.stats = &clusterStats;
 
                 // render the loaded model
+                RenderItem item;
+                item.shader = &ourShader;
                 glm::mat4 model = glm::mat4(1.0f);
                 model = glm::translate(
                     model,
@@ -472,289 +600,114 @@ int main()
                         -7.0f, -0.13f,
                         -0.5f)); // translate it down so it's at the center of the scene
                 model = glm::rotate(model, glm::radians(270.0f), glm::vec3(1, 0, 0));
-                model = glm::scale(
+                item.model = glm::scale(
                     model,
                     glm::vec3(programState->skullScale)); // it's a bit too big for our
                                                           // scene, so scale it down
-                ourShader.setMat4("model", model);
-                myModel.Draw(ourShader);
+                item.draw = [&](Shader &shader, const glm::mat4 &m) {
+                        myModel.Draw(shader, m, renderView);
+                };
+                renderQueue.submit(item);
+
                 // renderuj prvu belu radu
-                glm::mat4 model2 = glm::mat4(1.0f);
-                model2 = glm::translate(model2, glm::vec3(-9.0, 0.27f, -1.0f));
-                model2 = glm::rotate(model2, glm::radians(0.0f), glm::vec3(1, 0, 1));
-                model2 = glm::scale(model2, glm::vec3(0.20f));
-                ourShader.setMat4("model", model2);
-                myModel2.Draw(ourShader);
+                model = glm::translate(glm::mat4(1.0f), glm::vec3(-9.0, 0.27f, -1.0f));
+                item.model = glm::scale(model, glm::vec3(0.20f));
+                item.draw = [&](Shader &shader, const glm::mat4 &m) {
+                        myModel2.Draw(shader, m, renderView, daisyLod[0]);
+                };
+                renderQueue.submit(item);
 
                 // renderuj drugu belu radu
-                glm::mat4 model3 = glm::mat4(1.0f);
-                model3 = glm::translate(model3, glm::vec3(-9.2, 0.27f, -1.0f));
-                model3 = glm::rotate(model3, glm::radians(0.0f), glm::vec3(1, 0, 1));
-                model3 = glm::scale(model3, glm::vec3(0.20f));
-                ourShader.setMat4("model", model3);
-                myModel2.Draw(ourShader);
+                model = glm::translate(glm::mat4(1.0f), glm::vec3(-9.2, 0.27f, -1.0f));
+                item.model = glm::scale(model, glm::vec3(0.20f));
+                item.draw = [&](Shader &shader, const glm::mat4 &m) {
+                        myModel2.Draw(shader, m, renderView, daisyLod[1]);
+                };
+                renderQueue.submit(item);
 
                 // renderujemo i poslednji model-book, candle, scroll
-                glm::mat4 model4 = glm::mat4(1.0f);
-                model4 = glm::translate(model4, glm::vec3(-15.0, -0.35f, -1.0f));
-                model4 = glm::rotate(model4, glm::radians(0.0f), glm::vec3(1, 0, 1));
-                model4 = glm::scale(model4, glm::vec3(0.1f));
-                ourShader.setMat4("model", model4);
-                myModel3.Draw(ourShader);
-
-                glDisable(GL_CULL_FACE);
-
-                //ghosts (blending)
-                ghostShader.use();
-                ghostShader.setMat4("projection",projection);
-                ghostShader.setMat4("view",view);
-                glBindVertexArray(transparentVAO);
-                glActiveTexture(GL_TEXTURE0);
-                glBindTexture(GL_TEXTURE_2D, transparentTexture);
-                for (const glm::vec3& g : ghosts)
-                {
-                    model = glm::mat4(1.0f);
-                    model = glm::translate(model, g);
-                    model = glm::scale(model,glm::vec3(10.0f));
-                    ghostShader.setMat4("model", model);
-                    glDrawArrays(GL_TRIANGLES, 0, 6);
+                model = glm::translate(glm::mat4(1.0f), glm::vec3(-15.0, -0.35f, -1.0f));
+                item.model = glm::scale(model, glm::vec3(0.1f));
+                item.draw = [&](Shader &shader, const glm::mat4 &m) {
+                        myModel3.Draw(shader, m, renderView);
+                };
+                renderQueue.submit(item);
+
+                // zute kocke (bloom), vide se sa obe strane
+                static const float yellowCubes[][4] = {
+                        {-6.9f, 3.7f, -4.0f, 0.5f}, {-7.2f, 3.7f, -3.2f, 0.4f},
+                        {-6.7f, 4.5f, -4.0f, 0.4f}, {-7.2f, 4.0f, -5.8f, 0.4f},
+                        {-7.2f, 3.7f, -2.2f, 0.3f}, {-6.7f, 5.3f, -4.0f, 0.3f},
+                        {-7.2f, 4.0f, -6.8f, 0.3f}, {-6.7f, 6.1f, -4.0f, 0.2f},
+                        {-7.2f, 4.0f, -7.6f, 0.2f}, {-7.2f, 3.7f, -1.4f, 0.2f},
+                        {-7.4f, 4.4f, -3.7f, 0.4f}, {-7.9f, 5.0f, -3.2f, 0.3f},
+                        {-8.3f, 5.4f, -2.8f, 0.2f}, {-6.0f, 4.4f, -4.3f, 0.4f},
+                        {-5.5f, 5.0f, -4.7f, 0.3f}, {-5.3f, 5.4f, -5.1f, 0.2f},
+                };
+                float bob = sin(glfwGetTime()) * 1 / 3;
+                item = RenderItem();
+                item.shader = &yellowShader;
+                item.vertexArray = VAO_cube;
+                item.cullFaces = false;
+                item.draw = [](Shader &, const glm::mat4 &) {
+                        glDrawArrays(GL_TRIANGLES, 0, 36);
+                };
+                for (const float *cube : yellowCubes) {
+                        glm::vec3 position(cube[0], cube[1] + bob, cube[2]);
+                        item.model = glm::scale(glm::translate(glm::mat4(1.0f), position),
+                                                glm::vec3(cube[3]));
+                        renderQueue.submit(item);
                 }
-                yellowShader.use();
-
-                // matrice transformacija: view, projection
-                yellowShader.setMat4("projection", projection);
-                yellowShader.setMat4("view", view);
-
-                // model matrica i render kocke
-                glm::mat4 yellowModel = glm::mat4(1.0f);
-                yellowModel = glm::translate(
-                    yellowModel,
-                    glm::vec3(-6.9f, 3.7f + sin(glfwGetTime()) * 1 / 3, -4.0f));
-                yellowModel = glm::scale(yellowModel, glm::vec3(0.5, 0.5, 0.5));
-                yellowShader.setMat4("model", yellowModel);
-
-                glBindVertexArray(VAO_cube);
-                glDrawArrays(GL_TRIANGLES, 0, 36);
-
-                // model matrica i render kocke
-
-                glm::mat4 yellowModel1 = glm::mat4(1.0f);
-                yellowModel1 = glm::translate(
-                    yellowModel1,
-                    glm::vec3(-7.2f, 3.7f + sin(glfwGetTime()) * 1 / 3, -3.2f));
-                yellowModel1 = glm::scale(yellowModel1, glm::vec3(0.4, 0.4, 0.4));
-                yellowShader.setMat4("model", yellowModel1);
-
-                glBindVertexArray(VAO_cube);
-                glDrawArrays(GL_TRIANGLES, 0, 36);
-
-                // model matrica i render kocke
-
-                glm::mat4 yellowModel2 = glm::mat4(1.0f);
-                yellowModel2 = glm::translate(
-                    yellowModel2,
-                    glm::vec3(-6.7f, 4.5f + sin(glfwGetTime()) * 1 / 3, -4.0f));
-                yellowModel2 = glm::scale(yellowModel2, glm::vec3(0.4, 0.4, 0.4));
-                yellowShader.setMat4("model", yellowModel2);
-
-                glBindVertexArray(VAO_cube);
-                glDrawArrays(GL_TRIANGLES, 0, 36);
-
-                // model matrica i render kocke
-                glm::mat4 yellowModel3 = glm::mat4(1.0f);
-                yellowModel3 = glm::translate(
-                    yellowModel3,
-                    glm::vec3(-7.2f, 4.0f + sin(glfwGetTime()) * 1 / 3, -5.8f));
-                yellowModel3 = glm::scale(yellowModel3, glm::vec3(0.4, 0.4, 0.4));
-                yellowShader.setMat4("model", yellowModel3);
-
-                glBindVertexArray(VAO_cube);
-                glDrawArrays(GL_TRIANGLES, 0, 36);
-
-                // model matrica i render kocke
-
-                glm::mat4 yellowModel4 = glm::mat4(1.0f);
-                yellowModel4 = glm::translate(
-                    yellowModel4,
-                    glm::vec3(-7.2f, 3.7f + sin(glfwGetTime()) * 1 / 3, -2.2f));
-                yellowModel4 = glm::scale(yellowModel4, glm::vec3(0.3, 0.3, 0.3));
-                yellowShader.setMat4("model", yellowModel4);
-
-                glBindVertexArray(VAO_cube);
-                glDrawArrays(GL_TRIANGLES, 0, 36);
-
-                // model matrica i render kocke
-
-                glm::mat4 yellowModel5 = glm::mat4(1.0f);
-                yellowModel5 = glm::translate(
-                    yellowModel5,
-                    glm::vec3(-6.7f, 5.3f + sin(glfwGetTime()) * 1 / 3, -4.0f));
-                yellowModel5 = glm::scale(yellowModel5, glm::vec3(0.3, 0.3, 0.3));
-                yellowShader.setMat4("model", yellowModel5);
-
-                glBindVertexArray(VAO_cube);
-                glDrawArrays(GL_TRIANGLES, 0, 36);
-
-                // model matrica i render kocke
-                glm::mat4 yellowModel6 = glm::mat4(1.0f);
-                yellowModel6 = glm::translate(
-                    yellowModel6,
-                    glm::vec3(-7.2f, 4.0f + sin(glfwGetTime()) * 1 / 3, -6.8f));
-                yellowModel6 = glm::scale(yellowModel6, glm::vec3(0.3, 0.3, 0.3));
-                yellowShader.setMat4("model", yellowModel6);
-
-                glBindVertexArray(VAO_cube);
-                glDrawArrays(GL_TRIANGLES, 0, 36);
-
-                // model matrica i render kocke
-                glm::mat4 yellowModel8 = glm::mat4(1.0f);
-                yellowModel8 = glm::translate(
-                    yellowModel8,
-                    glm::vec3(-6.7f, 6.1f + sin(glfwGetTime()) * 1 / 3, -4.0f));
-                yellowModel8 = glm::scale(yellowModel8, glm::vec3(0.2, 0.2, 0.2));
-                yellowShader.setMat4("model", yellowModel8);
-
-                glBindVertexArray(VAO_cube);
-                glDrawArrays(GL_TRIANGLES, 0, 36);
-
-                // model matrica i render kocke
-                glm::mat4 yellowModel9 = glm::mat4(1.0f);
-                yellowModel9 = glm::translate(
-                    yellowModel9,
-                    glm::vec3(-7.2f, 4.0f + sin(glfwGetTime()) * 1 / 3, -7.6f));
-                yellowModel9 = glm::scale(yellowModel9, glm::vec3(0.2, 0.2, 0.2));
-                yellowShader.setMat4("model", yellowModel9);
-
-                glBindVertexArray(VAO_cube);
-                glDrawArrays(GL_TRIANGLES, 0, 36);
-
-                // model matrica i render kocke
-                glm::mat4 yellowModel10 = glm::mat4(1.0f);
-                yellowModel10 = glm::translate(
-                    yellowModel10,
-                    glm::vec3(-7.2f, 3.7f + sin(glfwGetTime()) * 1 / 3, -1.4f));
-                yellowModel10 = glm::scale(yellowModel10, glm::vec3(0.2, 0.2, 0.2));
-                yellowShader.setMat4("model", yellowModel10);
-
-                glBindVertexArray(VAO_cube);
-                glDrawArrays(GL_TRIANGLES, 0, 36);
-
-                // model matrica i render kocke
-                glm::mat4 yellowModel11 = glm::mat4(1.0f);
-                yellowModel11 = glm::translate(
-                    yellowModel11,
-                    glm::vec3(-7.4f, 4.4f + sin(glfwGetTime()) * 1 / 3, -3.7f));
-                yellowModel11 = glm::scale(yellowModel11, glm::vec3(0.4, 0.4, 0.4));
-                yellowShader.setMat4("model", yellowModel11);
-
-                glBindVertexArray(VAO_cube);
-                glDrawArrays(GL_TRIANGLES, 0, 36);
-
-                // model matrica i render kocke
-                glm::mat4 yellowModel12 = glm::mat4(1.0f);
-                yellowModel12 = glm::translate(
-                    yellowModel12,
-                    glm::vec3(-7.9f, 5.0f + sin(glfwGetTime()) * 1 / 3, -3.2f));
-                yellowModel12 = glm::scale(yellowModel12, glm::vec3(0.3, 0.3, 0.3));
-                yellowShader.setMat4("model", yellowModel12);
-
-                glBindVertexArray(VAO_cube);
-                glDrawArrays(GL_TRIANGLES, 0, 36);
-
-                // model matrica i render kocke
-                glm::mat4 yellowModel13 = glm::mat4(1.0f);
-                yellowModel13 = glm::translate(
-                    yellowModel13,
-                    glm::vec3(-8.3f, 5.4f + sin(glfwGetTime()) * 1 / 3, -2.8f));
-                yellowModel13 = glm::scale(yellowModel13, glm::vec3(0.2, 0.2, 0.2));
-                yellowShader.setMat4("model", yellowModel13);
-
-                glBindVertexArray(VAO_cube);
-                glDrawArrays(GL_TRIANGLES, 0, 36);
-
-                // model matrica i render kocke
-                glm::mat4 yellowModel14 = glm::mat4(1.0f);
-                yellowModel14 = glm::translate(
-                    yellowModel14,
-                    glm::vec3(-6.0f, 4.4f + sin(glfwGetTime()) * 1 / 3, -4.3f));
-                yellowModel14 = glm::scale(yellowModel14, glm::vec3(0.4, 0.4, 0.4));
-                yellowShader.setMat4("model", yellowModel14);
-
-                glBindVertexArray(VAO_cube);
-                glDrawArrays(GL_TRIANGLES, 0, 36);
-
-                // model matrica i render kocke
-                glm::mat4 yellowModel15 = glm::mat4(1.0f);
-                yellowModel15 = glm::translate(
-                    yellowModel15,
-                    glm::vec3(-5.5f, 5.0f + sin(glfwGetTime()) * 1 / 3, -4.7f));
-                yellowModel15 = glm::scale(yellowModel15, glm::vec3(0.3, 0.3, 0.3));
-                yellowShader.setMat4("model", yellowModel15);
-
-                glBindVertexArray(VAO_cube);
-                glDrawArrays(GL_TRIANGLES, 0, 36);
-
-                // model matrica i render kocke
-                glm::mat4 yellowModel16 = glm::mat4(1.0f);
-                yellowModel16 = glm::translate(
-                    yellowModel16,
-                    glm::vec3(-5.3f, 5.4f + sin(glfwGetTime()) * 1 / 3, -5.1f));
-                yellowModel16 = glm::scale(yellowModel16, glm::vec3(0.2, 0.2, 0.2));
-                yellowShader.setMat4("model", yellowModel16);
-
-                glBindVertexArray(VAO_cube);
-                glDrawArrays(GL_TRIANGLES, 0, 36);
-
-                glEnable(GL_CULL_FACE);
-                // kocka sa teksturama
-                glActiveTexture(GL_TEXTURE0);
-                glBindTexture(GL_TEXTURE_2D, texture);
-
-                textureShader.use();
-                setOurLights(textureShader);
-
-                // matrice transformacija: view, projection
-                textureShader.setMat4("projection", projection);
-                textureShader.setMat4("view", view);
-
-                // model matrica i render kocke sa teksturom
-                glm::mat4 textureModel = glm::mat4(1.0f);
-                textureModel =
-                    glm::translate(textureModel, glm::vec3(-4.5f, 1.0f, 1.0f));
-                textureModel = glm::scale(textureModel, glm::vec3(2.0, 2.0, 2.0));
-                textureShader.setMat4("model", textureModel);
-
-
-                glBindVertexArray(VAO_texture);
-                glDrawArrays(GL_TRIANGLES, 0, 36);
-
-                // skybox sa matricama transformacije
-                glDepthMask(GL_LEQUAL > 0 ? GL_TRUE : GL_FALSE);
-
-                skyboxShader.use();
-                // matrice transformacije: view, projection ( + uklanjanje translacije
-                // iz matrice pogleda)
-                view = glm::mat4(glm::mat3(programState->camera.GetViewMatrix()));
-                skyboxShader.setMat4("view", view);
-                skyboxShader.setMat4("projection", projection);
-
-                glBindVertexArray(skyboxVAO);
-                glActiveTexture(GL_TEXTURE0);
-                glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-                glDrawArrays(GL_TRIANGLES, 0, 36);
-                glBindVertexArray(0);
-                glDepthMask(GL_LESS > 0 ? GL_TRUE : GL_FALSE);
+
+                // kocka sa teksturama; uvek se senci Blin-Fongom
+                item.shader = &textureShaders.use(lightingVariant(true));
+                item.vertexArray = VAO_texture;
+                item.texture = texture;
+                item.cullFaces = true;
+                model = glm::translate(glm::mat4(1.0f), glm::vec3(-4.5f, 1.0f, 1.0f));
+                item.model = glm::scale(model, glm::vec3(2.0, 2.0, 2.0));
+                renderQueue.submit(item);
+
+                // skybox; translaciju iz matrice pogleda uklanja skybox.vs, a red
+                // ga crta sa GL_LEQUAL jer ga skybox.vs stavlja na dubinu 1.0
+                item.pass = RenderPass::Sky;
+                item.shader = &skyboxShader;
+                item.vertexArray = skyboxVAO;
+                item.texture = cubemapTexture;
+                item.textureTarget = GL_TEXTURE_CUBE_MAP;
+                item.model = glm::mat4(1.0f);
+                renderQueue.submit(item);
+
+                //ghosts (blending), posle neba da bi se stapali i sa njim
+                item.pass = RenderPass::Transparent;
+                item.shader = &ghostShader;
+                item.vertexArray = transparentVAO;
+                item.texture = transparentTexture;
+                item.textureTarget = GL_TEXTURE_2D;
+                item.cullFaces = false;
+                item.draw = [](Shader &, const glm::mat4 &) {
+                        glDrawArrays(GL_TRIANGLES, 0, 6);
+                };
+                for (const glm::vec3& g : ghosts) {
+                        item.model = glm::scale(glm::translate(glm::mat4(1.0f), g),
+                                                glm::vec3(10.0f));
+                        renderQueue.submit(item);
+                }
+
+                renderQueue.flush(RenderPass::Opaque);
+                renderQueue.flush(RenderPass::Sky);
+                renderQueue.flush(RenderPass::Transparent);
+                glState.enable(GL_CULL_FACE);
 
                 // ucitavanje pingpong bafera
-                glBindFramebuffer(GL_FRAMEBUFFER, 0);
                 bool horizontal = true, first_iteration = true;
                 unsigned int amount = 3;
                 bloomShader.use();
                 for (unsigned int i = 0; i < amount; i++)
                 {
-                    glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
-                    bloomShader.setInt("horizontal", horizontal);
-                    glBindTexture(GL_TEXTURE_2D, first_iteration ? colorBuffers[1] : pingpongColorbuffers[!horizontal]);
+                    glState.bindFramebuffer(pingpongFBO[horizontal]);
+                    bloomShader.setInt(UNIFORM("horizontal"), horizontal);
+                    glState.bindTexture(0, GL_TEXTURE_2D, first_iteration ? colorBuffers[1] : pingpongColorbuffers[!horizontal]);
 
                     renderQuad();
 
@@ -764,20 +717,21 @@ int main()
                 }
 
                 // ucitaj hdr i bloom
-                glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                glState.bindFramebuffer(0);
                 glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-                hdrShader.use();
-                glActiveTexture(GL_TEXTURE0);
-                glBindTexture(GL_TEXTURE_2D, colorBuffers[0]);
-                glActiveTexture(GL_TEXTURE1);
-                glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
-                hdrShader.setBool("hdr", hdr);
-                hdrShader.setBool("bloom",bloom);
-                hdrShader.setFloat("exposure", exposure);
+                Shader &hdrShader = hdrShaders.use((hdr ? POST_HDR : 0) |
+                                                   (bloom ? POST_BLOOM : 0));
+                glState.bindTexture(0, GL_TEXTURE_2D, colorBuffers[0]);
+                glState.bindTexture(1, GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
+                hdrShader.setFloat(UNIFORM("exposure"), exposure);
                 renderQuad();
 
-                if (programState->ImGuiEnabled)
+                // ImGui menja stanje mimo GLState-a
+                glState.endFrame();
+                if (programState->ImGuiEnabled) {
                         drawImGui(programState);
+                        glState.invalidate();
+                }
                 // glfw: swap buffers and poll IO events (keys pressed/released, mouse
                 // moved etc.)
                 // -------------------------------------------------------------------------------
@@ -785,6 +739,14 @@ int main()
                 glfwPollEvents();
         }
 
+        streamer.shutdown();
+        // modeli i teksture oslobadjaju svoje reference u kesu tekstura
+        myModel.release();
+        myModel2.release();
+        myModel3.release();
+        TextureCache::instance().release(texture);
+        TextureCache::instance().release(transparentTexture);
+        TextureCache::instance().release(cubemapTexture);
         programState->saveToFile("resources/program_state.txt");
         delete programState;
         ImGui_ImplOpenGL3_Shutdown();
@@ -819,7 +781,7 @@ void renderQuad()
         // pravimo VAO
         glGenVertexArrays(1, &quadVAO);
         glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
+        GLState::instance().bindVertexArray(quadVAO);
         glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
@@ -828,48 +790,22 @@ void renderQuad()
         glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
     }
 
-    glBindVertexArray(quadVAO);
+    GLState::instance().bindVertexArray(quadVAO);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
 }
 
-void setOurLights(Shader shader){
-        shader.setVec3("light.position", lightPosition);
-        shader.setVec3("viewPos", programState->camera.Position);
-
-        // direkciono svetlo
-        shader.setVec3("dirLight.direction", 0.0f, -1.0, 0.0f);
-        shader.setVec3("dirLight.ambient", 0.05f, 0.05f, 0.05f);
-        shader.setVec3("dirLight.diffuse", 0.4f, 0.4f, 0.4f);
-        shader.setVec3("dirLight.specular", 0.4f, 0.4f, 0.4f);
-
-        // osobine pointlight svetla
-        shader.setVec3("pointLights[0].position", lightPosition);
-        shader.setVec3("pointLights[0].ambient", 0.05f, 0.05f, 0.05f);
-        shader.setVec3("pointLights[0].diffuse", 0.8f, 0.8f, 0.8f);
-        shader.setVec3("pointLights[0].specular", 0.4f, 0.4f, 0.4f);
-        shader.setFloat("pointLights[0].constant", 1.0f);
-        shader.setFloat("pointLights[0].linear", 0.09f);
-        shader.setFloat("pointLights[0].quadratic", 0.032f);
-
-        // spotLight
-        shader.setVec3("spotLight.position", programState->camera.Position);
-        shader.setVec3("spotLight.direction", programState->camera.Front);
-        shader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-
-        if(spotLightOn){
-            shader.setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
-            shader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
-        }else{
-            shader.setVec3("spotLight.diffuse", 0.0f, 0.0f, 0.0f);
-            shader.setVec3("spotLight.specular", 0.0f, 0.0f, 0.0f);
-        }
-
-        shader.setFloat("spotLight.constant", 1.0f);
-        shader.setFloat("spotLight.linear", 0.09f);
-        shader.setFloat("spotLight.quadratic", 0.032f);
-        shader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-        shader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
+// spot svetlo prati kameru; dok kamera miruje blok se ne salje ponovo
+void updateLights(UniformBuffer &lightsBuffer)
+{
+        programState->pointLight.position = lightPosition;
+        programState->spotLight.position = programState->camera.Position;
+        programState->spotLight.direction = programState->camera.Front;
+
+        LightsBlock lights = {};
+        lights.dirLight = DirLightBlock(programState->dirLight);
+        lights.pointLights[0] = PointLightBlock(programState->pointLight);
+        lights.spotLight = SpotLightBlock(programState->spotLight);
+        lightsBuffer.update(lights);
 }
 
 // process all input: query GLFW whether relevant keys are pressed/released this
@@ -952,6 +888,10 @@ void drawImGui(ProgramState *programState)
                                  0.05, 0.0, 1.0);
                 ImGui::DragFloat("pointLight.quadratic",
                                  &programState->pointLight.quadratic, 0.05, 0.0, 1.0);
+                ImGui::Combo("Texture quality (restart)", &programState->textureQuality,
+                             "full\0high (2048)\0medium (1024)\0low (512)\0");
+                ImGui::InputInt("Max texture size (0 = tier)",
+                                &programState->maxTextureSize);
                 ImGui::End();
         }
 
@@ -968,6 +908,27 @@ void drawImGui(ProgramState *programState)
                 ImGui::End();
         }
 
+        {
+                ImGui::Begin("Meshlet culling");
+                ImGui::Checkbox("Enabled (C)", &meshletCulling);
+                ImGui::Text("Clusters: %zu / %zu", clusterStats.visibleClusters,
+                            clusterStats.clusters);
+                ImGui::Text("Triangles: %zu / %zu", clusterStats.visibleTriangles,
+                            clusterStats.triangles);
+                ImGui::Text("Draw calls: %zu", clusterStats.drawCalls);
+                ImGui::Text("Cull time: %.3f ms", clusterStats.cullTime);
+                ImGui::End();
+        }
+
+        {
+                // pozivi promene stanja u proslom frejmu, bez samog ImGui-ja
+                const GLState::Stats &stats = GLState::instance().lastFrame();
+                ImGui::Begin("GL state");
+                ImGui::Text("Calls: %zu", stats.issued);
+                ImGui::Text("Elided: %zu", stats.elided);
+                ImGui::End();
+        }
+
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
@@ -1010,6 +971,10 @@ void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods
             bloom!=bloom;
         }
 
+        if (key == GLFW_KEY_C && action == GLFW_PRESS){
+            meshletCulling = !meshletCulling;
+        }
+
         if (key == GLFW_KEY_H && action == GLFW_PRESS){
             hdr= !hdr;
         }
@@ -1022,82 +987,3 @@ void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods
             exposure-=0.2f;
         }
 }
-
-//! Funkcija za ucitavanje tekstura iz skyboxa
-unsigned int loadCubemap(vector<std::string> faces)
-{
-        unsigned int textureID;
-        glGenTextures(1, &textureID);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-        int width, height, nrChannels;
-        for (unsigned int i = 0; i < faces.size(); i++) {
-                unsigned char *data =
-                    stbi_load((faces[i].c_str()), &width, &height, &nrChannels, 0);
-                if (data) {
-                        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_SRGB,
-                                     width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-                } else {
-                        std::cout
-                            << "Cubemap texture failed to load at path: " << faces[i]
-                            << std::endl;
-                        stbi_image_free(data);
-                }
-                stbi_image_free(data);
-        }
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-        return textureID;
-}
-
-// ucitavanje tekstura za kocku
-unsigned int loadTexture(char const *path, bool gammaCorrection)
-{
-        unsigned int textureID;
-        glGenTextures(1, &textureID);
-
-        int width, height, nrComponents;
-        unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-        if (data) {
-                GLenum format;
-                GLenum iternal;
-                if (nrComponents == 1)
-                        format = GL_RED;
-                else if (nrComponents == 3) {
-                        format = GL_RGB;
-                        iternal = gammaCorrection ? GL_SRGB : GL_RGB;
-                } else if (nrComponents == 4) {
-                        iternal = gammaCorrection ? GL_SRGB_ALPHA : GL_RGBA;
-                        format = GL_RGBA;
-                }
-
-                glBindTexture(GL_TEXTURE_2D, textureID);
-                glTexImage2D(GL_TEXTURE_2D, 0, iternal, width, height, 0, format,
-                             GL_UNSIGNED_BYTE, data);
-                glGenerateMipmap(GL_TEXTURE_2D);
-
-                glTexParameteri(
-                    GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,
-                    format == GL_RGBA
-                        ? GL_CLAMP_TO_EDGE
-                        : GL_REPEAT); // for this tutorial: use GL_CLAMP_TO_EDGE to
-                                      // prevent semi-transparent borders. Due to
-                                      // interpolation it takes texels from next repeat
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,
-                                format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-                                GL_LINEAR_MIPMAP_LINEAR);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-                stbi_image_free(data);
-        } else {
-                std::cout << "Texture failed to load at path: " << path << std::endl;
-                stbi_image_free(data);
-        }
-
-        return textureID;
-}
@@ -0,0 +1,344 @@
+// Cooks everything under resources/ into one resource pack (see resource_pack.h),
+// which the program maps at startup instead of reading loose files. Models are
+// stored as their mesh cache, images as they are plus block compressed the way the
+// program samples them, shaders and all other files as they are. Entries whose
+// inputs haven't changed since the previous pack are copied out of it instead of
+// being cooked again. Images are capped to the size of the given quality tier (see
+// texture_quality.h), the way a program running at that tier loads them. Usage:
+// asset_cooker [pack] [full|high|medium|low], by default resources.pack in the
+// project root at full quality.
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/image_decoder.h>
+#include <learnopengl/model.h>
+#include <learnopengl/resource_pack.h>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static double milliseconds(Clock::time_point start)
+{
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static string extension(const string &path)
+{
+        size_t dot = path.find_last_of('.');
+        if (dot == string::npos || path.find('/', dot) != string::npos)
+                return "";
+        string ext = path.substr(dot + 1);
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        return ext;
+}
+
+static bool endsWith(const string &str, const string &suffix)
+{
+        return str.size() >= suffix.size() &&
+               str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static string directory(const string &path)
+{
+        return path.substr(0, path.find_last_of('/'));
+}
+
+// every regular file below dir, recursively
+static void listFiles(const string &dir, vector<string> &files)
+{
+        DIR *handle = opendir(dir.c_str());
+        if (!handle)
+                return;
+        while (dirent *entry = readdir(handle)) {
+                string name = entry->d_name;
+                if (name == "." || name == "..")
+                        continue;
+                string path = dir + '/' + name;
+                struct stat st;
+                if (stat(path.c_str(), &st) != 0)
+                        continue;
+                if (S_ISDIR(st.st_mode))
+                        listFiles(path, files);
+                else if (S_ISREG(st.st_mode))
+                        files.push_back(path);
+        }
+        closedir(handle);
+}
+
+static bool hashFile(const string &path, uint64_t &hash)
+{
+        MappedFile file;
+        if (!file.open(path))
+                return false;
+        hash = hashBytes(file.data, file.size, hash);
+        return true;
+}
+
+template <typename T> static uint64_t hashValue(const T &value, uint64_t hash)
+{
+        return hashBytes((const unsigned char *)&value, sizeof(value), hash);
+}
+
+class Cooker
+{
+      public:
+        size_t cooked = 0;
+        size_t reused = 0;
+        vector<PackFile> files;
+
+        // keeps the entries of the previous pack, to be reused where nothing changed
+        void loadPrevious(const string &packPath)
+        {
+                ResourcePack &pack = ResourcePack::instance();
+                if (!pack.open(packPath))
+                        return;
+                for (size_t i = 0; i < pack.size(); i++) {
+                        PackFile &file = previous[pack.path(i)];
+                        file.path = pack.path(i);
+                        file.inputHash = pack.entry(i).inputHash;
+                        file.bytes.assign(pack.contents(i),
+                                          pack.contents(i) + pack.entry(i).size);
+                }
+                // everything from here on has to read the loose files
+                pack.close();
+        }
+
+        // files that go into the pack as they are
+        void copy(const string &path)
+        {
+                MappedFile file;
+                if (!file.open(path)) {
+                        printf("WARNING: could not read %s\n", path.c_str());
+                        return;
+                }
+                string entry = ResourcePack::relativePath(path);
+                uint64_t hash = hashBytes(file.data, file.size);
+                if (!reuse(entry, hash))
+                        add(entry, hash,
+                            vector<unsigned char>(file.data, file.data + file.size));
+        }
+
+        // a model goes into the pack as its mesh cache. Its material libraries are
+        // inputs too: any .mtl file next to it.
+        void cookModel(const string &path, const vector<string> &libraries)
+        {
+                uint64_t hash = 14695981039346656037ull;
+                if (!hashFile(path, hash)) {
+                        printf("WARNING: could not read %s\n", path.c_str());
+                        return;
+                }
+                for (const string &library : libraries)
+                        if (directory(library) == directory(path))
+                                hashFile(library, hash);
+                uint32_t loader = Model::loaderId();
+                unsigned int importFlags = Model::importFlags;
+                hash = hashValue(MESH_CACHE_VERSION, hash);
+                hash = hashValue(loader, hash);
+                hash = hashValue(importFlags, hash);
+                hash = hashValue((uint32_t)sizeof(Vertex), hash);
+
+                string entry = ResourcePack::relativePath(MeshCache::cachePath(path));
+                if (!reuse(entry, hash)) {
+                        vector<MeshData> meshes;
+                        std::ostringstream out;
+                        if (!Model::importMeshes(path, meshes) ||
+                            !MeshCache::write(path, loader, importFlags, meshes, out)) {
+                                printf("WARNING: could not cook %s\n", path.c_str());
+                                return;
+                        }
+                        string bytes = out.str();
+                        add(entry, hash,
+                            vector<unsigned char>(bytes.begin(), bytes.end()));
+                }
+
+                // material textures are compressed the way Model::import asks for
+                // them; a texture keeps the type it was first referenced as
+                const PackFile &cache = files.back();
+                MeshCache view;
+                if (!view.view(cache.bytes.data(), cache.bytes.size(), loader,
+                               importFlags))
+                        return;
+                for (size_t i = 0; i < view.meshCount(); i++) {
+                        for (const TextureRef &ref : view.mesh(i).textures) {
+                                string image = ResourcePack::relativePath(
+                                    directory(path) + '/' + ref.path);
+                                CompressionRequest request =
+                                    compressionRequest(Model::textureFormat(ref.type));
+                                textureSettings.emplace(
+                                    image,
+                                    ktx::settings(request, true,
+                                                  TextureQuality::instance().maxSize()));
+                        }
+                }
+        }
+
+        // an image goes into the pack as it is, for the uncompressed fallback, and
+        // block compressed when the program asks for it compressed. Settings of
+        // images that aren't model textures come from their loose .ktx cache, made
+        // by a run of the program; they are capped to the tier of the pack.
+        void cookImage(const string &path)
+        {
+                copy(path);
+                string relative = ResourcePack::relativePath(path);
+                uint32_t settings;
+                bool flip;
+                int maxSize;
+                auto known = textureSettings.find(relative);
+                if (known != textureSettings.end())
+                        settings = known->second;
+                else if (ktx::cachedSettings(path, settings))
+                        settings = ktx::settings(ktx::request(settings, flip, maxSize),
+                                                 flip,
+                                                 TextureQuality::instance().maxSize());
+                else
+                        return;
+
+                uint64_t hash = 14695981039346656037ull;
+                if (!hashFile(path, hash))
+                        return;
+                hash = hashValue(settings, hash);
+                hash = hashValue(ktx::ENCODER_VERSION, hash);
+                if (reuse(ResourcePack::relativePath(ktx::cachePath(path)), hash))
+                        return;
+                CompressionRequest request = ktx::request(settings, flip, maxSize);
+                size_t index = images.add(path, flip, request, maxSize);
+                pending.push_back(Pending{path, settings, hash, index});
+        }
+
+        // compresses the images queued by cookImage, on all cores
+        void compressImages()
+        {
+                if (pending.empty())
+                        return;
+                images.decode();
+                images.report(std::cout);
+                for (const Pending &image : pending) {
+                        const DecodedImage &decoded = images.image(image.index);
+                        std::ostringstream out;
+                        if (!decoded.isCompressed() ||
+                            !ktx::write(image.path, image.settings, decoded.compressed,
+                                        out)) {
+                                printf("WARNING: %s stays uncompressed\n",
+                                       image.path.c_str());
+                                continue;
+                        }
+                        string bytes = out.str();
+                        string entry =
+                            ResourcePack::relativePath(ktx::cachePath(image.path));
+                        add(entry, image.hash,
+                            vector<unsigned char>(bytes.begin(), bytes.end()));
+                        images.release(image.index);
+                }
+        }
+
+      private:
+        struct Pending {
+                string path;
+                uint32_t settings;
+                uint64_t hash;
+                size_t index;
+        };
+
+        std::map<string, PackFile> previous;
+        unordered_map<string, uint32_t> textureSettings;
+        ImageDecodeBatch images;
+        vector<Pending> pending;
+
+        bool reuse(const string &entry, uint64_t inputHash)
+        {
+                auto it = previous.find(entry);
+                if (it == previous.end() || it->second.inputHash != inputHash)
+                        return false;
+                files.push_back(std::move(it->second));
+                previous.erase(it);
+                reused++;
+                return true;
+        }
+
+        void add(const string &entry, uint64_t inputHash, vector<unsigned char> bytes)
+        {
+                PackFile file;
+                file.path = entry;
+                file.inputHash = inputHash;
+                file.bytes = std::move(bytes);
+                files.push_back(std::move(file));
+                cooked++;
+        }
+};
+
+int main(int argc, char **argv)
+{
+        string packPath = argc > 1 ? argv[1] : FileSystem::getPath("resources.pack");
+        QualityTier tier = QualityTier::Full;
+        if (argc > 2 && !TextureQuality::parseTier(argv[2], tier)) {
+                printf("ERROR: unknown quality tier %s\n", argv[2]);
+                return 1;
+        }
+        TextureQuality::instance().set(tier);
+        Clock::time_point start = Clock::now();
+
+        // there is no GL context to ask; S3TC and RGTC are there on every desktop
+        // driver, BC7 isn't and is left out
+        BlockCompression::assume(BlockFormat::BC1);
+        BlockCompression::assume(BlockFormat::BC3);
+        BlockCompression::assume(BlockFormat::BC4);
+        BlockCompression::assume(BlockFormat::BC5);
+
+        Cooker cooker;
+        cooker.loadPrevious(packPath);
+
+        vector<string> all;
+        listFiles(FileSystem::getPath("resources"), all);
+        std::sort(all.begin(), all.end());
+        vector<string> models, libraries, images, other;
+        for (const string &path : all) {
+                string ext = extension(path);
+                // caches the pack replaces, and what the program writes at runtime
+                if (ext == "meshcache" || ext == "ktx" || ext == "tmp" ||
+                    endsWith(path, "/program_state.txt"))
+                        continue;
+                if (ext == "obj" || ext == "fbx" || ext == "dae" || ext == "3ds" ||
+                    ext == "gltf" || ext == "glb" || ext == "ply" || ext == "blend")
+                        models.push_back(path);
+                else if (ext == "mtl")
+                        libraries.push_back(path);
+                else if (ext == "jpg" || ext == "jpeg" || ext == "png" || ext == "tga" ||
+                         ext == "bmp")
+                        images.push_back(path);
+                else
+                        other.push_back(path);
+        }
+
+        // models first: they decide how their textures are compressed. Each model
+        // is processed on all cores by itself.
+        for (const string &path : models)
+                cooker.cookModel(path, libraries);
+        for (const string &path : images)
+                cooker.cookImage(path);
+        cooker.compressImages();
+        for (const string &path : other)
+                cooker.copy(path);
+
+        size_t bytes = 0;
+        for (const PackFile &file : cooker.files)
+                bytes += file.bytes.size();
+        if (!ResourcePack::write(packPath, cooker.files)) {
+                printf("ERROR: could not write %s\n", packPath.c_str());
+                return 1;
+        }
+        printf("%s: %zu entries (%zu cooked, %zu unchanged), %.2f MB in %.0f ms\n",
+               packPath.c_str(), cooker.files.size(), cooker.cooked, cooker.reused,
+               bytes / (1024.0 * 1024.0), milliseconds(start));
+        return 0;
+}
@@ -0,0 +1,290 @@
+// Compiles the shaders under resources/shaders/ offline. Every stage, in every
+// variant its #ifdef features allow, is put together the way ShaderManager does it
+// (shader_manager.h), validated and compiled to SPIR-V for OpenGL by glslangValidator
+// and optimized by spirv-opt. The modules go to resources/shaders/spirv/, named
+// after the hash of their source, where ShaderManager (and the asset cooker) find
+// them; modules of sources that are gone are removed. Stages are compiled one at a
+// time, so nothing links their interfaces: every varying has to be declared with
+// LOCATION(n) (varying.glsl), and a name has the same location in every stage. A
+// shader that breaks that or doesn't compile fails the run, and with it the build.
+// Usage:
+// shader_compiler <glslangValidator> [spirv-opt]
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/shader_manager.h>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+// variants per stage are 2^features; more than this is a mistake in the shader
+const size_t MAX_FEATURES = 8;
+
+static string extension(const string &path)
+{
+        size_t dot = path.find_last_of('.');
+        return dot == string::npos ? "" : path.substr(dot + 1);
+}
+
+// glslangValidator's name of the stage of a file, empty if it isn't a stage
+static string stageName(const string &path)
+{
+        string ext = extension(path);
+        if (ext == "vs")
+                return "vert";
+        if (ext == "fs")
+                return "frag";
+        if (ext == "gs")
+                return "geom";
+        return "";
+}
+
+static vector<string> listFiles(const string &dir)
+{
+        vector<string> files;
+        DIR *handle = opendir(dir.c_str());
+        if (!handle)
+                return files;
+        while (dirent *entry = readdir(handle)) {
+                string name = entry->d_name;
+                if (name != "." && name != "..")
+                        files.push_back(name);
+        }
+        closedir(handle);
+        std::sort(files.begin(), files.end());
+        return files;
+}
+
+static bool exists(const string &path)
+{
+        struct stat st;
+        return stat(path.c_str(), &st) == 0;
+}
+
+static bool writeFile(const string &path, const string &text)
+{
+        FILE *file = fopen(path.c_str(), "wb");
+        if (!file)
+                return false;
+        bool ok = fwrite(text.data(), 1, text.size(), file) == text.size();
+        return fclose(file) == 0 && ok;
+}
+
+// runs a command, returns its exit status and everything it printed
+static int run(const string &command, string &output)
+{
+        FILE *pipe = popen((command + " 2>&1").c_str(), "r");
+        if (!pipe)
+                return -1;
+        char buffer[4096];
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), pipe)) > 0)
+                output.append(buffer, read);
+        return pclose(pipe);
+}
+
+static string quote(const string &path) { return "\"" + path + "\""; }
+
+class Compiler
+{
+      public:
+        size_t compiled = 0;
+        size_t unchanged = 0;
+        size_t failed = 0;
+        std::set<string> modules;
+
+        Compiler(const string &glslang, const string &optimizer, const string &output)
+            : glslang(glslang), optimizer(optimizer), output(output)
+        {
+        }
+
+        void compileStage(const string &path)
+        {
+                ShaderSource base;
+                if (!base.load(path, "")) {
+                        failed++;
+                        return;
+                }
+                if (!checkInterface(path, base.text())) {
+                        failed++;
+                        return;
+                }
+                vector<string> features = ShaderSource::features(base.text());
+                if (features.size() > MAX_FEATURES) {
+                        printf("ERROR::SHADER::%s tests %zu features, at most %zu are "
+                               "supported\n",
+                               path.c_str(), features.size(), MAX_FEATURES);
+                        failed++;
+                        return;
+                }
+                for (unsigned int mask = 0; mask < (1u << features.size()); mask++) {
+                        vector<string> enabled;
+                        for (size_t i = 0; i < features.size(); i++)
+                                if (mask & (1u << i))
+                                        enabled.push_back(features[i]);
+                        compileVariant(path, enabled);
+                }
+        }
+
+      private:
+        string glslang;
+        string optimizer;
+        string output;
+        // location of every varying name and the stage it was first seen in
+        std::map<string, std::pair<int, string>> locations;
+
+        // number of locations a varying of type takes
+        static int slots(const string &type)
+        {
+                if (type == "mat2")
+                        return 2;
+                if (type == "mat3")
+                        return 3;
+                if (type == "mat4")
+                        return 4;
+                return 1;
+        }
+
+        // checks the "[LOCATION(n)] out|in type name;" varyings a stage passes on
+        // (out of a vertex shader) or takes (in of a fragment shader); the text isn't
+        // preprocessed, so the declarations of every variant are seen at once
+        bool checkInterface(const string &path, const string &text)
+        {
+                string ext = extension(path);
+                string direction = ext == "vs" ? "out" : ext == "fs" ? "in" : "";
+                if (direction.empty())
+                        return true;
+                bool ok = true;
+                std::map<int, string> used;
+                std::istringstream lines(text);
+                string line;
+                while (std::getline(lines, line)) {
+                        std::istringstream tokens(line);
+                        string word, type, name;
+                        int location = -1;
+                        tokens >> word;
+                        if (word.compare(0, 9, "LOCATION(") == 0) {
+                                location = atoi(word.c_str() + 9);
+                                tokens >> word;
+                        }
+                        if (word != direction || !(tokens >> type >> name) ||
+                            name.empty() || name.back() != ';')
+                                continue;
+                        name.pop_back();
+                        if (location < 0) {
+                                printf("ERROR::SHADER::%s: %s has no LOCATION\n",
+                                       path.c_str(), name.c_str());
+                                ok = false;
+                                continue;
+                        }
+                        auto known =
+                                locations.emplace(name, std::make_pair(location, path));
+                        if (known.first->second.first != location) {
+                                printf("ERROR::SHADER::%s: %s is at %d, in %s at %d\n",
+                                       path.c_str(), name.c_str(), location,
+                                       known.first->second.second.c_str(),
+                                       known.first->second.first);
+                                ok = false;
+                        }
+                        for (int slot = location; slot < location + slots(type); slot++) {
+                                auto taken = used.emplace(slot, name);
+                                if (!taken.second && taken.first->second != name) {
+                                        printf("ERROR::SHADER::%s: %s and %s share "
+                                               "location %d\n",
+                                               path.c_str(), name.c_str(),
+                                               taken.first->second.c_str(), slot);
+                                        ok = false;
+                                }
+                        }
+                }
+                return ok;
+        }
+
+        void compileVariant(const string &path, const vector<string> &features)
+        {
+                ShaderSource source;
+                if (!source.load(path, ShaderSource::defines(features))) {
+                        failed++;
+                        return;
+                }
+                string name = ShaderManager::spirvPath(source.hash());
+                name = name.substr(name.find_last_of('/') + 1);
+                string module = output + "/" + name;
+                modules.insert(name);
+                if (exists(module)) {
+                        unchanged++;
+                        return;
+                }
+
+                // glslangValidator wants the stage in the file name
+                string glsl = module + "." + stageName(path);
+                string binary = module + ".tmp";
+                string log;
+                bool ok = writeFile(glsl, source.text()) &&
+                          run(quote(glslang) +
+                                  " -G --auto-map-locations --auto-map-bindings -o " +
+                                  quote(binary) + " " + quote(glsl),
+                              log) == 0;
+                if (ok && !optimizer.empty())
+                        ok = run(quote(optimizer) + " -O " + quote(binary) + " -o " +
+                                     quote(module),
+                                 log) == 0;
+                else if (ok)
+                        ok = std::rename(binary.c_str(), module.c_str()) == 0;
+                unlink(glsl.c_str());
+                unlink(binary.c_str());
+                if (!ok) {
+                        unlink(module.c_str());
+                        printf("ERROR::SHADER::%s", path.c_str());
+                        for (const string &feature : features)
+                                printf(" %s", feature.c_str());
+                        printf("\n");
+                        ShaderManager::reportLog(log, &source.files);
+                        failed++;
+                        return;
+                }
+                compiled++;
+        }
+};
+
+int main(int argc, char **argv)
+{
+        if (argc < 2) {
+                printf("usage: %s <glslangValidator> [spirv-opt]\n", argv[0]);
+                return 1;
+        }
+        string shaders = FileSystem::getPath("resources/shaders");
+        string output = shaders + "/spirv";
+        mkdir(output.c_str(), 0755);
+
+        Compiler compiler(argv[1], argc > 2 ? argv[2] : "", output);
+        for (const string &name : listFiles(shaders))
+                if (!stageName(name).empty())
+                        compiler.compileStage(shaders + "/" + name);
+
+        // modules of sources that changed or are gone
+        size_t removed = 0;
+        for (const string &name : listFiles(output)) {
+                if (compiler.modules.count(name) == 0) {
+                        unlink((output + "/" + name).c_str());
+                        removed++;
+                }
+        }
+
+        printf("%s: %zu compiled, %zu unchanged, %zu removed, %zu failed\n",
+               output.c_str(), compiler.compiled, compiler.unchanged, removed,
+               compiler.failed);
+        return compiler.failed == 0 ? 0 : 1;
+}